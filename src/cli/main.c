@@ -25,6 +25,7 @@
  *  - profit
  */
 
+#include "cli/server.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -38,6 +39,7 @@
 #include "common/imageio_module.h"
 #include "common/points.h"
 #include "control/conf.h"
+#include "control/control.h"
 #include "develop/imageop.h"
 
 #include <inttypes.h>
@@ -58,6 +60,8 @@
 static void usage(const char *progname)
 {
   fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [options] [--core <darktable options>]\n", progname);
+  fprintf(stderr, "       %s --server [--socket <path>] [--workers <n>] [options] [--core <darktable options>]\n",
+          progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "options:\n");
   fprintf(stderr, "   --width <max width> default: 0 = full resolution\n");
@@ -69,9 +73,201 @@ static void usage(const char *progname)
   fprintf(stderr, "   --style <style name>\n");
   fprintf(stderr, "   --style-overwrite\n");
   fprintf(stderr, "   --apply-custom-presets <0|1|false|true>, default: true\n");
+  fprintf(stderr, "   --job-stats <file>, write job system statistics as json\n");
+  fprintf(stderr, "   --server, render jobs given as line-delimited json, see below\n");
+  fprintf(stderr, "   --socket <path>, listen on a unix socket instead of stdin, implies --server\n");
+  fprintf(stderr, "   --workers <n>, number of jobs rendered concurrently in server mode\n");
   fprintf(stderr, "   --verbose\n");
   fprintf(stderr, "   --help,-h\n");
   fprintf(stderr, "   --version\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "in server mode darktable is initialized once and every line read is a render job like\n");
+  fprintf(stderr, "   {\"id\": 1, \"input\": \"in.raw\", \"xmp\": \"in.raw.xmp\", \"output\": \"out.jpg\",\n");
+  fprintf(stderr, "    \"width\": 0, \"height\": 0, \"hq\": true, \"upscale\": false, \"style\": \"name\"}\n");
+  fprintf(stderr, "where only input and output are required and the options above are the defaults.\n");
+  fprintf(stderr, "each job gets a \"queued\" and a \"done\" or \"error\" status line as reply.\n");
+  fprintf(stderr, "{\"command\": \"stats\"} replies the job statistics, {\"command\": \"quit\"} stops the server.\n");
+}
+
+static void _write_job_stats(const char *filename)
+{
+  if(!filename) return;
+
+  gchar *job_stats = dt_control_jobs_stats_json(darktable.control);
+  GError *error = NULL;
+  if(!g_file_set_contents(filename, job_stats, -1, &error))
+  {
+    fprintf(stderr, "%s `%s': %s\n", _("error: can't write job statistics to"), filename, error->message);
+    g_error_free(error);
+  }
+  g_free(job_stats);
+}
+
+GList *dt_cli_import_images(const char *input_filename, gchar **error)
+{
+  GList *id_list = NULL;
+
+  if(g_file_test(input_filename, G_FILE_TEST_IS_DIR))
+  {
+    const int filmid = dt_film_import(input_filename);
+    if(!filmid)
+    {
+      *error = g_strdup_printf(_("error: can't open folder %s"), input_filename);
+      return NULL;
+    }
+    id_list = dt_film_get_image_ids(filmid);
+  }
+  else
+  {
+    dt_film_t film;
+    int id = 0;
+    int filmid = 0;
+
+    gchar *directory = g_path_get_dirname(input_filename);
+    filmid = dt_film_new(&film, directory);
+    g_free(directory);
+    id = dt_image_import(filmid, input_filename, TRUE);
+    if(!id)
+    {
+      *error = g_strdup_printf(_("error: can't open file %s"), input_filename);
+      return NULL;
+    }
+
+    id_list = g_list_append(id_list, GINT_TO_POINTER(id));
+  }
+
+  return id_list;
+}
+
+int dt_cli_export_images(GList *id_list, const dt_cli_export_t *params, gchar **error)
+{
+  // try to find out the export format from the output_filename
+  gchar *output_filename = g_strdup(params->output_filename);
+  char *ext = output_filename + strlen(output_filename);
+  while(ext > output_filename && *ext != '.') ext--;
+  *ext = '\0';
+  ext++;
+
+  if(!strcmp(ext, "jpg")) ext = "jpeg";
+
+  if(!strcmp(ext, "tif")) ext = "tiff";
+
+  // init the export data structures
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *sdata, *fdata;
+
+  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
+  if(storage == NULL)
+  {
+    *error = g_strdup(
+        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+    g_free(output_filename);
+    return 1;
+  }
+
+  sdata = storage->get_params(storage);
+  if(sdata == NULL)
+  {
+    *error = g_strdup(_("failed to get parameters from storage module, aborting export ..."));
+    g_free(output_filename);
+    return 1;
+  }
+
+  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
+  // any longer ...
+  g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS);
+  // all is good now, the last line didn't happen.
+
+  format = dt_imageio_get_format_by_name(ext);
+  if(format == NULL)
+  {
+    *error = g_strdup_printf(_("unknown extension '.%s'"), ext);
+    storage->free_params(storage, sdata);
+    g_free(output_filename);
+    return 1;
+  }
+
+  fdata = format->get_params(format);
+  if(fdata == NULL)
+  {
+    *error = g_strdup(_("failed to get parameters from format module, aborting export ..."));
+    storage->free_params(storage, sdata);
+    g_free(output_filename);
+    return 1;
+  }
+
+  uint32_t w, h, fw, fh, sw, sh;
+  fw = fh = sw = sh = 0;
+  storage->dimension(storage, sdata, &sw, &sh);
+  format->dimension(format, fdata, &fw, &fh);
+
+  if(sw == 0 || fw == 0)
+    w = sw > fw ? sw : fw;
+  else
+    w = sw < fw ? sw : fw;
+
+  if(sh == 0 || fh == 0)
+    h = sh > fh ? sh : fh;
+  else
+    h = sh < fh ? sh : fh;
+
+  fdata->max_width = params->width;
+  fdata->max_height = params->height;
+  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
+  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
+  fdata->style[0] = '\0';
+  fdata->style_append = 1; // make append the default and override with --style-overwrite
+
+  if(params->style)
+  {
+    g_strlcpy((char *)fdata->style, params->style, DT_MAX_STYLE_NAME_LENGTH);
+    fdata->style[127] = '\0';
+    if(params->style_overwrite)
+      fdata->style_append = 0;
+  }
+
+  GList *ids = g_list_copy(id_list);
+  const int total = g_list_length(ids);
+
+  if(storage->initialize_store)
+  {
+    storage->initialize_store(storage, sdata, &format, &fdata, &ids, params->high_quality, params->upscale);
+
+    format->set_params(format, fdata, format->params_size(format));
+    storage->set_params(storage, sdata, storage->params_size(storage));
+  }
+
+  // TODO: do we want to use the settings from conf?
+  // TODO: expose these via command line arguments
+  dt_colorspaces_color_profile_type_t icc_type = DT_COLORSPACE_NONE;
+  const gchar *icc_filename = NULL;
+  dt_iop_color_intent_t icc_intent = DT_INTENT_LAST;
+
+  // TODO: add a callback to set the bpp without going through the config
+
+  int num = 1, res = 0;
+  for(GList *iter = ids; iter; iter = g_list_next(iter), num++)
+  {
+    const int id = GPOINTER_TO_INT(iter->data);
+    // TODO: have a parameter in command line to get the export presets
+    dt_export_metadata_t metadata;
+    metadata.flags = dt_lib_export_metadata_default_flags();
+    metadata.list = NULL;
+    if(storage->store(storage, sdata, id, format, fdata, num, total, params->high_quality, params->upscale,
+                      params->export_masks, icc_type, icc_filename, icc_intent, &metadata))
+      res = 1;
+  }
+  if(res) *error = g_strdup(_("export failed"));
+
+  // cleanup time
+  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  storage->free_params(storage, sdata);
+  format->free_params(format, fdata);
+  g_list_free(ids);
+  g_free(output_filename);
+
+  return res;
 }
 
 int main(int argc, char *arg[])
@@ -90,6 +286,10 @@ int main(int argc, char *arg[])
   char *xmp_filename = NULL;
   char *output_filename = NULL;
   char *style = NULL;
+  char *job_stats_filename = NULL;
+  char *socket_path = NULL;
+  gboolean server = FALSE;
+  int workers = 0;
   int file_counter = 0;
   int width = 0, height = 0, bpp = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
@@ -181,6 +381,26 @@ int main(int argc, char *arg[])
         k++;
         style = arg[k];
       }
+      else if(!strcmp(arg[k], "--job-stats") && argc > k + 1)
+      {
+        k++;
+        job_stats_filename = arg[k];
+      }
+      else if(!strcmp(arg[k], "--server"))
+      {
+        server = TRUE;
+      }
+      else if(!strcmp(arg[k], "--socket") && argc > k + 1)
+      {
+        k++;
+        socket_path = arg[k];
+        server = TRUE;
+      }
+      else if(!strcmp(arg[k], "--workers") && argc > k + 1)
+      {
+        k++;
+        workers = MAX(atoi(arg[k]), 0);
+      }
       else if(!strcmp(arg[k], "--style-overwrite"))
       {
         style_overwrite = TRUE;
@@ -235,6 +455,38 @@ int main(int argc, char *arg[])
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
+  if(server)
+  {
+    if(file_counter != 0)
+    {
+      usage(arg[0]);
+      free(m_arg);
+      exit(1);
+    }
+
+    if(dt_init(m_argc, m_arg, FALSE, custom_presets, NULL))
+    {
+      free(m_arg);
+      exit(1);
+    }
+
+    // the command line options are the defaults for all jobs
+    const dt_cli_export_t defaults = { .output_filename = NULL,
+                                       .width = width,
+                                       .height = height,
+                                       .high_quality = high_quality,
+                                       .upscale = upscale,
+                                       .export_masks = export_masks,
+                                       .style = style,
+                                       .style_overwrite = style_overwrite };
+    const int res = dt_cli_server_run(socket_path, workers, &defaults);
+
+    _write_job_stats(job_stats_filename);
+    dt_cleanup();
+    free(m_arg);
+    return res;
+  }
+
   if(file_counter < 2 || file_counter > 3)
   {
     usage(arg[0]);
@@ -269,39 +521,14 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
-  GList *id_list = NULL;
-
-  if(g_file_test(input_filename, G_FILE_TEST_IS_DIR))
+  gchar *error = NULL;
+  GList *id_list = dt_cli_import_images(input_filename, &error);
+  if(!id_list && error)
   {
-    const int filmid = dt_film_import(input_filename);
-    if(!filmid)
-    {
-      fprintf(stderr, _("error: can't open folder %s"), input_filename);
-      fprintf(stderr, "\n");
-      free(m_arg);
-      exit(1);
-    }
-    id_list = dt_film_get_image_ids(filmid);
-  }
-  else
-  {
-    dt_film_t film;
-    int id = 0;
-    int filmid = 0;
-
-    gchar *directory = g_path_get_dirname(input_filename);
-    filmid = dt_film_new(&film, directory);
-    id = dt_image_import(filmid, input_filename, TRUE);
-    if(!id)
-    {
-      fprintf(stderr, _("error: can't open file %s"), input_filename);
-      fprintf(stderr, "\n");
-      free(m_arg);
-      exit(1);
-    }
-    g_free(directory);
-
-    id_list = g_list_append(id_list, GINT_TO_POINTER(id));
+    fprintf(stderr, "%s\n", error);
+    g_free(error);
+    free(m_arg);
+    exit(1);
   }
 
   const int total = g_list_length(id_list);
@@ -343,125 +570,23 @@ int main(int argc, char *arg[])
       printf("[%s]\n", _("empty history stack"));
   }
 
-  // try to find out the export format from the output_filename
-  char *ext = output_filename + strlen(output_filename);
-  while(ext > output_filename && *ext != '.') ext--;
-  *ext = '\0';
-  ext++;
-
-  if(!strcmp(ext, "jpg")) ext = "jpeg";
-
-  if(!strcmp(ext, "tif")) ext = "tiff";
-
-  // init the export data structures
-  dt_imageio_module_format_t *format;
-  dt_imageio_module_storage_t *storage;
-  dt_imageio_module_data_t *sdata, *fdata;
-
-  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
-  if(storage == NULL)
-  {
-    fprintf(
-        stderr, "%s\n",
-        _("cannot find disk storage module. please check your installation, something seems to be broken."));
-    free(m_arg);
-    exit(1);
-  }
-
-  sdata = storage->get_params(storage);
-  if(sdata == NULL)
+  const dt_cli_export_t export_params = { .output_filename = output_filename,
+                                           .width = width,
+                                           .height = height,
+                                           .high_quality = high_quality,
+                                           .upscale = upscale,
+                                           .export_masks = export_masks,
+                                           .style = style,
+                                           .style_overwrite = style_overwrite };
+  if(dt_cli_export_images(id_list, &export_params, &error) && error)
   {
-    fprintf(stderr, "%s\n", _("failed to get parameters from storage module, aborting export ..."));
-    free(m_arg);
-    exit(1);
+    fprintf(stderr, "%s\n", error);
   }
-
-  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
-  // any longer ...
-  g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS);
-  // all is good now, the last line didn't happen.
-
-  format = dt_imageio_get_format_by_name(ext);
-  if(format == NULL)
-  {
-    fprintf(stderr, _("unknown extension '.%s'"), ext);
-    fprintf(stderr, "\n");
-    free(m_arg);
-    exit(1);
-  }
-
-  fdata = format->get_params(format);
-  if(fdata == NULL)
-  {
-    fprintf(stderr, "%s\n", _("failed to get parameters from format module, aborting export ..."));
-    free(m_arg);
-    exit(1);
-  }
-
-  uint32_t w, h, fw, fh, sw, sh;
-  fw = fh = sw = sh = 0;
-  storage->dimension(storage, sdata, &sw, &sh);
-  format->dimension(format, fdata, &fw, &fh);
-
-  if(sw == 0 || fw == 0)
-    w = sw > fw ? sw : fw;
-  else
-    w = sw < fw ? sw : fw;
-
-  if(sh == 0 || fh == 0)
-    h = sh > fh ? sh : fh;
-  else
-    h = sh < fh ? sh : fh;
-
-  fdata->max_width = width;
-  fdata->max_height = height;
-  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
-  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
-  fdata->style[0] = '\0';
-  fdata->style_append = 1; // make append the default and override with --style-overwrite
-
-  if(style)
-  {
-    g_strlcpy((char *)fdata->style, style, DT_MAX_STYLE_NAME_LENGTH);
-    fdata->style[127] = '\0';
-    if(style_overwrite)
-      fdata->style_append = 0;
-  }
-
-  if(storage->initialize_store)
-  {
-    storage->initialize_store(storage, sdata, &format, &fdata, &id_list, high_quality, upscale);
-
-    format->set_params(format, fdata, format->params_size(format));
-    storage->set_params(storage, sdata, storage->params_size(storage));
-  }
-
-  // TODO: do we want to use the settings from conf?
-  // TODO: expose these via command line arguments
-  dt_colorspaces_color_profile_type_t icc_type = DT_COLORSPACE_NONE;
-  const gchar *icc_filename = NULL;
-  dt_iop_color_intent_t icc_intent = DT_INTENT_LAST;
-
-  // TODO: add a callback to set the bpp without going through the config
-
-  int num = 1;
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
-  {
-    const int id = GPOINTER_TO_INT(iter->data);
-    // TODO: have a parameter in command line to get the export presets
-    dt_export_metadata_t metadata;
-    metadata.flags = dt_lib_export_metadata_default_flags();
-    metadata.list = NULL;
-    storage->store(storage, sdata, id, format, fdata, num, total, high_quality, upscale, export_masks,
-                   icc_type, icc_filename, icc_intent, &metadata);
-  }
-
-  // cleanup time
-  if(storage->finalize_store) storage->finalize_store(storage, sdata);
-  storage->free_params(storage, sdata);
-  format->free_params(format, fdata);
+  g_free(error);
   g_list_free(id_list);
 
+  _write_job_stats(job_stats_filename);
+
   dt_cleanup();
 
   free(m_arg);
@@ -0,0 +1,620 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * persistent render server for darktable-cli.
+ *
+ * darktable is initialized once, then every line read is a render job in json. jobs are rendered
+ * concurrently by a pool of workers, each job replies a "queued" line once it was accepted and a
+ * "done" or "error" line when it is finished, both carrying the id given in the request.
+ *
+ * all jobs share one in-memory library, so an image rendered repeatedly is only imported once. imports are
+ * serialized, as they share film rolls and image cache entries. two jobs using the same image never run at
+ * the same time, as the history of an image is replaced by the xmp of the job rendering it.
+ */
+
+#include "cli/server.h"
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/history.h"
+#include "common/image.h"
+#include "common/image_cache.h"
+#include "control/control.h"
+
+#include <errno.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef _WIN32
+
+typedef struct dt_cli_server_t dt_cli_server_t;
+
+/** one client, the stdin/stdout pair or a socket connection. referenced by its reader and all its jobs */
+typedef struct dt_cli_connection_t
+{
+  gint refcount;
+  dt_cli_server_t *server;
+  int fd;   // the socket, -1 for stdin
+  FILE *in;
+  int out;  // replies are written here
+  dt_pthread_mutex_t mutex; // one reply line at a time
+} dt_cli_connection_t;
+
+struct dt_cli_server_t
+{
+  GThreadPool *pool;
+  const dt_cli_export_t *defaults;
+  int workers;
+  gint quit;
+
+  // socket clients currently read from
+  dt_pthread_mutex_t connections_mutex;
+  pthread_cond_t connections_cond;
+  GList *connections;
+
+  // imports go into the same film rolls and image cache entries, one at a time
+  dt_pthread_mutex_t import_mutex;
+
+  // images used by a running job, and the xmp file the history of an image was last read from
+  dt_pthread_mutex_t images_mutex;
+  pthread_cond_t images_cond;
+  GHashTable *busy;
+  GHashTable *xmp;
+};
+
+typedef struct dt_cli_job_t
+{
+  dt_cli_connection_t *connection;
+  JsonNode *id; // echoed in the replies, may be NULL
+  gchar *input, *xmp, *output, *style;
+  dt_cli_export_t params;
+} dt_cli_job_t;
+
+static dt_cli_connection_t *_connection_new(dt_cli_server_t *server, const int fd, FILE *in, const int out)
+{
+  dt_cli_connection_t *c = (dt_cli_connection_t *)calloc(1, sizeof(dt_cli_connection_t));
+  c->refcount = 1;
+  c->server = server;
+  c->fd = fd;
+  c->in = in;
+  c->out = out;
+  dt_pthread_mutex_init(&c->mutex, NULL);
+  return c;
+}
+
+static dt_cli_connection_t *_connection_ref(dt_cli_connection_t *c)
+{
+  g_atomic_int_inc(&c->refcount);
+  return c;
+}
+
+static void _connection_unref(dt_cli_connection_t *c)
+{
+  if(!g_atomic_int_dec_and_test(&c->refcount)) return;
+  // closing a socket's stream closes the socket. stdin and the reply fd are left to the caller
+  if(c->fd >= 0) fclose(c->in);
+  dt_pthread_mutex_destroy(&c->mutex);
+  free(c);
+}
+
+static void _reply_node(dt_cli_connection_t *c, JsonNode *root)
+{
+  JsonGenerator *generator = json_generator_new();
+  json_generator_set_root(generator, root);
+  gsize length = 0;
+  gchar *line = json_generator_to_data(generator, &length);
+  g_object_unref(generator);
+
+  dt_pthread_mutex_lock(&c->mutex);
+  gsize written = 0;
+  // a client that went away just doesn't get its replies
+  while(written < length + 1)
+  {
+    const char *data = written < length ? line + written : "\n";
+    const ssize_t res = write(c->out, data, written < length ? length - written : 1);
+    if(res < 0 && errno == EINTR) continue;
+    if(res <= 0) break;
+    written += res;
+  }
+  dt_pthread_mutex_unlock(&c->mutex);
+  g_free(line);
+}
+
+static void _reply(dt_cli_connection_t *c, JsonNode *id, const char *status, const char *message,
+                   const int images, const double seconds)
+{
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  if(id)
+  {
+    json_builder_set_member_name(builder, "id");
+    json_builder_add_value(builder, json_node_copy(id));
+  }
+  json_builder_set_member_name(builder, "status");
+  json_builder_add_string_value(builder, status);
+  if(message)
+  {
+    json_builder_set_member_name(builder, "message");
+    json_builder_add_string_value(builder, message);
+  }
+  if(images >= 0)
+  {
+    json_builder_set_member_name(builder, "images");
+    json_builder_add_int_value(builder, images);
+    json_builder_set_member_name(builder, "time");
+    json_builder_add_double_value(builder, seconds);
+  }
+  json_builder_end_object(builder);
+
+  JsonNode *root = json_builder_get_root(builder);
+  _reply_node(c, root);
+  json_node_unref(root);
+  g_object_unref(builder);
+}
+
+static void _reply_stats(dt_cli_connection_t *c, JsonNode *id)
+{
+  gchar *stats = dt_control_jobs_stats_json(darktable.control);
+  JsonNode *root = json_node_new(JSON_NODE_OBJECT);
+  JsonObject *obj = json_object_new();
+  if(id) json_object_set_member(obj, "id", json_node_copy(id));
+  json_object_set_string_member(obj, "status", "stats");
+  JsonParser *parser = json_parser_new();
+  if(json_parser_load_from_data(parser, stats, -1, NULL))
+    json_object_set_member(obj, "stats", json_node_copy(json_parser_get_root(parser)));
+  g_object_unref(parser);
+  json_node_take_object(root, obj);
+  _reply_node(c, root);
+  json_node_unref(root);
+  g_free(stats);
+}
+
+static void _job_free(dt_cli_job_t *job)
+{
+  _connection_unref(job->connection);
+  if(job->id) json_node_unref(job->id);
+  g_free(job->input);
+  g_free(job->xmp);
+  g_free(job->output);
+  g_free(job->style);
+  free(job);
+}
+
+static gint _sort_ids(gconstpointer a, gconstpointer b)
+{
+  return GPOINTER_TO_INT(a) - GPOINTER_TO_INT(b);
+}
+
+static gboolean _images_busy(dt_cli_server_t *server, GList *ids)
+{
+  for(GList *iter = ids; iter; iter = g_list_next(iter))
+    if(g_hash_table_contains(server->busy, iter->data)) return TRUE;
+  return FALSE;
+}
+
+// all images of a job are taken at once, so jobs sharing images can't deadlock
+static void _images_acquire(dt_cli_server_t *server, GList *ids)
+{
+  dt_pthread_mutex_lock(&server->images_mutex);
+  while(_images_busy(server, ids)) dt_pthread_cond_wait(&server->images_cond, &server->images_mutex);
+  for(GList *iter = ids; iter; iter = g_list_next(iter)) g_hash_table_add(server->busy, iter->data);
+  dt_pthread_mutex_unlock(&server->images_mutex);
+}
+
+static void _images_release(dt_cli_server_t *server, GList *ids)
+{
+  dt_pthread_mutex_lock(&server->images_mutex);
+  for(GList *iter = ids; iter; iter = g_list_next(iter)) g_hash_table_remove(server->busy, iter->data);
+  pthread_cond_broadcast(&server->images_cond);
+  dt_pthread_mutex_unlock(&server->images_mutex);
+}
+
+// bring the history of an image in line with the job. an explicit xmp is always read again, as it might
+// have changed since the last job. without one, the state of the import (the sidecar or nothing) is restored.
+static int _apply_xmp(dt_cli_server_t *server, const int imgid, const char *xmp)
+{
+  dt_pthread_mutex_lock(&server->images_mutex);
+  const gboolean imported_state = !g_hash_table_contains(server->xmp, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&server->images_mutex);
+
+  if(!xmp && imported_state) return 0;
+
+  int res = 0;
+  if(xmp)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+    res = dt_exif_xmp_read(image, xmp, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+  }
+  else
+  {
+    char sidecar[PATH_MAX] = { 0 };
+    gboolean from_cache = FALSE;
+    dt_image_full_path(imgid, sidecar, sizeof(sidecar), &from_cache);
+    dt_image_path_append_version(imgid, sidecar, sizeof(sidecar));
+    g_strlcat(sidecar, ".xmp", sizeof(sidecar));
+
+    if(g_file_test(sidecar, G_FILE_TEST_EXISTS))
+    {
+      dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+      res = dt_exif_xmp_read(image, sidecar, 1);
+      dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+    }
+    else
+      dt_history_delete_on_image_ext(imgid, FALSE);
+  }
+
+  dt_pthread_mutex_lock(&server->images_mutex);
+  if(xmp && !res)
+    g_hash_table_insert(server->xmp, GINT_TO_POINTER(imgid), g_strdup(xmp));
+  else if(!xmp && !res)
+    g_hash_table_remove(server->xmp, GINT_TO_POINTER(imgid));
+  else // unknown state, make sure the next job reads its history again
+    g_hash_table_insert(server->xmp, GINT_TO_POINTER(imgid), g_strdup(""));
+  dt_pthread_mutex_unlock(&server->images_mutex);
+
+  return res;
+}
+
+static void _job_run(gpointer data, gpointer user_data)
+{
+  dt_cli_job_t *job = (dt_cli_job_t *)data;
+  dt_cli_server_t *server = (dt_cli_server_t *)user_data;
+  const double start = dt_get_wtime();
+
+#ifdef _OPENMP
+  // the workers share the cores instead of each starting a full team of threads
+  omp_set_num_threads(MAX(1, dt_get_num_threads() / server->workers));
+#endif
+
+  gchar *error = NULL;
+  dt_pthread_mutex_lock(&server->import_mutex);
+  GList *ids = dt_cli_import_images(job->input, &error);
+  dt_pthread_mutex_unlock(&server->import_mutex);
+  if(!ids)
+  {
+    _reply(job->connection, job->id, "error", error ? error : _("no images to export, aborting"), -1, 0.0);
+    g_free(error);
+    _job_free(job);
+    return;
+  }
+
+  ids = g_list_sort(ids, _sort_ids);
+  _images_acquire(server, ids);
+
+  int res = 0;
+  for(GList *iter = ids; iter && !res; iter = g_list_next(iter))
+  {
+    if(_apply_xmp(server, GPOINTER_TO_INT(iter->data), job->xmp))
+    {
+      error = g_strdup_printf(_("error: can't open xmp file %s"), job->xmp ? job->xmp : job->input);
+      res = 1;
+    }
+  }
+
+  if(!res) res = dt_cli_export_images(ids, &job->params, &error);
+
+  _images_release(server, ids);
+
+  if(res)
+    _reply(job->connection, job->id, "error", error, -1, 0.0);
+  else
+    _reply(job->connection, job->id, "done", NULL, g_list_length(ids), dt_get_wtime() - start);
+
+  g_free(error);
+  g_list_free(ids);
+  _job_free(job);
+}
+
+static gchar *_get_string(JsonObject *obj, const char *name)
+{
+  JsonNode *node = json_object_get_member(obj, name);
+  if(!node || JSON_NODE_TYPE(node) != JSON_NODE_VALUE || json_node_get_value_type(node) != G_TYPE_STRING)
+    return NULL;
+  return g_strdup(json_node_get_string(node));
+}
+
+static int _get_int(JsonObject *obj, const char *name, const int def)
+{
+  JsonNode *node = json_object_get_member(obj, name);
+  if(!node || JSON_NODE_TYPE(node) != JSON_NODE_VALUE) return def;
+  return MAX((int)json_node_get_int(node), 0);
+}
+
+static gboolean _get_bool(JsonObject *obj, const char *name, const gboolean def)
+{
+  JsonNode *node = json_object_get_member(obj, name);
+  if(!node || JSON_NODE_TYPE(node) != JSON_NODE_VALUE) return def;
+  return json_node_get_boolean(node);
+}
+
+// parse one request. returns FALSE if the server should quit
+static gboolean _handle_line(dt_cli_connection_t *c, const char *line)
+{
+  dt_cli_server_t *server = c->server;
+
+  // skip empty lines
+  const char *p = line;
+  while(g_ascii_isspace(*p)) p++;
+  if(!*p) return TRUE;
+
+  JsonParser *parser = json_parser_new();
+  GError *error = NULL;
+  if(!json_parser_load_from_data(parser, line, -1, &error) || !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser)))
+  {
+    _reply(c, NULL, "error", error ? error->message : _("a job has to be a json object"), -1, 0.0);
+    if(error) g_error_free(error);
+    g_object_unref(parser);
+    return TRUE;
+  }
+
+  JsonObject *obj = json_node_get_object(json_parser_get_root(parser));
+  JsonNode *id = json_object_get_member(obj, "id");
+  gchar *command = _get_string(obj, "command");
+  gboolean keep_going = TRUE;
+
+  if(command)
+  {
+    if(!strcmp(command, "quit"))
+    {
+      keep_going = FALSE;
+      _reply(c, id, "quit", NULL, -1, 0.0);
+    }
+    else if(!strcmp(command, "stats"))
+      _reply_stats(c, id);
+    else
+      _reply(c, id, "error", _("unknown command"), -1, 0.0);
+  }
+  else
+  {
+    dt_cli_job_t *job = (dt_cli_job_t *)calloc(1, sizeof(dt_cli_job_t));
+    job->connection = _connection_ref(c);
+    job->id = id ? json_node_copy(id) : NULL;
+    job->input = _get_string(obj, "input");
+    job->xmp = _get_string(obj, "xmp");
+    job->output = _get_string(obj, "output");
+    job->style = _get_string(obj, "style");
+
+    const dt_cli_export_t *def = server->defaults;
+    job->params.output_filename = job->output;
+    job->params.width = _get_int(obj, "width", def->width);
+    job->params.height = _get_int(obj, "height", def->height);
+    job->params.high_quality = _get_bool(obj, "hq", def->high_quality);
+    job->params.upscale = _get_bool(obj, "upscale", def->upscale);
+    job->params.export_masks = _get_bool(obj, "export_masks", def->export_masks);
+    job->params.style = job->style ? job->style : def->style;
+    job->params.style_overwrite = _get_bool(obj, "style_overwrite", def->style_overwrite);
+
+    if(!job->input || !job->output)
+    {
+      _reply(c, job->id, "error", _("a job needs an input and an output file"), -1, 0.0);
+      _job_free(job);
+    }
+    else if(g_file_test(job->output, G_FILE_TEST_IS_DIR))
+    {
+      _reply(c, job->id, "error", _("error: output file is a directory. please specify file name"), -1, 0.0);
+      _job_free(job);
+    }
+    else
+    {
+      _reply(c, job->id, "queued", NULL, -1, 0.0);
+      g_thread_pool_push(server->pool, job, NULL);
+    }
+  }
+
+  g_free(command);
+  g_object_unref(parser);
+  return keep_going;
+}
+
+static gboolean _read_line(FILE *in, GString *line)
+{
+  char buf[4096];
+  g_string_truncate(line, 0);
+  while(fgets(buf, sizeof(buf), in))
+  {
+    g_string_append(line, buf);
+    if(line->len && line->str[line->len - 1] == '\n') return TRUE;
+  }
+  return line->len > 0;
+}
+
+static void _read_jobs(dt_cli_connection_t *c)
+{
+  GString *line = g_string_new(NULL);
+  while(!g_atomic_int_get(&c->server->quit) && _read_line(c->in, line))
+  {
+    if(!_handle_line(c, line->str)) g_atomic_int_set(&c->server->quit, 1);
+  }
+  g_string_free(line, TRUE);
+}
+
+static gpointer _client_thread(gpointer data)
+{
+  dt_cli_connection_t *c = (dt_cli_connection_t *)data;
+  dt_cli_server_t *server = c->server;
+
+  _read_jobs(c);
+
+  dt_pthread_mutex_lock(&server->connections_mutex);
+  server->connections = g_list_remove(server->connections, c);
+  pthread_cond_broadcast(&server->connections_cond);
+  dt_pthread_mutex_unlock(&server->connections_mutex);
+
+  _connection_unref(c);
+  return NULL;
+}
+
+static int _listen(const char *path)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  if(strlen(path) >= sizeof(addr.sun_path)) return -1;
+  addr.sun_family = AF_UNIX;
+  g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+  // remove a stale socket of an earlier run, but never anything else
+  struct stat st;
+  if(!stat(path, &st) && S_ISSOCK(st.st_mode)) unlink(path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16))
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int _serve_socket(dt_cli_server_t *server, const char *socket_path)
+{
+  const int listen_fd = _listen(socket_path);
+  if(listen_fd < 0)
+  {
+    fprintf(stderr, "%s `%s': %s\n", _("error: can't listen on socket"), socket_path, g_strerror(errno));
+    return 1;
+  }
+
+  // clients going away while we write their replies must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  while(!g_atomic_int_get(&server->quit))
+  {
+    struct pollfd pfd = { .fd = listen_fd, .events = POLLIN, .revents = 0 };
+    if(poll(&pfd, 1, 250) <= 0) continue;
+
+    const int fd = accept(listen_fd, NULL, NULL);
+    if(fd < 0) continue;
+    FILE *in = fdopen(fd, "r");
+    if(!in)
+    {
+      close(fd);
+      continue;
+    }
+
+    dt_cli_connection_t *c = _connection_new(server, fd, in, fd);
+    dt_pthread_mutex_lock(&server->connections_mutex);
+    server->connections = g_list_prepend(server->connections, c);
+    dt_pthread_mutex_unlock(&server->connections_mutex);
+    g_thread_unref(g_thread_new("cli client", _client_thread, c));
+  }
+
+  close(listen_fd);
+  unlink(socket_path);
+
+  // wake up the readers still waiting for their clients and wait for them to finish
+  dt_pthread_mutex_lock(&server->connections_mutex);
+  for(GList *iter = server->connections; iter; iter = g_list_next(iter))
+    shutdown(((dt_cli_connection_t *)iter->data)->fd, SHUT_RD);
+  while(server->connections) dt_pthread_cond_wait(&server->connections_cond, &server->connections_mutex);
+  dt_pthread_mutex_unlock(&server->connections_mutex);
+
+  return 0;
+}
+
+static int _serve_stdin(dt_cli_server_t *server)
+{
+  // the replies get stdout for themselves, everything else printed goes to stderr instead
+  const int out = dup(STDOUT_FILENO);
+  if(out < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+  {
+    fprintf(stderr, "%s: %s\n", _("error: can't redirect stdout"), g_strerror(errno));
+    if(out >= 0) close(out);
+    return 1;
+  }
+
+  dt_cli_connection_t *c = _connection_new(server, -1, stdin, out);
+  _read_jobs(c);
+  _connection_unref(c);
+
+  // the last reference might be held by a job still running
+  g_thread_pool_free(server->pool, FALSE, TRUE);
+  server->pool = NULL;
+  close(out);
+  return 0;
+}
+
+int dt_cli_server_run(const char *socket_path, const int workers, const dt_cli_export_t *defaults)
+{
+  dt_cli_server_t server;
+  memset(&server, 0, sizeof(server));
+  server.defaults = defaults;
+  server.workers = workers > 0 ? workers : CLAMP(dt_get_num_threads() / 4, 1, 4);
+  dt_pthread_mutex_init(&server.connections_mutex, NULL);
+  pthread_cond_init(&server.connections_cond, NULL);
+  dt_pthread_mutex_init(&server.import_mutex, NULL);
+  dt_pthread_mutex_init(&server.images_mutex, NULL);
+  pthread_cond_init(&server.images_cond, NULL);
+  server.busy = g_hash_table_new(g_direct_hash, g_direct_equal);
+  server.xmp = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+  GError *error = NULL;
+  server.pool = g_thread_pool_new(_job_run, &server, server.workers, FALSE, &error);
+  if(!server.pool)
+  {
+    fprintf(stderr, "[dt_cli_server_run] can't start the workers: %s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  fprintf(stderr, "[dt_cli_server_run] rendering with %d workers, reading jobs from %s\n", server.workers,
+          socket_path ? socket_path : "stdin");
+
+  const int res = socket_path ? _serve_socket(&server, socket_path) : _serve_stdin(&server);
+
+  // let the jobs already queued finish
+  if(server.pool) g_thread_pool_free(server.pool, FALSE, TRUE);
+
+  g_hash_table_destroy(server.busy);
+  g_hash_table_destroy(server.xmp);
+  pthread_cond_destroy(&server.images_cond);
+  dt_pthread_mutex_destroy(&server.images_mutex);
+  dt_pthread_mutex_destroy(&server.import_mutex);
+  pthread_cond_destroy(&server.connections_cond);
+  dt_pthread_mutex_destroy(&server.connections_mutex);
+  return res;
+}
+
+#else // _WIN32
+
+int dt_cli_server_run(const char *socket_path, const int workers, const dt_cli_export_t *defaults)
+{
+  fprintf(stderr, "%s\n", _("error: server mode is not supported on windows"));
+  return 1;
+}
+
+#endif // _WIN32
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,45 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+/** everything needed to export a list of images from darktable-cli */
+typedef struct dt_cli_export_t
+{
+  const char *output_filename; // the extension selects the format
+  int width, height;
+  gboolean high_quality, upscale, export_masks;
+  const char *style;
+  gboolean style_overwrite;
+} dt_cli_export_t;
+
+/** import a file or a folder, returns the image ids or NULL and a translated message in *error */
+GList *dt_cli_import_images(const char *input_filename, gchar **error);
+/** export the images to disk, returns 0 on success or 1 and a translated message in *error */
+int dt_cli_export_images(GList *id_list, const dt_cli_export_t *params, gchar **error);
+
+/** serve render jobs, read as line-delimited json from stdin or, if socket_path is given, from the clients
+ * of a unix socket. up to workers jobs are rendered concurrently (0 picks a default), the options of each job
+ * default to defaults. returns when the input ends or a quit command was received. */
+int dt_cli_server_run(const char *socket_path, const int workers, const dt_cli_export_t *defaults);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -340,9 +340,18 @@ static void dt_codepaths_init()
   }
 }
 
+// with -d perf print the time spent in one phase of the startup and start timing the next one
+static void _init_phase_done(const char *phase, double *phase_start)
+{
+  const double now = dt_get_wtime();
+  dt_print(DT_DEBUG_PERF, "[init] %-16s %9.3f ms\n", phase, 1000.0 * (now - *phase_start));
+  *phase_start = now;
+}
+
 int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load_data, lua_State *L)
 {
   double start_wtime = dt_get_wtime();
+  double phase_wtime = start_wtime;
 
 #ifndef _WIN32
   if(getuid() == 0 || geteuid() == 0)
@@ -447,9 +456,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_pthread_mutex_init(&(darktable.plugin_threadsafe), NULL);
   dt_pthread_mutex_init(&(darktable.dev_threadsafe), NULL);
   dt_pthread_mutex_init(&(darktable.capabilities_threadsafe), NULL);
-  dt_pthread_mutex_init(&(darktable.exiv2_threadsafe), NULL);
+  // recursive: exiv2 may re-enter the xmp toolkit lock, see dt_exif_init()
+  dt_pthread_mutex_init(&(darktable.exiv2_threadsafe), &(recursive_locking));
   dt_pthread_mutex_init(&(darktable.readFile_mutex), NULL);
   darktable.control = (dt_control_t *)calloc(1, sizeof(dt_control_t));
+  dt_control_jobs_stats_init(darktable.control);
 
   // database
   char *dbfilename_from_command = NULL;
@@ -778,9 +789,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #ifdef USE_LUA
   dt_lua_init_early(L);
 #endif
+  _init_phase_done("arguments", &phase_wtime);
 
   // thread-safe init:
   dt_exif_init();
+  _init_phase_done("exiv2", &phase_wtime);
   char datadir[PATH_MAX] = { 0 };
   dt_loc_get_user_config_dir(datadir, sizeof(datadir));
   char darktablerc[PATH_MAX] = { 0 };
@@ -829,9 +842,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // detect cpu features and decide which codepaths to enable
   dt_codepaths_init();
+  _init_phase_done("config", &phase_wtime);
 
   // get the list of color profiles
   darktable.color_profiles = dt_colorspaces_init();
+  _init_phase_done("color profiles", &phase_wtime);
 
   // initialize the database
   darktable.db = dt_database_init(dbfilename_from_command, load_data, init_gui);
@@ -875,19 +890,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   //db maintenance on startup (if configured to do so)
   dt_database_maybe_maintenance(darktable.db, init_gui, FALSE);
+  _init_phase_done("database", &phase_wtime);
 
   // Initialize the signal system
   darktable.signals = dt_control_signal_init();
 
-  // Make sure that the database and xmp files are in sync
-  // We need conf and db to be up and running for that which is the case here.
-  // FIXME: is this also useful in non-gui mode?
-  GList *changed_xmp_files = NULL;
-  if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
-  {
-    changed_xmp_files = dt_control_crawler_run();
-  }
-
   if(init_gui)
   {
     dt_control_init(darktable.control);
@@ -916,6 +923,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.guides = dt_guides_init();
 
   darktable.themes = NULL;
+  _init_phase_done("control", &phase_wtime);
 
 #ifdef HAVE_GRAPHICSMAGICK
   /* GraphicsMagick init */
@@ -932,6 +940,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #ifdef HAVE_OPENCL
   dt_opencl_init(darktable.opencl, exclude_opencl, print_statistics);
 #endif
+  _init_phase_done("opencl", &phase_wtime);
 
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
@@ -945,6 +954,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
+  _init_phase_done("caches", &phase_wtime);
 
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
@@ -959,12 +969,14 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
       return 1;
     }
     dt_bauhaus_init();
+    _init_phase_done("gtk", &phase_wtime);
   }
   else
     darktable.gui = NULL;
 
   darktable.view_manager = (dt_view_manager_t *)calloc(1, sizeof(dt_view_manager_t));
   dt_view_manager_init(darktable.view_manager);
+  _init_phase_done("views", &phase_wtime);
 
   // check whether we were able to load darkroom view. if we failed, we'll crash everywhere later on.
   if(!darktable.develop)
@@ -975,6 +987,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.imageio = (dt_imageio_t *)calloc(1, sizeof(dt_imageio_t));
   dt_imageio_init(darktable.imageio);
+  _init_phase_done("imageio", &phase_wtime);
 
   // load default iop order
   darktable.iop_order_list = dt_ioppr_get_iop_order_list(0, FALSE);
@@ -994,6 +1007,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // set up the list of exiv2 metadata
   dt_exif_set_exiv2_taglist();
+  _init_phase_done("iop modules", &phase_wtime);
 
   if(init_gui)
   {
@@ -1005,6 +1019,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
     darktable.lib = (dt_lib_t *)calloc(1, sizeof(dt_lib_t));
     dt_lib_init(darktable.lib);
+    _init_phase_done("lib modules", &phase_wtime);
 
     dt_gui_gtk_load_config();
 
@@ -1029,6 +1044,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
     // initialize undo struct
     darktable.undo = dt_undo_init();
+    _init_phase_done("gui", &phase_wtime);
   }
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
@@ -1043,6 +1059,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #ifdef USE_LUA
   dt_lua_init(darktable.lua_state.state, lua_command);
 #endif
+  _init_phase_done("lua", &phase_wtime);
 
   if(init_gui)
   {
@@ -1098,14 +1115,16 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #endif
   }
 
-  // last but not least construct the popup that asks the user about images whose xmp files are newer than the
-  // db entry
-  if(init_gui && changed_xmp_files)
+  // last but not least make sure that the database and xmp files are in sync. this runs in the background
+  // and pops up a list of images whose xmp files are newer than the db entry once it finds some.
+  // FIXME: is this also useful in non-gui mode?
+  if(init_gui)
   {
-    dt_control_crawler_show_image_list(changed_xmp_files);
+    dt_control_crawler_init(dt_conf_get_bool("run_crawler_on_start"));
   }
+  _init_phase_done("first view", &phase_wtime);
 
-  dt_print(DT_DEBUG_CONTROL, "[init] startup took %f seconds\n", dt_get_wtime() - start_wtime);
+  dt_print(DT_DEBUG_CONTROL | DT_DEBUG_PERF, "[init] startup took %f seconds\n", dt_get_wtime() - start_wtime);
 
   return 0;
 }
@@ -1129,6 +1148,7 @@ void dt_cleanup()
     dt_dbus_destroy(darktable.dbus);
 
     dt_control_shutdown(darktable.control);
+    dt_control_crawler_cleanup();
 
     dt_lib_cleanup(darktable.lib);
     free(darktable.lib);
@@ -1138,6 +1158,15 @@ void dt_cleanup()
 #endif
   dt_view_manager_cleanup(darktable.view_manager);
   free(darktable.view_manager);
+
+  if(darktable.unmuted & DT_DEBUG_PERF)
+  {
+    gchar *job_stats = dt_control_jobs_stats_json(darktable.control);
+    dt_print(DT_DEBUG_PERF, "[jobs] statistics:\n%s", job_stats);
+    g_free(job_stats);
+  }
+  dt_control_jobs_stats_cleanup(darktable.control);
+
   if(init_gui)
   {
     dt_imageio_cleanup(darktable.imageio);
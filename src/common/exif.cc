@@ -67,6 +67,7 @@ extern "C" {
 #include "common/utility.h"
 #include "common/history.h"
 #include "control/conf.h"
+#include "control/crawler.h"
 #include "develop/imageop.h"
 #include "develop/blend.h"
 #include "develop/masks.h"
@@ -157,11 +158,26 @@ static void _get_xmp_tags(const char *prefix, GList **taglist)
   }
 }
 
+static void _exif_xmp_lock(void *data, bool lock)
+{
+  dt_pthread_mutex_t *mutex = (dt_pthread_mutex_t *)data;
+  if(lock)
+    dt_pthread_mutex_lock(mutex);
+  else
+    dt_pthread_mutex_unlock(mutex);
+}
+
+// only the first call has an effect, so every initialization has to install the lock
+static void _exif_xmp_initialize()
+{
+  Exiv2::XmpParser::initialize(_exif_xmp_lock, &darktable.exiv2_threadsafe);
+}
+
 void dt_exif_set_exiv2_taglist()
 {
   if(exiv2_taglist) return;
 
-  Exiv2::XmpParser::initialize();
+  _exif_xmp_initialize();
   ::atexit(Exiv2::XmpParser::terminate);
 
   try
@@ -273,7 +289,14 @@ static const char *_exif_get_exiv2_tag_type(const char *tagname)
 
 // exiv2's readMetadata is not thread safe in 0.26. so we lock it. since readMetadata might throw an exception we
 // wrap it into some c++ magic to make sure we unlock in all cases. well, actually not magic but basic raii.
-// FIXME: check again once we rely on 0.27
+// from 0.27 on different files can be read concurrently. the only shared state left is the xmp toolkit, and
+// exiv2 serializes all calls into it through the lock function we pass in _exif_xmp_initialize().
+#if EXIV2_VERSION >= EXIV2_MAKE_VERSION(0,27,0)
+#define read_metadata_threadsafe(image)                       \
+{                                                             \
+  image->readMetadata();                                      \
+}
+#else
 class Lock
 {
 public:
@@ -286,6 +309,7 @@ public:
   Lock lock;                                                  \
   image->readMetadata();                                      \
 }
+#endif
 
 static void _exif_import_tags(dt_image_t *img, Exiv2::XmpData::iterator &pos);
 static gboolean read_xmp_timestamps(Exiv2::XmpData &xmpData, const int imgid);
@@ -3993,6 +4017,8 @@ int dt_exif_xmp_write(const int imgid, const char *filename)
 
     if(write_sidecar)
     {
+      // this is written in place, the folder monitors have to be told that it's us
+      dt_control_crawler_sidecar_written(filename);
       // using std::ofstream isn't possible here -- on Windows it doesn't support Unicode filenames with mingw
       FILE *fout = g_fopen(filename, "wb");
       if(fout)
@@ -4111,7 +4137,7 @@ void dt_exif_init()
   // preface the exiv2 messages with "[exiv2] "
   Exiv2::LogMsg::setHandler(&dt_exif_log_handler);
 
-  Exiv2::XmpParser::initialize();
+  _exif_xmp_initialize();
   // this has to stay with the old url (namespace already propagated outside dt)
   Exiv2::XmpProperties::registerNs("http://darktable.sf.net/", "darktable");
   Exiv2::XmpProperties::registerNs("http://ns.adobe.com/lightroom/1.0/", "lr");
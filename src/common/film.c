@@ -25,6 +25,9 @@
 #include "control/conf.h"
 #include "control/control.h"
 #include "control/jobs.h"
+#include "control/jobs/image_jobs.h"
+#include "dtgtk/thumbtable.h"
+#include "gui/gtk.h"
 #include "views/view.h"
 
 #include <assert.h>
@@ -83,6 +86,26 @@ void dt_film_set_query(const int32_t id)
   dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_NEW_QUERY, NULL);
 }
 
+// warms the image cache and the thumbnails of the first two pages of the freshly opened film roll in the
+// background, so that the lighttable doesn't miss the caches thumbnail after thumbnail
+static void _film_prefetch(void)
+{
+  if(!darktable.gui || !dt_conf_get_bool("plugins/lighttable/prefetch_on_film_open")) return;
+
+  const dt_thumbtable_t *table = dt_ui_thumbtable(darktable.gui->ui);
+  // no layout yet, the size of the thumbnails isn't known
+  if(!table || table->thumb_size <= 0 || table->thumbs_per_row <= 0) return;
+
+  const int count = 2 * table->thumbs_per_row * MAX(table->rows, 1);
+  const dt_mipmap_size_t mip
+      = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, table->thumb_size, table->thumb_size);
+  GList *imgs = dt_collection_get_all(darktable.collection, count);
+  if(!imgs) return;
+
+  // takes over imgs, and a job that couldn't be created is just dropped
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, dt_image_prefetch_job_create(imgs, mip));
+}
+
 /** open film with given id. */
 int dt_film_open2(dt_film_t *film)
 {
@@ -108,6 +131,7 @@ int dt_film_open2(dt_film_t *film)
 
     sqlite3_finalize(stmt);
     dt_film_set_query(film->id);
+    _film_prefetch();
     dt_control_queue_redraw_center();
     dt_view_manager_reset(darktable.view_manager);
     return 0;
@@ -136,8 +160,8 @@ int dt_film_open(const int32_t id)
     sqlite3_step(stmt);
   }
   sqlite3_finalize(stmt);
-  // TODO: prefetch to cache using image_open
   dt_film_set_query(id);
+  _film_prefetch();
   dt_control_queue_redraw_center();
   dt_view_manager_reset(darktable.view_manager);
   return 0;
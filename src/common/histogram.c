@@ -305,55 +305,70 @@ inline static void histogram_helper_cs_Lab_LCh(const dt_dev_histogram_collection
 
 //==============================================================================
 
+void dt_histogram_reduce(uint32_t *const slabs, const int nslabs, const size_t bins)
+{
+  // pairwise tree: on each level slab n gets slab n + stride added, for every n that is a multiple of
+  // 2 * stride. all pairs and chunks of bins of one level are independent, and the inner loop vectorizes.
+  const int chunk = 1024;
+  const int chunks = (bins + chunk - 1) / chunk;
+  for(int stride = 1; stride < nslabs; stride *= 2)
+  {
+    const int pairs = (nslabs + stride - 1) / (2 * stride);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(slabs, bins, stride, pairs, chunk, chunks) \
+  schedule(static) collapse(2)
+#endif
+    for(int p = 0; p < pairs; p++)
+    {
+      for(int c = 0; c < chunks; c++)
+      {
+        uint32_t *const dst = slabs + (size_t)2 * stride * p * bins;
+        const uint32_t *const src = dst + (size_t)stride * bins;
+        const size_t end = MIN(bins, (size_t)(c + 1) * chunk);
+#ifdef _OPENMP
+#pragma omp SIMD()
+#endif
+        for(size_t k = (size_t)c * chunk; k < end; k++) dst[k] += src[k];
+      }
+    }
+  }
+}
+
 void dt_histogram_worker(dt_dev_histogram_collection_params_t *const histogram_params,
                          dt_dev_histogram_stats_t *histogram_stats, const void *const pixel,
                          uint32_t **histogram, const dt_worker Worker,
                          const dt_iop_order_iccprofile_info_t *const profile_info)
 {
-  const int nthreads = omp_get_max_threads();
+  const dt_histogram_roi_t *const roi = histogram_params->roi;
+  const int rows = roi->height - roi->crop_height - roi->crop_y;
 
+  // one slab of bins per thread with rows to work on, each slab on cache lines of its own
+  const int nthreads = MAX(1, MIN(dt_get_num_threads(), rows));
   const size_t bins_total = (size_t)4 * histogram_params->bins_count;
+  const size_t slab = (bins_total + 15) & ~(size_t)15;
   const size_t buf_size = bins_total * sizeof(uint32_t);
-  void *partial_hists = calloc(nthreads, buf_size);
+  uint32_t *partial_hists = dt_alloc_align(64, slab * nthreads * sizeof(uint32_t));
+  memset(partial_hists, 0, slab * nthreads * sizeof(uint32_t));
 
   if(histogram_params->mul == 0) histogram_params->mul = (double)(histogram_params->bins_count - 1);
 
-  const dt_histogram_roi_t *const roi = histogram_params->roi;
-
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(histogram_params, pixel, Worker, profile_info, bins_total, roi) \
-  shared(partial_hists) \
-  schedule(static)
+  dt_omp_firstprivate(histogram_params, pixel, Worker, profile_info, slab, roi, partial_hists) \
+  schedule(static) num_threads(nthreads)
 #endif
   for(int j = roi->crop_y; j < roi->height - roi->crop_height; j++)
   {
-    uint32_t *thread_hist = (uint32_t *)partial_hists + bins_total * omp_get_thread_num();
+    uint32_t *thread_hist = partial_hists + slab * omp_get_thread_num();
     Worker(histogram_params, pixel, thread_hist, j, profile_info);
   }
 
-#ifdef _OPENMP
-  *histogram = realloc(*histogram, buf_size);
-  memset(*histogram, 0, buf_size);
-  uint32_t *hist = *histogram;
+  dt_histogram_reduce(partial_hists, nthreads, slab);
 
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nthreads, bins_total) \
-  shared(hist, partial_hists) \
-  schedule(static)
-  for(size_t k = 0; k < bins_total; k++)
-  {
-    for(size_t n = 0; n < nthreads; n++)
-    {
-      const uint32_t *thread_hist = (uint32_t *)partial_hists + bins_total * n;
-      hist[k] += thread_hist[k];
-    }
-  }
-#else
   *histogram = realloc(*histogram, buf_size);
-  memmove(*histogram, partial_hists, buf_size);
-#endif
-  free(partial_hists);
+  memcpy(*histogram, partial_hists, buf_size);
+  dt_free_align(partial_hists);
 
   histogram_stats->bins_count = histogram_params->bins_count;
   histogram_stats->pixels = (roi->width - roi->crop_width - roi->crop_x)
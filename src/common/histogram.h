@@ -44,6 +44,9 @@ typedef void((*dt_worker)(const dt_dev_histogram_collection_params_t *const hist
                           const void *pixel, uint32_t *histogram, int j,
                           const dt_iop_order_iccprofile_info_t *const profile_info));
 
+/** sum up nslabs consecutive slabs of bins (thread private histograms) into the first one */
+void dt_histogram_reduce(uint32_t *const slabs, const int nslabs, const size_t bins);
+
 void dt_histogram_worker(dt_dev_histogram_collection_params_t *const histogram_params,
                          dt_dev_histogram_stats_t *histogram_stats, const void *const pixel,
                          uint32_t **histogram, const dt_worker Worker,
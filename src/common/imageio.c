@@ -46,6 +46,7 @@
 #include "common/imageio_avif.h"
 #endif
 #include "common/mipmap_cache.h"
+#include "common/rawcache.h"
 #include "common/styles.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -68,6 +69,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #ifdef USE_LUA
 #include "lua/image.h"
@@ -331,6 +335,149 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
   }
 }
 
+__DT_CLONE_TARGETS__
+void dt_imageio_float_to_ui8(uint8_t *const out, const float *const in, const size_t npixels,
+                             const gboolean swap_rb)
+{
+  // channel order of the output, the alpha byte is always written as zero
+  const int r = swap_rb ? 2 : 0;
+  const int b = swap_rb ? 0 : 2;
+#if defined(__SSE2__)
+  if(darktable.codepath.SSE2)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(out, in, npixels, swap_rb) \
+    schedule(static)
+#endif
+    for(size_t k = 0; k < npixels; k++)
+    {
+      __m128 v = _mm_loadu_ps(in + 4 * k);
+      if(swap_rb) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_setzero_ps()), _mm_set1_ps(255.0f));
+      // zero the alpha lane, then round half up like the plain path does and saturate down to 8 bits
+      v = _mm_and_ps(_mm_add_ps(v, _mm_set1_ps(0.5f)), _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+      const __m128i i32 = _mm_cvttps_epi32(v);
+      const __m128i i16 = _mm_packs_epi32(i32, i32);
+      const uint32_t px = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+      memcpy(out + 4 * k, &px, sizeof(px));
+    }
+    return;
+  }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(out, in, npixels, r, b) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    out[4 * k + 0] = (uint8_t)(CLAMPS(in[4 * k + r], 0.0f, 1.0f) * 255.0f + 0.5f);
+    out[4 * k + 1] = (uint8_t)(CLAMPS(in[4 * k + 1], 0.0f, 1.0f) * 255.0f + 0.5f);
+    out[4 * k + 2] = (uint8_t)(CLAMPS(in[4 * k + b], 0.0f, 1.0f) * 255.0f + 0.5f);
+    out[4 * k + 3] = 0;
+  }
+}
+
+__DT_CLONE_TARGETS__
+void dt_imageio_float_to_ui16(uint16_t *const out, const float *const in, const size_t npixels)
+{
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(out, in, npixels) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    for(int c = 0; c < 3; c++)
+      out[4 * k + c] = (uint16_t)(CLAMPS(in[4 * k + c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+    out[4 * k + 3] = 0;
+  }
+}
+
+__DT_CLONE_TARGETS__
+void dt_imageio_swap_rb_ui8(uint8_t *const buf, const size_t npixels)
+{
+  // work on whole 32-bit pixels so the compiler can turn this into byte shuffles
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(buf, npixels) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    uint32_t px;
+    memcpy(&px, buf + 4 * k, sizeof(px));
+    uint8_t *const c = (uint8_t *)&px;
+    const uint8_t tmp = c[0];
+    c[0] = c[2];
+    c[2] = tmp;
+    memcpy(buf + 4 * k, &px, sizeof(px));
+  }
+}
+
+__DT_CLONE_TARGETS__
+void dt_imageio_rgba_to_rgb_ui8(uint8_t *const out, const uint8_t *const in, const size_t npixels)
+{
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(out, in, npixels) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    out[3 * k + 0] = in[4 * k + 0];
+    out[3 * k + 1] = in[4 * k + 1];
+    out[3 * k + 2] = in[4 * k + 2];
+  }
+}
+
+__DT_CLONE_TARGETS__
+void dt_imageio_rgba_to_rgb_ui16(uint16_t *const out, const uint16_t *const in, const size_t npixels)
+{
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(out, in, npixels) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    out[3 * k + 0] = in[4 * k + 0];
+    out[3 * k + 1] = in[4 * k + 1];
+    out[3 * k + 2] = in[4 * k + 2];
+  }
+}
+
+/* the packed pixels are smaller than the float ones, so converting in place only ever overwrites floats of
+ * pixels which come before the ones being read. a chunk [start, ratio * start) lands on the floats of
+ * [start / ratio, start), which have all been converted by the earlier chunks, so every chunk can run in
+ * parallel. the first pixel overlaps itself and goes through a copy. */
+static void _float_to_ui8_in_place(void *const buf, const size_t npixels, const gboolean swap_rb)
+{
+  if(npixels == 0) return;
+  float first[4];
+  memcpy(first, buf, sizeof(first));
+  dt_imageio_float_to_ui8((uint8_t *)buf, first, 1, swap_rb);
+  for(size_t start = 1; start < npixels; start = MIN(4 * start, npixels))
+  {
+    const size_t end = MIN(4 * start, npixels);
+    dt_imageio_float_to_ui8((uint8_t *)buf + 4 * start, (const float *)buf + 4 * start, end - start, swap_rb);
+  }
+}
+
+static void _float_to_ui16_in_place(void *const buf, const size_t npixels)
+{
+  if(npixels == 0) return;
+  float first[4];
+  memcpy(first, buf, sizeof(first));
+  dt_imageio_float_to_ui16((uint16_t *)buf, first, 1);
+  for(size_t start = 1; start < npixels; start = MIN(2 * start, npixels))
+  {
+    const size_t end = MIN(2 * start, npixels);
+    dt_imageio_float_to_ui16((uint16_t *)buf + 4 * start, (const float *)buf + 4 * start, end - start);
+  }
+}
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation)
 {
@@ -830,75 +977,26 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                          : "[dev_process_export] pixel pipeline processing");
 
   uint8_t *outbuf = pipe.backbuf;
+  const size_t npixels = (size_t)processed_width * processed_height;
 
-  // downconversion to low-precision formats:
+  // downconversion to low-precision formats, in place:
   if(bpp == 8)
   {
-    if(display_byteorder)
+    if(high_quality_processing)
     {
-      if(high_quality_processing)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      // else processing output was 8-bit already, and no need to swap order
+      // ldr output: char, in display byte order (bgr) if requested
+      _float_to_ui8_in_place(outbuf, npixels, display_byteorder);
     }
-    else // need to flip
+    else if(!display_byteorder)
     {
-      // ldr output: char
-      if(high_quality_processing)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(processed_width, processed_height, buf8) \
-  schedule(static)
-#endif
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
-      }
+      // processing output was 8-bit bgr already, just flip byte order
+      dt_imageio_swap_rb_ui8(outbuf, npixels);
     }
   }
   else if(bpp == 16)
   {
     // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
-      {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++) buf16[4 * k + i] = CLAMP(buff[4 * k + i] * 0x10000, 0, 0xffff);
-      }
+    _float_to_ui16_in_place(outbuf, npixels);
   }
   // else output float, no further harm done to the pixels :)
 
@@ -1059,6 +1157,10 @@ dt_imageio_retval_t dt_imageio_open(dt_image_t *img,               // non-const
   if(ret != DT_IMAGEIO_OK && ret != DT_IMAGEIO_CACHE_FULL && dt_imageio_is_hdr(filename))
     ret = dt_imageio_open_hdr(img, filename, buf);
 
+  /* decoded sensor data from a previous run, only raws ever get stored */
+  if(ret != DT_IMAGEIO_OK && ret != DT_IMAGEIO_CACHE_FULL && buf && dt_rawcache_load(img, filename, buf))
+    ret = DT_IMAGEIO_OK;
+
   /* use rawspeed to load the raw */
   if(ret != DT_IMAGEIO_OK && ret != DT_IMAGEIO_CACHE_FULL)
   {
@@ -1067,6 +1169,7 @@ dt_imageio_retval_t dt_imageio_open(dt_image_t *img,               // non-const
     {
       img->buf_dsc.cst = iop_cs_RAW;
       img->loader = LOADER_RAWSPEED;
+      if(buf) dt_rawcache_store(img, filename, buf);
     }
   }
 
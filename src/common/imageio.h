@@ -101,6 +101,20 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
                                           const int fht, const int stride,
                                           const dt_image_orientation_t orientation);
 
+// pixel format conversion kernels for the export tail, all work on 4-channel pixels:
+// float rgba in [0,1] to 8-bit, optionally swapping red and blue (display byte order)
+void dt_imageio_float_to_ui8(uint8_t *const out, const float *const in, const size_t npixels,
+                             const gboolean swap_rb);
+// float rgba in [0,1] to 16-bit, rounded to nearest
+void dt_imageio_float_to_ui16(uint16_t *const out, const float *const in, const size_t npixels);
+// in-place rgba <-> bgra swizzle of 8-bit pixels
+void dt_imageio_swap_rb_ui8(uint8_t *const buf, const size_t npixels);
+// drop the alpha channel of 8/16-bit rgba pixels. writers pack bands of this many rows at a time so the
+// work is worth spreading over the threads without a full-frame copy:
+#define DT_IMAGEIO_PACK_ROWS 64
+void dt_imageio_rgba_to_rgb_ui8(uint8_t *const out, const uint8_t *const in, const size_t npixels);
+void dt_imageio_rgba_to_rgb_ui16(uint16_t *const out, const uint16_t *const in, const size_t npixels);
+
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
                                dt_colorspaces_color_profile_type_t *color_space);
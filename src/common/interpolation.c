@@ -1179,6 +1179,203 @@ void dt_interpolation_compute_pixel1c(const struct dt_interpolation *itor, const
   return dt_interpolation_compute_pixel1c_plain(itor, in, out, x, y, width, height, linestride);
 }
 
+/* --------------------------------------------------------------------------
+ * Row interpolation functions (see usage in common/warp.c)
+ *
+ * same results as calling the pixel functions above for each coordinate, but
+ * the kernels are only recomputed when the coordinate changes, which saves the
+ * vertical kernel on all rows of an axis aligned mapping.
+ * ------------------------------------------------------------------------*/
+
+static inline int _is_inner(const struct dt_interpolation *itor, const int ix, const int iy, const int width,
+                            const int height)
+{
+  return ix >= (itor->width - 1) && iy >= (itor->width - 1) && ix < (width - itor->width)
+         && iy < (height - itor->width);
+}
+
+static void dt_interpolation_compute_row4c_plain(const struct dt_interpolation *itor, const float *in,
+                                                 float *out, const float *const xy, const int n,
+                                                 const int width, const int height, const int linestride)
+{
+  assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
+
+  float kernelh[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  float kernelv[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  float normh = 1.0f, normv = 1.0f;
+  // inner coordinates are never negative
+  float last_x = -1.0f, last_y = -1.0f;
+
+  for(int k = 0; k < n; k++, out += 4)
+  {
+    const float x = xy[2 * k];
+    const float y = xy[2 * k + 1];
+    const int ix = (int)x;
+    const int iy = (int)y;
+
+    if(!_is_inner(itor, ix, iy, width, height))
+    {
+      dt_interpolation_compute_pixel4c_plain(itor, in, out, x, y, width, height, linestride);
+      continue;
+    }
+
+    if(x != last_x)
+    {
+      compute_upsampling_kernel(itor, kernelh, &normh, NULL, x);
+      last_x = x;
+    }
+    if(y != last_y)
+    {
+      compute_upsampling_kernel(itor, kernelv, &normv, NULL, y);
+      last_y = y;
+    }
+    const float oonorm = (1.f / (normh * normv));
+
+    const float *i0 = in + linestride * iy + ix * 4 - (itor->width - 1) * (4 + linestride);
+    float pixel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for(int i = 0; i < 2 * itor->width; i++)
+    {
+      float h[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int j = 0; j < 2 * itor->width; j++)
+      {
+        for(int c = 0; c < 3; c++) h[c] += kernelh[j] * i0[j * 4 + c];
+      }
+      for(int c = 0; c < 3; c++) pixel[c] += kernelv[i] * h[c];
+      i0 += linestride;
+    }
+
+    for(int c = 0; c < 3; c++) out[c] = oonorm * pixel[c];
+  }
+}
+
+#if defined(__SSE2__)
+static void dt_interpolation_compute_row4c_sse(const struct dt_interpolation *itor, const float *in, float *out,
+                                               const float *const xy, const int n, const int width,
+                                               const int height, const int linestride)
+{
+  assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
+
+  float kernelh[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  float kernelv[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  __m128 vkernelh[2 * MAX_HALF_FILTER_WIDTH];
+  __m128 vkernelv[2 * MAX_HALF_FILTER_WIDTH];
+  float normh = 1.0f, normv = 1.0f;
+  // inner coordinates are never negative
+  float last_x = -1.0f, last_y = -1.0f;
+
+  for(int k = 0; k < n; k++, out += 4)
+  {
+    const float x = xy[2 * k];
+    const float y = xy[2 * k + 1];
+    const int ix = (int)x;
+    const int iy = (int)y;
+
+    if(!_is_inner(itor, ix, iy, width, height))
+    {
+      dt_interpolation_compute_pixel4c_sse(itor, in, out, x, y, width, height, linestride);
+      continue;
+    }
+
+    if(x != last_x)
+    {
+      compute_upsampling_kernel(itor, kernelh, &normh, NULL, x);
+      for(int i = 0; i < 2 * itor->width; i++) vkernelh[i] = _mm_set_ps1(kernelh[i]);
+      last_x = x;
+    }
+    if(y != last_y)
+    {
+      compute_upsampling_kernel(itor, kernelv, &normv, NULL, y);
+      for(int i = 0; i < 2 * itor->width; i++) vkernelv[i] = _mm_set_ps1(kernelv[i]);
+      last_y = y;
+    }
+    const __m128 oonorm = _mm_set_ps1(1.f / (normh * normv));
+
+    const float *i0 = in + linestride * iy + ix * 4 - (itor->width - 1) * (4 + linestride);
+    __m128 pixel = _mm_setzero_ps();
+    for(int i = 0; i < 2 * itor->width; i++)
+    {
+      __m128 h = _mm_setzero_ps();
+      for(int j = 0; j < 2 * itor->width; j++)
+      {
+        h = _mm_add_ps(h, _mm_mul_ps(vkernelh[j], *(__m128 *)&i0[j * 4]));
+      }
+      pixel = _mm_add_ps(pixel, _mm_mul_ps(vkernelv[i], h));
+      i0 += linestride;
+    }
+
+    *(__m128 *)out = _mm_mul_ps(pixel, oonorm);
+  }
+}
+#endif
+
+void dt_interpolation_compute_row4c(const struct dt_interpolation *itor, const float *in, float *out,
+                                    const float *const xy, const int n, const int width, const int height,
+                                    const int linestride)
+{
+  if(darktable.codepath.OPENMP_SIMD)
+    return dt_interpolation_compute_row4c_plain(itor, in, out, xy, n, width, height, linestride);
+#if defined(__SSE2__)
+  else if(darktable.codepath.SSE2)
+    return dt_interpolation_compute_row4c_sse(itor, in, out, xy, n, width, height, linestride);
+#endif
+  else
+    dt_unreachable_codepath();
+}
+
+void dt_interpolation_compute_row1c(const struct dt_interpolation *itor, const float *in, float *out,
+                                    const float *const xy, const int n, const int width, const int height,
+                                    const int linestride)
+{
+  assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
+
+  float kernelh[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  float kernelv[MAX_KERNEL_REQ] __attribute__((aligned(SSE_ALIGNMENT)));
+  float normh = 1.0f, normv = 1.0f;
+  // inner coordinates are never negative
+  float last_x = -1.0f, last_y = -1.0f;
+
+  for(int k = 0; k < n; k++, out++)
+  {
+    const float x = xy[2 * k];
+    const float y = xy[2 * k + 1];
+    const int ix = (int)x;
+    const int iy = (int)y;
+
+    if(!_is_inner(itor, ix, iy, width, height))
+    {
+      dt_interpolation_compute_pixel1c_plain(itor, in, out, x, y, width, height, linestride);
+      continue;
+    }
+
+    if(x != last_x)
+    {
+      compute_upsampling_kernel(itor, kernelh, &normh, NULL, x);
+      last_x = x;
+    }
+    if(y != last_y)
+    {
+      compute_upsampling_kernel(itor, kernelv, &normv, NULL, y);
+      last_y = y;
+    }
+    const float oonorm = (1.f / (normh * normv));
+
+    const float *i0 = in + linestride * iy + ix - (itor->width - 1) * (1 + linestride);
+    float pixel = 0.0f;
+    for(int i = 0; i < 2 * itor->width; i++)
+    {
+      float h = 0.0f;
+      for(int j = 0; j < 2 * itor->width; j++)
+      {
+        h += kernelh[j] * i0[j];
+      }
+      pixel += kernelv[i] * h;
+      i0 += linestride;
+    }
+
+    *out = oonorm * pixel;
+  }
+}
+
 /* --------------------------------------------------------------------------
  * Interpolation factory
  * ------------------------------------------------------------------------*/
@@ -1257,6 +1454,7 @@ const struct dt_interpolation *dt_interpolation_new(enum dt_interpolation_type t
  *
  * @param itor interpolator used to resample
  * @param in [in] Number of input samples
+ * @param in_offset [in] Index of the first input sample the buffer holds, subtracted from all indexes
  * @param out [in] Number of output samples
  * @param plength [out] Array of lengths for each pixel filtering (number
  * of taps/indexes to use). This array mus be freed with dt_free_align() when you're
@@ -1268,7 +1466,7 @@ const struct dt_interpolation *dt_interpolation_new(enum dt_interpolation_type t
  * out position meta[3*out]
  * @return 0 for success, !0 for failure
  */
-static int prepare_resampling_plan(const struct dt_interpolation *itor, int in, const int in_x0, int out,
+static int prepare_resampling_plan(const struct dt_interpolation *itor, int in, const int in_offset, int out,
                                    const int out_x0, float scale, int **plength, float **pkernel,
                                    int **pindex, int **pmeta)
 {
@@ -1383,7 +1581,7 @@ static int prepare_resampling_plan(const struct dt_interpolation *itor, int in,
       for(int tap = tap_first; tap < tap_last; tap++)
       {
         kernel[kidx++] = scratchpad[tap] * norm;
-        index[iidx++] = clip(first++, 0, in - 1, bordermode);
+        index[iidx++] = clip(first++, 0, in - 1, bordermode) - in_offset;
       }
     }
   }
@@ -1432,7 +1630,7 @@ static int prepare_resampling_plan(const struct dt_interpolation *itor, int in,
       for(int tap = tap_first; tap < tap_last; tap++)
       {
         kernel[kidx++] = scratchpad[tap] * norm;
-        index[iidx++] = clip(first++, 0, in - 1, bordermode);
+        index[iidx++] = clip(first++, 0, in - 1, bordermode) - in_offset;
       }
     }
   }
@@ -1452,7 +1650,7 @@ static int prepare_resampling_plan(const struct dt_interpolation *itor, int in,
 static void dt_interpolation_resample_plain(const struct dt_interpolation *itor, float *out,
                                             const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                             const float *const in, const dt_iop_roi_t *const roi_in,
-                                            const int32_t in_stride)
+                                            const int32_t in_stride, const int in_y0)
 {
   int *hindex = NULL;
   int *hlength = NULL;
@@ -1477,13 +1675,13 @@ static void dt_interpolation_resample_plain(const struct dt_interpolation *itor,
 #endif
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
+    dt_omp_firstprivate(in, in_stride, in_y0, out_stride, roi_out, x0) \
     shared(out)
 #endif
     for(int y = 0; y < roi_out->height; y++)
     {
       memcpy((char *)out + (size_t)out_stride * y,
-             (char *)in + (size_t)in_stride * (y + roi_out->y) + x0,
+             (char *)in + (size_t)in_stride * (y + roi_out->y - in_y0) + x0,
              out_stride);
     }
 #if DEBUG_RESAMPLING_TIMING
@@ -1500,14 +1698,14 @@ static void dt_interpolation_resample_plain(const struct dt_interpolation *itor,
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->width, 0, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, NULL);
   if(r)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->height, in_y0, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
   if(r)
   {
@@ -1609,7 +1807,7 @@ exit:
 static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, float *out,
                                           const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                           const float *const in, const dt_iop_roi_t *const roi_in,
-                                          const int32_t in_stride)
+                                          const int32_t in_stride, const int in_y0)
 {
   int *hindex = NULL;
   int *hlength = NULL;
@@ -1634,12 +1832,12 @@ static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, f
 #endif
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
+    dt_omp_firstprivate(in, in_stride, in_y0, out_stride, roi_out, x0) \
     shared(out)
 #endif
     for(int y = 0; y < roi_out->height; y++)
     {
-      float *i = (float *)((char *)in + (size_t)in_stride * (y + roi_out->y) + x0);
+      float *i = (float *)((char *)in + (size_t)in_stride * (y + roi_out->y - in_y0) + x0);
       float *o = (float *)((char *)out + (size_t)out_stride * y);
       memcpy(o, i, out_stride);
     }
@@ -1657,14 +1855,14 @@ static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, f
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->width, 0, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, NULL);
   if(r)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->height, in_y0, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
   if(r)
   {
@@ -1770,21 +1968,29 @@ exit:
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
-void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
-                               const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                               const float *const in, const dt_iop_roi_t *const roi_in,
-                               const int32_t in_stride)
+void dt_interpolation_resample_rows(const struct dt_interpolation *itor, float *out,
+                                    const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                                    const float *const in, const int in_y0, const dt_iop_roi_t *const roi_in,
+                                    const int32_t in_stride)
 {
   if(darktable.codepath.OPENMP_SIMD)
-    return dt_interpolation_resample_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+    return dt_interpolation_resample_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride, in_y0);
 #if defined(__SSE2__)
   else if(darktable.codepath.SSE2)
-    return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+    return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride, in_y0);
 #endif
   else
     dt_unreachable_codepath();
 }
 
+void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
+                               const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                               const float *const in, const dt_iop_roi_t *const roi_in,
+                               const int32_t in_stride)
+{
+  dt_interpolation_resample_rows(itor, out, roi_out, out_stride, in, 0, roi_in, in_stride);
+}
+
 /** Applies resampling (re-scaling) on a specific region-of-interest of an image. The input
  *  and output buffers hold exactly those roi's. roi_in and roi_out define the relative
  *  positions of the roi's within the full input and output image, respectively.
@@ -1894,14 +2100,14 @@ int dt_interpolation_resample_cl(const struct dt_interpolation *itor, int devid,
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->width, 0, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, &hmeta);
   if(r)
   {
     goto error;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->height, 0, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
   if(r)
   {
@@ -2107,14 +2313,14 @@ static void dt_interpolation_resample_1c_plain(const struct dt_interpolation *it
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->width, 0, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, NULL);
   if(r)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  r = prepare_resampling_plan(itor, roi_in->height, 0, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
   if(r)
   {
@@ -110,6 +110,16 @@ void dt_interpolation_compute_pixel1c(const struct dt_interpolation *itor, const
                                       const float x, const float y, const int width, const int height,
                                       const int linestride);
 
+// interpolates n pixels at the coordinates xy[2*k], xy[2*k+1], as the functions above would do for each
+// of them, but with kernels reused between pixels on the same row or column.
+void dt_interpolation_compute_row4c(const struct dt_interpolation *itor, const float *in, float *out,
+                                    const float *const xy, const int n, const int width, const int height,
+                                    const int linestride);
+
+void dt_interpolation_compute_row1c(const struct dt_interpolation *itor, const float *in, float *out,
+                                    const float *const xy, const int n, const int width, const int height,
+                                    const int linestride);
+
 /** Get an interpolator from type
  * @param type Interpolator to search for
  * @return requested interpolator or default if not found (this function can't fail)
@@ -142,6 +152,14 @@ void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
                                const float *const in, const dt_iop_roi_t *const roi_in,
                                const int32_t in_stride);
 
+/** Same as dt_interpolation_resample(), but "in" only holds the rows from in_y0 on of the
+ * image described by roi_in. It has to hold all the rows the output reads.
+ */
+void dt_interpolation_resample_rows(const struct dt_interpolation *itor, float *out,
+                                    const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                                    const float *const in, const int in_y0, const dt_iop_roi_t *const roi_in,
+                                    const int32_t in_stride);
+
 void dt_interpolation_resample_roi(const struct dt_interpolation *itor, float *out,
                                    const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                    const float *const in, const dt_iop_roi_t *const roi_in,
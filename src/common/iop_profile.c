@@ -295,200 +295,169 @@ static inline int _init_unbounded_coeffs(float *const lutr, float *const lutg, f
 }
 
 
-static inline void _apply_tonecurves(const float *const image_in, float *const image_out,
-                                     const int width, const int height,
-                                     const float *const restrict lutr,
-                                     const float *const restrict lutg,
-                                     const float *const restrict lutb,
-                                     const float *const restrict unbounded_coeffsr,
-                                     const float *const restrict unbounded_coeffsg,
-                                     const float *const restrict unbounded_coeffsb,
-                                     const int lutsize)
+/** The conversions below run in a single pass over the image : TRC (if any), matrices and, for RGB to RGB,
+ * the output TRC are fused per pixel. The former versions applied the tone curves as separate passes, so
+ * the buffer was streamed through memory up to three times, and converting through XYZ took two matrices.
+ * They are cloned for the CPU feature levels, which the pixel loops get vectorized for.
+ **/
+
+__DT_CLONE_TARGETS__
+static void _transform_rgb_to_lab_matrix(const float *const restrict image_in, float *const restrict image_out,
+                                         const int width, const int height,
+                                         const dt_iop_order_iccprofile_info_t *const profile_info)
 {
   const int ch = 4;
-  const float *const lut[3] = { lutr, lutg, lutb };
-  const float *const unbounded_coeffs[3] = { unbounded_coeffsr, unbounded_coeffsg, unbounded_coeffsb };
-  const size_t stride = (size_t)ch * width * height;
+  const size_t stride = (size_t)width * height * ch;
+  const float *const restrict matrix = profile_info->matrix_in;
 
-  // do we have any lut to apply, or is this a linear profile?
-  if((lut[0][0] >= 0.0f) && (lut[1][0] >= 0.0f) && (lut[2][0] >= 0.0f))
+  if(profile_info->nonlinearlut)
   {
+    float *const *const lut = profile_info->lut_in;
+    const float (*const unbounded_coeffs)[3] = profile_info->unbounded_coeffs_in;
+    const int lutsize = profile_info->lutsize;
+
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(stride, image_in, image_out, lut, lutsize, unbounded_coeffs, ch) \
-    schedule(static) collapse(2) aligned(image_in, image_out:64)
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix, lut, unbounded_coeffs, lutsize) \
+    schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
-    for(size_t k = 0; k < stride; k += ch)
+    for(size_t y = 0; y < stride; y += ch)
     {
-      for(int c = 0; c < 3; c++)
-      {
-        image_out[k + c] = (image_in[k + c] < 1.0f) ? extrapolate_lut(lut[c], image_in[k + c], lutsize)
-                                                    : eval_exp(unbounded_coeffs[c], image_in[k + c]);
-      }
+      float linear_rgb[3] DT_ALIGNED_PIXEL;
+      float xyz[3] DT_ALIGNED_PIXEL;
+      _apply_trc_in(image_in + y, linear_rgb, lut, unbounded_coeffs, lutsize);
+      _ioppr_linear_rgb_matrix_to_xyz(linear_rgb, xyz, matrix);
+      dt_XYZ_to_Lab(xyz, image_out + y);
     }
   }
-  else if((lut[0][0] >= 0.0f) || (lut[1][0] >= 0.0f) || (lut[2][0] >= 0.0f))
+  else
   {
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(stride, image_in, image_out, lut, lutsize, unbounded_coeffs, ch) \
-    schedule(static) collapse(2) aligned(image_in, image_out:64)
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix) \
+    schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
-    for(size_t k = 0; k < stride; k += ch)
+    for(size_t y = 0; y < stride; y += ch)
     {
-      for(int c = 0; c < 3; c++)
-      {
-        if(lut[c][0] >= 0.0f)
-        {
-          image_out[k + c] = (image_in[k + c] < 1.0f) ? extrapolate_lut(lut[c], image_in[k + c], lutsize)
-                                                      : eval_exp(unbounded_coeffs[c], image_in[k + c]);
-        }
-      }
+      float xyz[3] DT_ALIGNED_PIXEL;
+      _ioppr_linear_rgb_matrix_to_xyz(image_in + y, xyz, matrix);
+      dt_XYZ_to_Lab(xyz, image_out + y);
     }
   }
 }
 
 
-static inline void _transform_rgb_to_lab_matrix(const float *const restrict image_in, float *const restrict image_out,
-                                                const int width, const int height,
-                                                const dt_iop_order_iccprofile_info_t *const profile_info)
+__DT_CLONE_TARGETS__
+static void _transform_lab_to_rgb_matrix(const float *const restrict image_in, float *const restrict image_out,
+                                         const int width, const int height,
+                                         const dt_iop_order_iccprofile_info_t *const profile_info)
 {
   const int ch = 4;
   const size_t stride = (size_t)width * height * ch;
-  const float *const restrict matrix = profile_info->matrix_in;
+  const float *const restrict matrix = profile_info->matrix_out;
 
   if(profile_info->nonlinearlut)
   {
-    _apply_tonecurves(image_in, image_out, width, height, profile_info->lut_in[0], profile_info->lut_in[1],
-                      profile_info->lut_in[2], profile_info->unbounded_coeffs_in[0],
-                      profile_info->unbounded_coeffs_in[1], profile_info->unbounded_coeffs_in[2],
-                      profile_info->lutsize);
+    float *const *const lut = profile_info->lut_out;
+    const float (*const unbounded_coeffs)[3] = profile_info->unbounded_coeffs_out;
+    const int lutsize = profile_info->lutsize;
 
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(image_out, profile_info, stride, ch, matrix) \
-    schedule(static) aligned(image_out:64) aligned(matrix:16)
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix, lut, unbounded_coeffs, lutsize) \
+    schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
     for(size_t y = 0; y < stride; y += ch)
     {
-      float *const in = image_out + y;
-      float xyz[3] DT_ALIGNED_PIXEL = { 0.0f, 0.0f, 0.0f };
-      _ioppr_linear_rgb_matrix_to_xyz(in, xyz, matrix);
-      dt_XYZ_to_Lab(xyz, in);
+      float xyz[3] DT_ALIGNED_PIXEL;
+      float linear_rgb[3] DT_ALIGNED_PIXEL;
+      dt_Lab_to_XYZ(image_in + y, xyz);
+      _ioppr_xyz_to_linear_rgb_matrix(xyz, linear_rgb, matrix);
+      _apply_trc_out(linear_rgb, image_out + y, lut, unbounded_coeffs, lutsize);
     }
   }
   else
   {
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(image_in, image_out, profile_info, stride, ch, matrix) \
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix) \
     schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
     for(size_t y = 0; y < stride; y += ch)
     {
-      const float *const in = image_in + y ;
-      float *const out = image_out + y;
-
-      float xyz[3] DT_ALIGNED_PIXEL = { 0.0f, 0.0f, 0.0f };
-
-      _ioppr_linear_rgb_matrix_to_xyz(in, xyz, matrix);
-      dt_XYZ_to_Lab(xyz, out);
+      float xyz[3] DT_ALIGNED_PIXEL;
+      dt_Lab_to_XYZ(image_in + y, xyz);
+      _ioppr_xyz_to_linear_rgb_matrix(xyz, image_out + y, matrix);
     }
   }
 }
 
 
-static inline void _transform_lab_to_rgb_matrix(const float *const restrict image_in, float *const restrict image_out, const int width,
-                                         const int height,
-                                         const dt_iop_order_iccprofile_info_t *const profile_info)
+__DT_CLONE_TARGETS__
+static void _transform_matrix_rgb(const float *const restrict image_in, float *const restrict image_out,
+                                  const int width, const int height,
+                                  const dt_iop_order_iccprofile_info_t *const profile_info_from,
+                                  const dt_iop_order_iccprofile_info_t *const profile_info_to)
 {
   const int ch = 4;
   const size_t stride = (size_t)width * height * ch;
-  const float *const restrict matrix = profile_info->matrix_out;
-
-#ifdef _OPENMP
-#pragma omp parallel for simd default(none) \
-  dt_omp_firstprivate(image_in, image_out, stride, profile_info, ch, matrix) \
-  schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
-#endif
-  for(size_t y = 0; y < stride; y += ch)
-  {
-    const float *const in = image_in + y;
-    float *const out = image_out + y;
-
-    float xyz[3] DT_ALIGNED_PIXEL = { 0.0f, 0.0f, 0.0f };
-
-    dt_Lab_to_XYZ(in, xyz);
-    _ioppr_xyz_to_linear_rgb_matrix(xyz, out, matrix);
-  }
-
-  if(profile_info->nonlinearlut)
-  {
-    _apply_tonecurves(image_out, image_out, width, height, profile_info->lut_out[0], profile_info->lut_out[1],
-                      profile_info->lut_out[2], profile_info->unbounded_coeffs_out[0],
-                      profile_info->unbounded_coeffs_out[1], profile_info->unbounded_coeffs_out[2],
-                      profile_info->lutsize);
-  }
-}
 
+  // RGB in -> XYZ -> RGB out is a single matrix
+  float matrix[9] DT_ALIGNED_ARRAY;
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+    {
+      matrix[3 * i + j] = 0.0f;
+      for(int k = 0; k < 3; k++)
+        matrix[3 * i + j] += profile_info_to->matrix_out[3 * i + k] * profile_info_from->matrix_in[3 * k + j];
+    }
 
-static inline void _transform_matrix_rgb(const float *const restrict image_in, float *const restrict image_out, const int width,
-                                  const int height, const dt_iop_order_iccprofile_info_t *const profile_info_from,
-                                  const dt_iop_order_iccprofile_info_t *const profile_info_to)
-{
-  const int ch = 4;
-  const size_t stride = (size_t)width * height * ch;
-  const float *const restrict matrix_in = profile_info_from->matrix_in;
-  const float *const restrict matrix_out = profile_info_to->matrix_out;
+  const int trc_in = profile_info_from->nonlinearlut;
+  const int trc_out = profile_info_to->nonlinearlut;
+  float *const *const lut_in = profile_info_from->lut_in;
+  float *const *const lut_out = profile_info_to->lut_out;
+  const float (*const unbounded_coeffs_in)[3] = profile_info_from->unbounded_coeffs_in;
+  const float (*const unbounded_coeffs_out)[3] = profile_info_to->unbounded_coeffs_out;
+  const int lutsize_in = profile_info_from->lutsize;
+  const int lutsize_out = profile_info_to->lutsize;
 
-  if(profile_info_from->nonlinearlut)
+  if(!trc_in && !trc_out)
   {
-    _apply_tonecurves(image_in, image_out, width, height, profile_info_from->lut_in[0],
-                      profile_info_from->lut_in[1], profile_info_from->lut_in[2],
-                      profile_info_from->unbounded_coeffs_in[0], profile_info_from->unbounded_coeffs_in[1],
-                      profile_info_from->unbounded_coeffs_in[2], profile_info_from->lutsize);
-
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(stride, image_out, profile_info_from, profile_info_to, ch, matrix_in, matrix_out) \
-    schedule(static) aligned(image_out:64) aligned(matrix_in, matrix_out:16)
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix) \
+    schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
     for(size_t y = 0; y < stride; y += ch)
     {
-      float *const in = image_out + y;
-
-      float xyz[3] DT_ALIGNED_PIXEL = { 0.0f, 0.0f, 0.0f };
-
-      _ioppr_linear_rgb_matrix_to_xyz(in, xyz, matrix_in);
-      _ioppr_xyz_to_linear_rgb_matrix(xyz, in, matrix_out);
+      float rgb[3] DT_ALIGNED_PIXEL;
+      _ioppr_linear_rgb_matrix_to_xyz(image_in + y, rgb, matrix);
+      for(int c = 0; c < 3; c++) image_out[y + c] = rgb[c];
     }
   }
   else
   {
 #ifdef _OPENMP
 #pragma omp parallel for simd default(none) \
-    dt_omp_firstprivate(stride, image_in, image_out, profile_info_from, profile_info_to, ch, matrix_in, matrix_out) \
-    schedule(static) aligned(image_in, image_out:64) aligned(matrix_in, matrix_out:16)
+    dt_omp_firstprivate(image_in, image_out, stride, ch, matrix, trc_in, trc_out, lut_in, lut_out, \
+                        unbounded_coeffs_in, unbounded_coeffs_out, lutsize_in, lutsize_out) \
+    schedule(static) aligned(image_in, image_out:64) aligned(matrix:16)
 #endif
     for(size_t y = 0; y < stride; y += ch)
     {
-      const float *const in = image_in + y;
-      float *const out = image_out + y;
-
-      float xyz[3] DT_ALIGNED_PIXEL = { 0.0f, 0.0f, 0.0f };
-
-      _ioppr_linear_rgb_matrix_to_xyz(in, xyz, matrix_in);
-      _ioppr_xyz_to_linear_rgb_matrix(xyz, out, matrix_out);
+      float linear_in[3] DT_ALIGNED_PIXEL;
+      float linear_out[3] DT_ALIGNED_PIXEL;
+      if(trc_in)
+        _apply_trc_in(image_in + y, linear_in, lut_in, unbounded_coeffs_in, lutsize_in);
+      else
+        for(int c = 0; c < 3; c++) linear_in[c] = image_in[y + c];
+      _ioppr_linear_rgb_matrix_to_xyz(linear_in, linear_out, matrix);
+      if(trc_out)
+        _apply_trc_out(linear_out, image_out + y, lut_out, unbounded_coeffs_out, lutsize_out);
+      else
+        for(int c = 0; c < 3; c++) image_out[y + c] = linear_out[c];
     }
   }
-
-  if(profile_info_to->nonlinearlut)
-  {
-    _apply_tonecurves(image_out, image_out, width, height, profile_info_to->lut_out[0], profile_info_to->lut_out[1],
-                      profile_info_to->lut_out[2], profile_info_to->unbounded_coeffs_out[0],
-                      profile_info_to->unbounded_coeffs_out[1], profile_info_to->unbounded_coeffs_out[2],
-                      profile_info_to->lutsize);
-  }
 }
 
 
@@ -894,166 +863,6 @@ void dt_ioppr_get_histogram_profile_type(int *profile_type, char **profile_filen
 }
 
 
-#if defined(__SSE2__x) // FIXME: this is slower than the C version
-static __m128 _ioppr_linear_rgb_matrix_to_xyz_sse(const __m128 rgb, const dt_iop_order_iccprofile_info_t *const profile_info)
-{
-/*  for(int c = 0; c < 3; c++)
-  {
-    xyz[c] = 0.0f;
-    for(int i = 0; i < 3; i++)
-    {
-      xyz[c] += profile_info->matrix_in[3 * c + i] * rgb[i];
-    }
-  }*/
-  const __m128 m0 = _mm_set_ps(0.0f, profile_info->matrix_in[6], profile_info->matrix_in[3], profile_info->matrix_in[0]);
-  const __m128 m1 = _mm_set_ps(0.0f, profile_info->matrix_in[7], profile_info->matrix_in[4], profile_info->matrix_in[1]);
-  const __m128 m2 = _mm_set_ps(0.0f, profile_info->matrix_in[8], profile_info->matrix_in[5], profile_info->matrix_in[2]);
-
-  __m128 xyz
-      = _mm_add_ps(_mm_mul_ps(m0, _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(0, 0, 0, 0))),
-                   _mm_add_ps(_mm_mul_ps(m1, _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(1, 1, 1, 1))),
-                              _mm_mul_ps(m2, _mm_shuffle_ps(rgb, rgb, _MM_SHUFFLE(2, 2, 2, 2)))));
-  return xyz;
-}
-
-static __m128 _ioppr_xyz_to_linear_rgb_matrix_sse(const __m128 xyz, const dt_iop_order_iccprofile_info_t *const profile_info)
-{
-/*  for(int c = 0; c < 3; c++)
-  {
-    rgb[c] = 0.0f;
-    for(int i = 0; i < 3; i++)
-    {
-      rgb[c] += profile_info->matrix_out[3 * c + i] * xyz[i];
-    }
-  }*/
-  const __m128 m0 = _mm_set_ps(0.0f, profile_info->matrix_out[6], profile_info->matrix_out[3], profile_info->matrix_out[0]);
-  const __m128 m1 = _mm_set_ps(0.0f, profile_info->matrix_out[7], profile_info->matrix_out[4], profile_info->matrix_out[1]);
-  const __m128 m2 = _mm_set_ps(0.0f, profile_info->matrix_out[8], profile_info->matrix_out[5], profile_info->matrix_out[2]);
-
-  __m128 rgb
-      = _mm_add_ps(_mm_mul_ps(m0, _mm_shuffle_ps(xyz, xyz, _MM_SHUFFLE(0, 0, 0, 0))),
-                   _mm_add_ps(_mm_mul_ps(m1, _mm_shuffle_ps(xyz, xyz, _MM_SHUFFLE(1, 1, 1, 1))),
-                              _mm_mul_ps(m2, _mm_shuffle_ps(xyz, xyz, _MM_SHUFFLE(2, 2, 2, 2)))));
-  return rgb;
-}
-
-static void _transform_rgb_to_lab_matrix_sse(float *const image, const int width, const int height, const dt_iop_order_iccprofile_info_t *const profile_info)
-{
-  const int ch = 4;
-  const size_t stride = (size_t)width * height;
-
-  _apply_tonecurves(image, width, height, profile_info->lut_in[0], profile_info->lut_in[1], profile_info->lut_in[2],
-      profile_info->unbounded_coeffs_in[0], profile_info->unbounded_coeffs_in[1], profile_info->unbounded_coeffs_in[2], profile_info->lutsize);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static)
-#endif
-  for(size_t y = 0; y < stride; y++)
-  {
-    float *const in = image + y * ch;
-
-    __m128 xyz = { 0.0f };
-    __m128 rgb = _mm_load_ps(in);
-
-    xyz = _ioppr_linear_rgb_matrix_to_xyz_sse(rgb, profile_info);
-
-    rgb = dt_XYZ_to_Lab_sse2(xyz);
-    const float a = in[3];
-    _mm_stream_ps(in, rgb);
-    in[3] = a;
-  }
-}
-
-static void _transform_lab_to_rgb_matrix_sse(float *const image, const int width, const int height, const dt_iop_order_iccprofile_info_t *const profile_info)
-{
-  const int ch = 4;
-  const size_t stride = (size_t)width * height;
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static)
-#endif
-  for(size_t y = 0; y < stride; y++)
-  {
-    float *const in = image + y * ch;
-
-    __m128 xyz = { 0.0f };
-    __m128 lab = _mm_load_ps(in);
-
-    xyz = dt_Lab_to_XYZ_sse2(lab);
-    lab = _ioppr_xyz_to_linear_rgb_matrix_sse(xyz, profile_info);
-    const float a = in[3];
-    _mm_stream_ps(in, lab);
-    in[3] = a;
-  }
-
-  _apply_tonecurves(image, width, height, profile_info->lut_out[0], profile_info->lut_out[1], profile_info->lut_out[2],
-      profile_info->unbounded_coeffs_out[0], profile_info->unbounded_coeffs_out[1], profile_info->unbounded_coeffs_out[2], profile_info->lutsize);
-}
-
-// FIXME: this is slower than the C version
-static void _transform_matrix_sse(struct dt_iop_module_t *self, float *const image, const int width, const int height,
-    const int cst_from, const int cst_to, int *converted_cst, const dt_iop_order_iccprofile_info_t *const profile_info)
-{
-  if(cst_from == cst_to)
-  {
-    *converted_cst = cst_to;
-    return;
-  }
-
-  *converted_cst = cst_to;
-
-  if(cst_from == iop_cs_rgb && cst_to == iop_cs_Lab)
-  {
-    _transform_rgb_to_lab_matrix_sse(image, width, height, profile_info);
-  }
-  else if(cst_from == iop_cs_Lab && cst_to == iop_cs_rgb)
-  {
-    _transform_lab_to_rgb_matrix_sse(image, width, height, profile_info);
-  }
-  else
-  {
-    *converted_cst = cst_from;
-    fprintf(stderr, "[_transform_matrix_sse] invalid conversion from %i to %i\n", cst_from, cst_to);
-  }
-}
-
-static void _transform_matrix_rgb_sse(float *const image, const int width, const int height,
-                                      const dt_iop_order_iccprofile_info_t *const profile_info_from,
-                                      const dt_iop_order_iccprofile_info_t *const profile_info_to)
-{
-  const int ch = 4;
-  const size_t stride = (size_t)width * height;
-
-  _apply_tonecurves(image, width, height, profile_info_from->lut_in[0], profile_info_from->lut_in[1],
-                    profile_info_from->lut_in[2], profile_info_from->unbounded_coeffs_in[0],
-                    profile_info_from->unbounded_coeffs_in[1], profile_info_from->unbounded_coeffs_in[2],
-                    profile_info_from->lutsize);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static)
-#endif
-  for(size_t y = 0; y < stride; y++)
-  {
-    float *const in = image + y * ch;
-
-    __m128 xyz = { 0.0f };
-    __m128 rgb = _mm_load_ps(in);
-
-    xyz = _ioppr_linear_rgb_matrix_to_xyz_sse(rgb, profile_info_from);
-    rgb = _ioppr_xyz_to_linear_rgb_matrix_sse(xyz, profile_info_to);
-
-    const float a = in[3];
-    _mm_stream_ps(in, rgb);
-    in[3] = a;
-  }
-
-  _apply_tonecurves(image, width, height, profile_info_to->lut_out[0], profile_info_to->lut_out[1],
-                    profile_info_to->lut_out[2], profile_info_to->unbounded_coeffs_out[0],
-                    profile_info_to->unbounded_coeffs_out[1], profile_info_to->unbounded_coeffs_out[2],
-                    profile_info_to->lutsize);
-}
-#endif
-
 void dt_ioppr_transform_image_colorspace(struct dt_iop_module_t *self, const float *const image_in,
                                          float *const image_out, const int width, const int height,
                                          const int cst_from, const int cst_to, int *converted_cst,
@@ -1081,17 +890,7 @@ void dt_ioppr_transform_image_colorspace(struct dt_iop_module_t *self, const flo
   // matrix should be never NAN, this is only to test it against lcms2!
   if(!isnan(profile_info->matrix_in[0]) && !isnan(profile_info->matrix_out[0]))
   {
-    // FIXME: sse is slower than the C version
-    // if(darktable.codepath.OPENMP_SIMD)
     _transform_matrix(self, image_in, image_out, width, height, cst_from, cst_to, converted_cst, profile_info);
-    /*
-    #if defined(__SSE2__)
-        else if(darktable.codepath.SSE2)
-          _transform_matrix_sse(self, image, width, height, cst_from, cst_to, converted_cst, profile_info);
-    #endif
-        else
-          dt_unreachable_codepath();
-    */
     if(darktable.unmuted & DT_DEBUG_PERF)
     {
       dt_get_times(&end_time);
@@ -1142,17 +941,7 @@ void dt_ioppr_transform_image_colorspace_rgb(const float *const restrict image_i
   if(!isnan(profile_info_from->matrix_in[0]) && !isnan(profile_info_from->matrix_out[0])
      && !isnan(profile_info_to->matrix_in[0]) && !isnan(profile_info_to->matrix_out[0]))
   {
-    // FIXME: sse is slower than the C version
-    // if(darktable.codepath.OPENMP_SIMD)
     _transform_matrix_rgb(image_in, image_out, width, height, profile_info_from, profile_info_to);
-    /*
-    #if defined(__SSE2__)
-        else if(darktable.codepath.SSE2)
-          _transform_matrix_rgb_sse(self, image, width, height, profile_info_from, profile_info_to);
-    #endif
-        else
-          dt_unreachable_codepath();
-    */
     if(darktable.unmuted & DT_DEBUG_PERF)
     {
       dt_get_times(&end_time);
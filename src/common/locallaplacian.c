@@ -18,6 +18,7 @@
 
 #include "common/darktable.h"
 #include "common/locallaplacian.h"
+#include "common/pyramid.h"
 
 #include <string.h>
 #include <stdint.h>
@@ -104,32 +105,6 @@ static inline float ll_expand_gaussian(
   }
 }
 
-// helper to fill in one pixel boundary by copying it
-static inline void ll_fill_boundary1(
-    float *const input,
-    const int wd,
-    const int ht)
-{
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  memcpy(input,    input+wd, sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
-}
-
-// helper to fill in two pixels boundary by copying it
-static inline void ll_fill_boundary2(
-    float *const input,
-    const int wd,
-    const int ht)
-{
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  if(wd & 1) for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  else       for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2] = input[j*wd+wd-3];
-  memcpy(input, input+wd, sizeof(float)*wd);
-  if(!(ht & 1)) memcpy(input+wd*(ht-2), input+wd*(ht-3), sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
-}
-
 static void pad_by_replication(
     float *buf,			// the buffer to be padded
     const uint32_t w,		// width of a line
@@ -148,127 +123,6 @@ static void pad_by_replication(
   }
 }
 
-static inline void gauss_expand(
-    const float *const input, // coarse input
-    float *const fine,        // upsampled, blurry output
-    const int wd,             // fine res
-    const int ht)
-{
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(fine, input, wd, ht) \
-  schedule(static) \
-  collapse(2)
-#endif
-  for(int j=1;j<((ht-1)&~1);j++)  // even ht: two px boundary. odd ht: one px.
-    for(int i=1;i<((wd-1)&~1);i++)
-      fine[j*wd+i] = ll_expand_gaussian(input, i, j, wd, ht);
-  ll_fill_boundary2(fine, wd, ht);
-}
-
-#if defined(__SSE2__)
-static inline __m128 convolve14641_vert(const float *in, const int wd)
-{
-  float four[4] = { 4.f, 4.f, 4.f, 4.f };
-  __m128 r0 = _mm_loadu_ps(in);
-  __m128 r1 = _mm_loadu_ps(in + wd);
-  __m128 r2 = _mm_loadu_ps(in + 2*wd);
-  __m128 r3 = _mm_loadu_ps(in + 3*wd);
-  __m128 r4 = _mm_loadu_ps(in + 4*wd);
-  _mm_prefetch(in+4,_MM_HINT_NTA);		// prefetch next column, which won't be used again afterwards
-  r0 = _mm_add_ps(r0, r4);                      // r0 = r0+r4
-  _mm_prefetch(in+4+wd,_MM_HINT_NTA);		// prefetch next column, which won't be used again afterwards
-  r1 = _mm_add_ps(_mm_add_ps(r1,r3), r2);       // r1 = r1+r2+r3
-  _mm_prefetch(in+4+2*wd,_MM_HINT_T0);
-  r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));     // r0 = r0+2*r2+r4
-  _mm_prefetch(in+4+3*wd, _MM_HINT_T0);
-  __m128 t = _mm_mul_ps(r1, _mm_load_ps(four)); // t= 4*r1+4*r2+4*r3
-  _mm_prefetch(in+4+4*wd, _MM_HINT_T0);
-  return _mm_add_ps(r0, t);                   // r0+4*r1+6*r2+4*r3+r4 
-}
-#endif
-
-#if defined(__SSE2__)
-static inline void gauss_reduce_sse2(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
-{
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
-
-#ifdef _OPENMP
-  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
-  // is greater than the time needed to do it sequentially
-#pragma omp parallel for default(none) if (ch*cw>1000)  \
-      dt_omp_firstprivate(cw, ch, input, wd, coarse) \
-      schedule(static)
-#endif
-  for(int j=1;j<ch-1;j++)
-  {
-    const float *base = input + 2*(j-1)*wd;
-    float *const out = coarse + j*cw + 1;
-    // prime the vertical axis
-    const __m128 kernel = _mm_setr_ps(1.f, 4.f, 6.f, 4.f);
-    __m128 left = convolve14641_vert(base,wd);
-    for(int col=0; col<cw-3; col+=2)
-    {
-      // convolve the next four pixel wide vertical slice
-      base += 4;
-      __m128 right = convolve14641_vert(base,wd);
-      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
-      // the first uses pixels 0-4, the second uses 2-6
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.f;
-      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6*right[0] + right[2]) / 256.f;
-      // shift to next pair of output columns (four input columns)
-      left = right;
-    }
-    // handle the left-over pixel if the output size is odd
-    if (cw % 2)
-    {
-      base += 4;
-      float right = base[0] + 4*(base[wd]+base[3*wd]) + 6*base[2*wd] + base[4*wd];
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.f;
-    }
-  }
-  ll_fill_boundary1(coarse, cw, ch);
-}
-#endif
-
-static inline void gauss_reduce(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
-{
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
-
-  // this is the scalar (non-simd) code:
-  const float w[5] = { 1.f/16.f, 4.f/16.f, 6.f/16.f, 4.f/16.f, 1.f/16.f };
-  memset(coarse, 0, sizeof(float)*cw*ch);
-  // direct 5x5 stencil only on required pixels:
-#ifdef _OPENMP
-  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
-  // is greater than the time needed to do it sequentially
-#pragma omp parallel for default(none) if (ch*cw>500)  \
-  dt_omp_firstprivate(coarse, cw, ch, input, w, wd) \
-  schedule(static) \
-  collapse(2)
-#endif
-  for(int j=1;j<ch-1;j++)
-    for(int i=1;i<cw-1;i++)
-    {
-      for(int jj=-2;jj<=2;jj++)
-        for(int ii=-2;ii<=2;ii++)
-          coarse[j*cw+i] += input[(2*j+jj)*wd+2*i+ii] * w[ii+2] * w[jj+2];
-    }
-  ll_fill_boundary1(coarse, cw, ch);
-}
-
 // allocate output buffer with monochrome brightness channel from input, padded
 // up by max_supp on all four sides, dimensions written to wd2 ht2
 static inline float *ll_pad_input(
@@ -284,6 +138,7 @@ static inline float *ll_pad_input(
   *wd2 = 2*max_supp + wd;
   *ht2 = 2*max_supp + ht;
   float *const out = dt_alloc_align(64, *wd2**ht2*sizeof(*out));
+  if(!out) return NULL;
 
   if(b && b->mode == 2)
   { // pad by preview buffer
@@ -560,7 +415,7 @@ void apply_curve(
   pad_by_replication(out, w, h, padding);
 }
 
-void local_laplacian_internal(
+int local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
     const int wd,               // width and
@@ -569,7 +424,6 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    const int use_sse2,         // flag whether to use SSE version
     local_laplacian_boundary_t *b)
 {
   // don't divide by 2 more often than we can:
@@ -580,45 +434,42 @@ void local_laplacian_internal(
   const int max_supp = 1<<last_level;
   int w, h;
   float *padded[max_levels] = {0};
+  float *output[max_levels] = {0};
+  dt_pyramid_t *pyramid[num_gamma] = {0};
+  float *buf[num_gamma][max_levels] = {{0}};
   if(b && b->mode == 2)
     padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
   else
     padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  if(!padded[0]) goto error;
 
   // allocate pyramid pointers for padded input
   for(int l=1;l<=last_level;l++)
-    padded[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+    if(!(padded[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l)))) goto error;
 
   // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
   for(int l=0;l<=last_level;l++)
-    output[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+    if(!(output[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l)))) goto error;
 
   // create gauss pyramid of padded input, write coarse directly to output
-#if defined(__SSE2__)
-  if(use_sse2)
-  {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce_sse2(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce_sse2(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
-  }
-  else
-#endif
-  {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
-  }
+  for(int l=1;l<last_level;l++)
+    if(dt_pyramid_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1), 1, DT_PYRAMID_BORDER_REPLICATE))
+      goto error;
+  if(dt_pyramid_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1), 1,
+                       DT_PYRAMID_BORDER_REPLICATE))
+    goto error;
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
   for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
-  float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
-    buf[k][l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+  // allocate memory for intermediate laplacian pyramids, one pool per pyramid
+  for(int k=0;k<num_gamma;k++)
+  {
+    if(!(pyramid[k] = dt_pyramid_alloc(w, h, 1, last_level+1))) goto error;
+    for(int l=0;l<=last_level;l++) buf[k][l] = pyramid[k]->level[l];
+  }
 
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
@@ -626,20 +477,14 @@ void local_laplacian_internal(
   for(int k=0;k<num_gamma;k++)
   { // process images
 #if defined(__SSE2__)
-    if(use_sse2)
+    if(darktable.codepath.SSE2)
       apply_curve_sse2(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
     else // brackets in next line needed for silly gcc warning:
 #endif
     {apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
 
     // create gaussian pyramids
-    for(int l=1;l<=last_level;l++)
-#if defined(__SSE2__)
-      if(use_sse2)
-        gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
-      else
-#endif
-        gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+    if(dt_pyramid_build(pyramid[k], DT_PYRAMID_BORDER_REPLICATE)) goto error;
   }
 
   // resample output[last_level] from preview
@@ -705,7 +550,7 @@ void local_laplacian_internal(
   {
     const int pw = dl(w,l), ph = dl(h,l);
 
-    gauss_expand(output[l+1], output[l], pw, ph);
+    if(dt_pyramid_expand(output[l+1], output[l], pw, ph, 1, DT_PYRAMID_BORDER_REPLICATE)) goto error;
     // go through all coefficients in the upsampled gauss buffer:
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
@@ -759,8 +604,19 @@ void local_laplacian_internal(
   {
     if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
     if(!b || b->mode != 1)        dt_free_align(output[l]);
-    for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
   }
+  for(int k=0; k<num_gamma;k++) dt_pyramid_free(pyramid[k]);
+  return 0;
+
+error:
+  // out of memory: nothing has been handed out to b yet, free whatever we got so far
+  for(int l=0;l<max_levels;l++)
+  {
+    dt_free_align(padded[l]);
+    dt_free_align(output[l]);
+  }
+  for(int k=0; k<num_gamma;k++) dt_pyramid_free(pyramid[k]);
+  return 1;
 }
 
 
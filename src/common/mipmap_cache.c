@@ -26,6 +26,7 @@
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
+#include "common/rawcache.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
@@ -611,6 +612,7 @@ void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  if(darktable.unmuted & DT_DEBUG_CACHE) dt_rawcache_print();
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
@@ -657,6 +659,7 @@ void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
          100.0 * cache->mip_full.stats_standin / (float)sum_standins,
          100.0 * cache->mip_full.stats_fetches / (float)sum_fetches,
          100.0 * cache->mip_full.stats_requests / (float)sum);
+  dt_rawcache_print();
   printf("\n\n");
 }
 
@@ -0,0 +1,315 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/pyramid.h"
+#include "common/darktable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the levels in the pool start on cache lines of their own
+static inline size_t _level_floats(const int width, const int height, const int channels)
+{
+  return ((size_t)width * height * channels + 15) & ~(size_t)15;
+}
+
+// mirror coordinate x into [0, n). this is what the fine grid looks like beyond the borders: reflected about
+// the first pixel on the left/top, about the edge on the right/bottom.
+static inline int _mirror(const int x, const int n)
+{
+  const int m = x < 0 ? -x : (x >= n ? 2 * n - 1 - x : x);
+  return CLAMP(m, 0, n - 1);
+}
+
+// coarse pixels contributing to fine pixel i of n, along one axis, and their weights: the 1 4 6 4 1 kernel
+// on the fine grid with only every other pixel set, times two to keep the energy. with mirrored borders the
+// fine grid is mirrored, otherwise the taps are clamped to the coarse level, as the border is replaced later.
+static inline int _expand_taps(const int i, const int n, const dt_pyramid_border_t border, int idx[5], float w[5])
+{
+  if(border == DT_PYRAMID_BORDER_REPLICATE)
+  {
+    const int last = (n - 1) / 2;
+    if(i & 1)
+    {
+      idx[0] = CLAMP((i - 1) / 2, 0, last);
+      idx[1] = CLAMP((i + 1) / 2, 0, last);
+      w[0] = w[1] = 0.5f;
+      return 2;
+    }
+    idx[0] = CLAMP(i / 2 - 1, 0, last);
+    idx[1] = CLAMP(i / 2, 0, last);
+    idx[2] = CLAMP(i / 2 + 1, 0, last);
+    w[0] = w[2] = 1.f / 8.f;
+    w[1] = 6.f / 8.f;
+    return 3;
+  }
+
+  const float w5[5] = { 1.f / 8.f, 4.f / 8.f, 6.f / 8.f, 4.f / 8.f, 1.f / 8.f };
+  int taps = 0;
+  for(int d = -2; d <= 2; d++)
+  {
+    const int x = _mirror(i + d, n);
+    if(x & 1) continue;
+    idx[taps] = x / 2;
+    w[taps++] = w5[d + 2];
+  }
+  return taps;
+}
+
+// copy the inner pixels into a one pixel border
+static void _fill_border1(float *const buf, const int wd, const int ht, const int ch)
+{
+  if(wd < 3 || ht < 3) return;
+  const size_t stride = (size_t)wd * ch;
+  for(int j = 1; j < ht - 1; j++)
+  {
+    float *const row = buf + stride * j;
+    for(int c = 0; c < ch; c++)
+    {
+      row[c] = row[ch + c];
+      row[(wd - 1) * ch + c] = row[(wd - 2) * ch + c];
+    }
+  }
+  memcpy(buf, buf + stride, sizeof(float) * stride);
+  memcpy(buf + stride * (ht - 1), buf + stride * (ht - 2), sizeof(float) * stride);
+}
+
+// copy the inner pixels into the border of an expanded buffer: one pixel for odd sizes, two for even ones
+static void _fill_border2(float *const buf, const int wd, const int ht, const int ch)
+{
+  if(wd < 4 || ht < 4) return;
+  const size_t stride = (size_t)wd * ch;
+  for(int j = 1; j < ht - 1; j++)
+  {
+    float *const row = buf + stride * j;
+    for(int c = 0; c < ch; c++)
+    {
+      row[c] = row[ch + c];
+      if(!(wd & 1)) row[(wd - 2) * ch + c] = row[(wd - 3) * ch + c];
+      row[(wd - 1) * ch + c] = row[(wd - 2) * ch + c];
+    }
+  }
+  memcpy(buf, buf + stride, sizeof(float) * stride);
+  if(!(ht & 1)) memcpy(buf + stride * (ht - 2), buf + stride * (ht - 3), sizeof(float) * stride);
+  memcpy(buf + stride * (ht - 1), buf + stride * (ht - 2), sizeof(float) * stride);
+}
+
+size_t dt_pyramid_memory_use(const int width, const int height, const int channels, const int num_levels)
+{
+  size_t total = 0;
+  for(int l = 0; l < MIN(num_levels, DT_PYRAMID_MAX_LEVELS); l++)
+    total += _level_floats(dt_pyramid_dim(width, l), dt_pyramid_dim(height, l), channels);
+  return total * sizeof(float) + sizeof(dt_pyramid_t);
+}
+
+dt_pyramid_t *dt_pyramid_alloc(const int width, const int height, const int channels, const int num_levels)
+{
+  dt_pyramid_t *p = (dt_pyramid_t *)calloc(1, sizeof(dt_pyramid_t));
+  if(!p) return NULL;
+  p->num_levels = MIN(num_levels, DT_PYRAMID_MAX_LEVELS);
+  p->channels = channels;
+
+  size_t total = 0;
+  for(int l = 0; l < p->num_levels; l++)
+  {
+    p->width[l] = dt_pyramid_dim(width, l);
+    p->height[l] = dt_pyramid_dim(height, l);
+    total += _level_floats(p->width[l], p->height[l], channels);
+  }
+
+  p->pool = dt_alloc_align(64, total * sizeof(float));
+  if(!p->pool)
+  {
+    free(p);
+    return NULL;
+  }
+
+  float *level = p->pool;
+  for(int l = 0; l < p->num_levels; l++)
+  {
+    p->level[l] = level;
+    level += _level_floats(p->width[l], p->height[l], channels);
+  }
+  return p;
+}
+
+void dt_pyramid_free(dt_pyramid_t *p)
+{
+  if(!p) return;
+  dt_free_align(p->pool);
+  free(p);
+}
+
+int dt_pyramid_reduce(const float *const fine, float *const coarse, const int wd, const int ht,
+                      const int channels, const dt_pyramid_border_t border)
+{
+  const int ch = channels;
+  const int cw = dt_pyramid_dim(wd, 1), cht = dt_pyramid_dim(ht, 1);
+  const size_t frow = (size_t)wd * ch;
+  float *const tmp = dt_alloc_align(64, sizeof(float) * frow * dt_get_num_threads());
+  if(!tmp) return 1;
+
+  // only the fine pixels which end up in the coarse level are blurred. each coarse row is one vertical pass
+  // over five fine rows, straight through all channels, and one horizontal pass over the even columns.
+#ifdef _OPENMP
+  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
+  // is greater than the time needed to do it sequentially
+#pragma omp parallel for default(none) if((size_t)cw * cht > 1000) \
+  dt_omp_firstprivate(fine, coarse, wd, ht, ch, cw, cht, frow, tmp) \
+  schedule(static)
+#endif
+  for(int j = 0; j < cht; j++)
+  {
+    float *const row = tmp + frow * dt_get_thread_num();
+    const float *const r0 = fine + frow * _mirror(2 * j - 2, ht);
+    const float *const r1 = fine + frow * _mirror(2 * j - 1, ht);
+    const float *const r2 = fine + frow * _mirror(2 * j, ht);
+    const float *const r3 = fine + frow * _mirror(2 * j + 1, ht);
+    const float *const r4 = fine + frow * _mirror(2 * j + 2, ht);
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(size_t k = 0; k < frow; k++) row[k] = (r0[k] + r4[k]) + 4.0f * (r1[k] + r3[k]) + 6.0f * r2[k];
+
+    float *const out = coarse + (size_t)cw * ch * j;
+    for(int i = 0; i < cw; i++)
+    {
+      if(i >= 1 && i < cw - 1)
+      {
+        const float *const r = row + (size_t)ch * 2 * i;
+        for(int c = 0; c < ch; c++)
+          out[ch * i + c]
+              = ((r[c - 2 * ch] + r[c + 2 * ch]) + 4.0f * (r[c - ch] + r[c + ch]) + 6.0f * r[c]) * (1.0f / 256.0f);
+      }
+      else
+      {
+        const float *const x0 = row + (size_t)ch * _mirror(2 * i - 2, wd);
+        const float *const x1 = row + (size_t)ch * _mirror(2 * i - 1, wd);
+        const float *const x2 = row + (size_t)ch * _mirror(2 * i, wd);
+        const float *const x3 = row + (size_t)ch * _mirror(2 * i + 1, wd);
+        const float *const x4 = row + (size_t)ch * _mirror(2 * i + 2, wd);
+        for(int c = 0; c < ch; c++)
+          out[ch * i + c] = ((x0[c] + x4[c]) + 4.0f * (x1[c] + x3[c]) + 6.0f * x2[c]) * (1.0f / 256.0f);
+      }
+    }
+  }
+
+  dt_free_align(tmp);
+
+  if(border == DT_PYRAMID_BORDER_REPLICATE) _fill_border1(coarse, cw, cht, ch);
+  return 0;
+}
+
+int dt_pyramid_build(dt_pyramid_t *p, const dt_pyramid_border_t border)
+{
+  for(int l = 1; l < p->num_levels; l++)
+    if(dt_pyramid_reduce(p->level[l - 1], p->level[l], p->width[l - 1], p->height[l - 1], p->channels, border))
+      return 1;
+  return 0;
+}
+
+// out = base + sign * expanded coarse, base may be NULL or the same as out
+static int _expand(const float *const coarse, float *const out, const float *const base, const float sign,
+                   const int wd, const int ht, const int ch, const dt_pyramid_border_t border)
+{
+  const int cw = dt_pyramid_dim(wd, 1);
+  const size_t crow = (size_t)cw * ch;
+  float *const tmp = dt_alloc_align(64, sizeof(float) * crow * dt_get_num_threads());
+  if(!tmp) return 1;
+
+  // each fine row gets the two or three coarse rows contributing to it combined into one coarse sized row,
+  // which is then upsampled horizontally.
+#ifdef _OPENMP
+#pragma omp parallel for default(none) if((size_t)wd * ht > 1000) \
+  dt_omp_firstprivate(coarse, out, base, sign, wd, ht, ch, crow, tmp, border) \
+  schedule(static)
+#endif
+  for(int j = 0; j < ht; j++)
+  {
+    float *const row = tmp + crow * dt_get_thread_num();
+    int idx[5];
+    float w[5];
+    const int taps = _expand_taps(j, ht, border, idx, w);
+    const float *const c0 = coarse + crow * idx[0];
+    const float w0 = w[0];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(size_t k = 0; k < crow; k++) row[k] = w0 * c0[k];
+    for(int t = 1; t < taps; t++)
+    {
+      const float *const ct = coarse + crow * idx[t];
+      const float wt = w[t];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(size_t k = 0; k < crow; k++) row[k] += wt * ct[k];
+    }
+
+    float *const o = out + (size_t)wd * ch * j;
+    const float *const b = base ? base + (size_t)wd * ch * j : NULL;
+    for(int i = 0; i < wd; i++)
+    {
+      float v[4] = { 0.0f };
+      if(i >= 2 && i < wd - 2)
+      {
+        const float *const r = row + (size_t)ch * (i / 2);
+        if(i & 1)
+          for(int c = 0; c < ch; c++) v[c] = 0.5f * (r[c] + r[ch + c]);
+        else
+          for(int c = 0; c < ch; c++) v[c] = 0.125f * (r[c - ch] + r[c + ch]) + 0.75f * r[c];
+      }
+      else
+      {
+        int hidx[5];
+        float hw[5];
+        const int htaps = _expand_taps(i, wd, border, hidx, hw);
+        for(int t = 0; t < htaps; t++)
+          for(int c = 0; c < ch; c++) v[c] += hw[t] * row[(size_t)ch * hidx[t] + c];
+      }
+      for(int c = 0; c < ch; c++) o[ch * i + c] = (b ? b[ch * i + c] : 0.0f) + sign * v[c];
+    }
+  }
+
+  dt_free_align(tmp);
+
+  if(border == DT_PYRAMID_BORDER_REPLICATE) _fill_border2(out, wd, ht, ch);
+  return 0;
+}
+
+int dt_pyramid_expand(const float *const coarse, float *const fine, const int wd, const int ht,
+                      const int channels, const dt_pyramid_border_t border)
+{
+  return _expand(coarse, fine, NULL, 1.0f, wd, ht, channels, border);
+}
+
+int dt_pyramid_collapse(const float *const coarse, float *const fine, const int wd, const int ht,
+                        const int channels, const dt_pyramid_border_t border)
+{
+  return _expand(coarse, fine, fine, 1.0f, wd, ht, channels, border);
+}
+
+int dt_pyramid_detail(const float *const fine, const float *const coarse, float *const detail, const int wd,
+                      const int ht, const int channels, const dt_pyramid_border_t border)
+{
+  return _expand(coarse, detail, fine, -1.0f, wd, ht, channels, border);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,82 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * gaussian/laplacian pyramids with the 1 4 6 4 1 binomial kernel, as used for exposure fusion and local
+ * laplacian filters. every level has half the size of the previous one, (size-1)/2+1 to be precise.
+ * buffers have 1 or 4 interleaved float channels.
+ */
+
+#define DT_PYRAMID_MAX_LEVELS 30
+
+/** what happens at the image borders */
+typedef enum dt_pyramid_border_t
+{
+  DT_PYRAMID_BORDER_MIRROR = 0,   // mirror the fine grid at the borders
+  DT_PYRAMID_BORDER_REPLICATE = 1 // only compute inner pixels, replicate them into the border
+} dt_pyramid_border_t;
+
+/** all levels of a pyramid, in one allocation */
+typedef struct dt_pyramid_t
+{
+  int num_levels;
+  int channels;
+  int width[DT_PYRAMID_MAX_LEVELS];
+  int height[DT_PYRAMID_MAX_LEVELS];
+  float *level[DT_PYRAMID_MAX_LEVELS];
+  float *pool;
+} dt_pyramid_t;
+
+/** size of the given level for a finest level of size */
+static inline int dt_pyramid_dim(int size, const int level)
+{
+  for(int l = 0; l < level; l++) size = (size - 1) / 2 + 1;
+  return size;
+}
+
+/** allocates the levels of a pyramid, returns NULL if out of memory. the buffers are not initialized. */
+dt_pyramid_t *dt_pyramid_alloc(const int width, const int height, const int channels, const int num_levels);
+void dt_pyramid_free(dt_pyramid_t *p);
+/** memory needed by dt_pyramid_alloc() */
+size_t dt_pyramid_memory_use(const int width, const int height, const int channels, const int num_levels);
+
+/** the following return 1 if they are out of memory for their row buffers, and leave the output untouched */
+
+/** blur and downsample fine (of size wd x ht) into coarse in one pass */
+int dt_pyramid_reduce(const float *const fine, float *const coarse, const int wd, const int ht,
+                      const int channels, const dt_pyramid_border_t border);
+/** fills levels 1.. of the pyramid from its level 0 */
+int dt_pyramid_build(dt_pyramid_t *p, const dt_pyramid_border_t border);
+
+/** upsample and blur coarse into fine, which is of size wd x ht */
+int dt_pyramid_expand(const float *const coarse, float *const fine, const int wd, const int ht,
+                      const int channels, const dt_pyramid_border_t border);
+/** reconstruction step: fine += expanded coarse, without a temporary buffer */
+int dt_pyramid_collapse(const float *const coarse, float *const fine, const int wd, const int ht,
+                        const int channels, const dt_pyramid_border_t border);
+/** laplacian of a level: detail = fine - expanded coarse */
+int dt_pyramid_detail(const float *const fine, const float *const coarse, float *const detail, const int wd,
+                       const int ht, const int channels, const dt_pyramid_border_t border);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
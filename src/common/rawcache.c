@@ -0,0 +1,382 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/rawcache.h"
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/file_location.h"
+#include "control/conf.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DT_RAWCACHE_MAGIC "DTRAWC01"
+#define DT_RAWCACHE_VERSION 2
+// the payload starts at this offset, so that the file can be mapped
+#define DT_RAWCACHE_PAYLOAD_OFFSET 4096
+
+// everything the raw loader puts into dt_image_t besides the exif data
+typedef struct dt_rawcache_meta_t
+{
+  char camera_maker[64];
+  char camera_model[64];
+  char camera_alias[64];
+  char camera_legacy_makermodel[128];
+  int32_t width, height;
+  int32_t crop_x, crop_y, crop_width, crop_height;
+  int32_t flags;
+  dt_iop_buffer_dsc_t buf_dsc;
+  uint16_t raw_black_level;
+  uint16_t raw_black_level_separate[4];
+  uint32_t raw_white_point;
+  uint32_t fuji_rotation_pos;
+  float pixel_aspect_ratio;
+  float wb_coeffs[4];
+  float usercrop[4];
+} dt_rawcache_meta_t;
+
+typedef struct dt_rawcache_header_t
+{
+  char magic[8];
+  int32_t version;
+  int32_t meta_size;
+  // rawspeed is built into darktable, but reads its camera definitions at runtime
+  char dt_version[64];
+  int64_t cameras_mtime;
+  int64_t source_size;
+  int64_t source_mtime;
+  uint64_t payload_size;
+  dt_rawcache_meta_t meta;
+} dt_rawcache_header_t;
+
+G_STATIC_ASSERT(sizeof(dt_rawcache_header_t) <= DT_RAWCACHE_PAYLOAD_OFFSET);
+
+// the flags that come from the decoder, all others belong to the library
+#define DT_RAWCACHE_FLAGS                                                                                     \
+  (DT_IMAGE_LDR | DT_IMAGE_RAW | DT_IMAGE_HDR | DT_IMAGE_S_RAW | DT_IMAGE_4BAYER | DT_IMAGE_MONOCHROME)
+
+static struct
+{
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t stores;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+} _stats = { 0 };
+
+static GMutex _evict_lock;
+
+static size_t _budget()
+{
+  const int64_t budget = dt_conf_get_int64("cache_disk_backend_raw");
+  return budget > 0 ? budget : 0;
+}
+
+static gchar *_cache_dir()
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "rawcache", NULL);
+}
+
+// modification time of rawspeed's cameras.xml, which holds the crops, black and white levels
+static int64_t _cameras_mtime()
+{
+  char datadir[PATH_MAX] = { 0 };
+  dt_loc_get_datadir(datadir, sizeof(datadir));
+  gchar *camfile = g_build_filename(datadir, "rawspeed", "cameras.xml", NULL);
+  GStatBuf st;
+  const int64_t mtime = g_stat(camfile, &st) ? 0 : (int64_t)st.st_mtime;
+  g_free(camfile);
+  return mtime;
+}
+
+static gchar *_entry_path(const char *filename)
+{
+  gchar *dir = _cache_dir();
+  gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, filename, -1);
+  gchar *name = g_strconcat(hash, ".raw", NULL);
+  gchar *path = g_build_filename(dir, name, NULL);
+  g_free(name);
+  g_free(hash);
+  g_free(dir);
+  return path;
+}
+
+gboolean dt_rawcache_load(dt_image_t *img, const char *filename, dt_mipmap_buffer_t *buf)
+{
+  if(!_budget()) return FALSE;
+
+  const double start = dt_get_wtime();
+  GStatBuf source;
+  if(g_stat(filename, &source)) return FALSE;
+
+  gchar *path = _entry_path(filename);
+  FILE *f = g_fopen(path, "rb");
+  if(!f)
+  {
+    __sync_fetch_and_add(&_stats.misses, 1);
+    dt_print(DT_DEBUG_CACHE, "[rawcache] miss for `%s'\n", filename);
+    g_free(path);
+    return FALSE;
+  }
+
+  dt_rawcache_header_t header;
+  gboolean ok = fread(&header, sizeof(header), 1, f) == 1
+                && !memcmp(header.magic, DT_RAWCACHE_MAGIC, sizeof(header.magic))
+                && header.version == DT_RAWCACHE_VERSION && header.meta_size == sizeof(dt_rawcache_meta_t)
+                && !strncmp(header.dt_version, darktable_package_version, sizeof(header.dt_version) - 1)
+                && header.cameras_mtime == _cameras_mtime()
+                && header.source_size == (int64_t)source.st_size
+                && header.source_mtime == (int64_t)source.st_mtime
+                && header.payload_size == (uint64_t)header.meta.width * header.meta.height
+                                              * dt_iop_buffer_dsc_to_bpp(&header.meta.buf_dsc);
+
+  const int32_t width = img->width, height = img->height;
+  const dt_iop_buffer_dsc_t buf_dsc = img->buf_dsc;
+  if(ok)
+  {
+    const dt_rawcache_meta_t *meta = &header.meta;
+    img->width = meta->width;
+    img->height = meta->height;
+    img->buf_dsc = meta->buf_dsc;
+    img->buf_dsc.work_profile_info = NULL;
+    img->buf_dsc.packed = 0;
+    img->buf_dsc.cst = iop_cs_RAW;
+
+    void *data = dt_mipmap_cache_alloc(buf, img);
+    ok = data && !fseek(f, DT_RAWCACHE_PAYLOAD_OFFSET, SEEK_SET)
+         && fread(data, header.payload_size, 1, f) == 1;
+  }
+  fclose(f);
+
+  if(!ok)
+  {
+    // stale or damaged, the decoder will overwrite it
+    img->width = width;
+    img->height = height;
+    img->buf_dsc = buf_dsc;
+    __sync_fetch_and_add(&_stats.misses, 1);
+    dt_print(DT_DEBUG_CACHE, "[rawcache] stale entry for `%s'\n", filename);
+    g_unlink(path);
+    g_free(path);
+    return FALSE;
+  }
+
+  // the exif data is not part of the entry, it is small and has its own cache in the library
+  if(!img->exif_inited) (void)dt_exif_read(img, filename);
+
+  const dt_rawcache_meta_t *meta = &header.meta;
+  g_strlcpy(img->camera_maker, meta->camera_maker, sizeof(img->camera_maker));
+  g_strlcpy(img->camera_model, meta->camera_model, sizeof(img->camera_model));
+  g_strlcpy(img->camera_alias, meta->camera_alias, sizeof(img->camera_alias));
+  g_strlcpy(img->camera_legacy_makermodel, meta->camera_legacy_makermodel,
+            sizeof(img->camera_legacy_makermodel));
+  dt_image_refresh_makermodel(img);
+  img->crop_x = meta->crop_x;
+  img->crop_y = meta->crop_y;
+  img->crop_width = meta->crop_width;
+  img->crop_height = meta->crop_height;
+  img->flags = (img->flags & ~DT_RAWCACHE_FLAGS) | (meta->flags & DT_RAWCACHE_FLAGS);
+  img->raw_black_level = meta->raw_black_level;
+  for(int k = 0; k < 4; k++) img->raw_black_level_separate[k] = meta->raw_black_level_separate[k];
+  img->raw_white_point = meta->raw_white_point;
+  img->fuji_rotation_pos = meta->fuji_rotation_pos;
+  img->pixel_aspect_ratio = meta->pixel_aspect_ratio;
+  for(int k = 0; k < 4; k++) img->wb_coeffs[k] = meta->wb_coeffs[k];
+  for(int k = 0; k < 4; k++) img->usercrop[k] = meta->usercrop[k];
+  img->loader = LOADER_RAWSPEED;
+
+  // mark as recently used
+  g_utime(path, NULL);
+  g_free(path);
+
+  __sync_fetch_and_add(&_stats.hits, 1);
+  __sync_fetch_and_add(&_stats.bytes_read, header.payload_size);
+  dt_print(DT_DEBUG_CACHE, "[rawcache] hit for `%s', %.1f MB in %.3f secs\n", filename,
+           header.payload_size / (1024.0 * 1024.0), dt_get_wtime() - start);
+  return TRUE;
+}
+
+typedef struct _entry_t
+{
+  gchar *path;
+  time_t mtime;
+  size_t size;
+} _entry_t;
+
+static gint _sort_by_mtime(gconstpointer a, gconstpointer b)
+{
+  const _entry_t *ea = (const _entry_t *)a;
+  const _entry_t *eb = (const _entry_t *)b;
+  return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+static void _free_entry(gpointer data)
+{
+  _entry_t *e = (_entry_t *)data;
+  g_free(e->path);
+  g_free(e);
+}
+
+// drops least recently used entries until there is room for incoming bytes
+static void _evict(const char *dir, const size_t incoming, const size_t budget)
+{
+  GDir *d = g_dir_open(dir, 0, NULL);
+  if(!d) return;
+
+  GList *entries = NULL;
+  size_t total = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(d)))
+  {
+    if(!g_str_has_suffix(name, ".raw")) continue;
+    _entry_t *e = g_malloc(sizeof(_entry_t));
+    e->path = g_build_filename(dir, name, NULL);
+    GStatBuf st;
+    if(g_stat(e->path, &st))
+    {
+      _free_entry(e);
+      continue;
+    }
+    e->mtime = st.st_mtime;
+    e->size = st.st_size;
+    total += e->size;
+    entries = g_list_prepend(entries, e);
+  }
+  g_dir_close(d);
+
+  entries = g_list_sort(entries, _sort_by_mtime);
+  for(GList *l = entries; l && total + incoming > budget; l = g_list_next(l))
+  {
+    _entry_t *e = (_entry_t *)l->data;
+    if(!g_unlink(e->path))
+    {
+      total -= e->size;
+      dt_print(DT_DEBUG_CACHE, "[rawcache] evicted `%s'\n", e->path);
+    }
+  }
+  g_list_free_full(entries, _free_entry);
+}
+
+void dt_rawcache_store(const dt_image_t *img, const char *filename, const dt_mipmap_buffer_t *buf)
+{
+  const size_t budget = _budget();
+  if(!budget || !buf->buf) return;
+
+  const size_t payload_size = (size_t)img->width * img->height * dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
+  const size_t file_size = DT_RAWCACHE_PAYLOAD_OFFSET + payload_size;
+  // a single image should not flush everything else
+  if(file_size > budget / 4) return;
+
+  GStatBuf source;
+  if(g_stat(filename, &source)) return;
+
+  dt_rawcache_header_t *header = g_malloc0(DT_RAWCACHE_PAYLOAD_OFFSET);
+  memcpy(header->magic, DT_RAWCACHE_MAGIC, sizeof(header->magic));
+  header->version = DT_RAWCACHE_VERSION;
+  header->meta_size = sizeof(dt_rawcache_meta_t);
+  g_strlcpy(header->dt_version, darktable_package_version, sizeof(header->dt_version));
+  header->cameras_mtime = _cameras_mtime();
+  header->source_size = source.st_size;
+  header->source_mtime = source.st_mtime;
+  header->payload_size = payload_size;
+
+  dt_rawcache_meta_t *meta = &header->meta;
+  g_strlcpy(meta->camera_maker, img->camera_maker, sizeof(meta->camera_maker));
+  g_strlcpy(meta->camera_model, img->camera_model, sizeof(meta->camera_model));
+  g_strlcpy(meta->camera_alias, img->camera_alias, sizeof(meta->camera_alias));
+  g_strlcpy(meta->camera_legacy_makermodel, img->camera_legacy_makermodel,
+            sizeof(meta->camera_legacy_makermodel));
+  meta->width = img->width;
+  meta->height = img->height;
+  meta->crop_x = img->crop_x;
+  meta->crop_y = img->crop_y;
+  meta->crop_width = img->crop_width;
+  meta->crop_height = img->crop_height;
+  meta->flags = img->flags;
+  meta->buf_dsc = img->buf_dsc;
+  meta->buf_dsc.work_profile_info = NULL;
+  meta->raw_black_level = img->raw_black_level;
+  for(int k = 0; k < 4; k++) meta->raw_black_level_separate[k] = img->raw_black_level_separate[k];
+  meta->raw_white_point = img->raw_white_point;
+  meta->fuji_rotation_pos = img->fuji_rotation_pos;
+  meta->pixel_aspect_ratio = img->pixel_aspect_ratio;
+  for(int k = 0; k < 4; k++) meta->wb_coeffs[k] = img->wb_coeffs[k];
+  for(int k = 0; k < 4; k++) meta->usercrop[k] = img->usercrop[k];
+
+  gchar *dir = _cache_dir();
+  g_mkdir_with_parents(dir, 0750);
+
+  g_mutex_lock(&_evict_lock);
+  _evict(dir, file_size, budget);
+  g_mutex_unlock(&_evict_lock);
+
+  // write to a temporary file and move it into place, readers never see a partial entry
+  gchar *tmpfile = g_build_filename(dir, "entry-XXXXXX", NULL);
+  gchar *path = _entry_path(filename);
+  const gint fd = g_mkstemp(tmpfile);
+  gboolean ok = FALSE;
+  if(fd != -1)
+  {
+    FILE *f = fdopen(fd, "wb");
+    if(f)
+    {
+      ok = fwrite(header, DT_RAWCACHE_PAYLOAD_OFFSET, 1, f) == 1
+           && fwrite(buf->buf, payload_size, 1, f) == 1;
+      ok = !fclose(f) && ok;
+    }
+    else
+      close(fd);
+    ok = ok && !g_rename(tmpfile, path);
+    if(!ok) g_unlink(tmpfile);
+  }
+
+  if(ok)
+  {
+    __sync_fetch_and_add(&_stats.stores, 1);
+    __sync_fetch_and_add(&_stats.bytes_written, file_size);
+    dt_print(DT_DEBUG_CACHE, "[rawcache] stored `%s', %.1f MB\n", filename, file_size / (1024.0 * 1024.0));
+  }
+  else
+    dt_print(DT_DEBUG_CACHE, "[rawcache] failed to store `%s'\n", filename);
+
+  g_free(path);
+  g_free(tmpfile);
+  g_free(dir);
+  g_free(header);
+}
+
+void dt_rawcache_print()
+{
+  if(!_budget()) return;
+  const uint32_t requests = _stats.hits + _stats.misses;
+  printf("[rawcache] %" PRIu32 " hits, %" PRIu32 " misses (%.2f%% hit rate), %" PRIu32 " stores\n", _stats.hits,
+         _stats.misses, requests ? 100.0 * _stats.hits / requests : 0.0, _stats.stores);
+  printf("[rawcache] read %.2f MB, written %.2f MB\n", _stats.bytes_read / (1024.0 * 1024.0),
+         _stats.bytes_written / (1024.0 * 1024.0));
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
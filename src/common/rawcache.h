@@ -0,0 +1,42 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/image.h"
+#include "common/mipmap_cache.h"
+
+/**
+ * on-disk cache of decoded raw sensor data, i.e. of the DT_MIPMAP_FULL buffer as rawspeed delivers it, plus
+ * the image metadata that comes out of the decoder. entries are keyed by the path of the raw and checked
+ * against its size and mtime, and against the darktable version and cameras.xml that decoded it. the payload
+ * is stored uncompressed and page aligned, so it is read back with a single read (or could be mmap()ed). the
+ * least recently used entries get dropped to stay within the size set in cache_disk_backend_raw, 0 disables
+ * the cache.
+ */
+
+/** fills img and the full buffer from the cache, returns TRUE on a hit */
+gboolean dt_rawcache_load(dt_image_t *img, const char *filename, dt_mipmap_buffer_t *buf);
+/** stores a freshly decoded full buffer */
+void dt_rawcache_store(const dt_image_t *img, const char *filename, const dt_mipmap_buffer_t *buf);
+/** prints hit rate and traffic */
+void dt_rawcache_print();
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
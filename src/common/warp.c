@@ -0,0 +1,250 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/warp.h"
+#include "common/darktable.h"
+
+#include <math.h>
+#include <string.h>
+
+// distance of the exactly mapped points of generic mappings
+#define DT_WARP_KNOT_STEP 16
+// largest error of the linear steps in between, in input pixels
+#define DT_WARP_TOLERANCE (1.0f / 32.0f)
+// where pixels outside of an intermediate buffer get sampled, far enough off the input to come out black
+#define DT_WARP_OUTSIDE (-1.0e6f)
+
+void dt_warp_init(dt_warp_t *w)
+{
+  memset(w, 0, sizeof(dt_warp_t));
+  w->h[0] = w->h[4] = w->h[8] = 1.0;
+}
+
+void dt_warp_init_generic(dt_warp_t *w, dt_warp_backtransform_t backtransform, const void *data)
+{
+  dt_warp_init(w);
+  w->backtransform = backtransform;
+  w->data = data;
+}
+
+void dt_warp_homography(dt_warp_t *w, const double m[9])
+{
+  double r[9];
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+      r[3 * i + j] = m[3 * i] * w->h[j] + m[3 * i + 1] * w->h[3 + j] + m[3 * i + 2] * w->h[6 + j];
+  memcpy(w->h, r, sizeof(r));
+  w->projective = w->h[6] != 0.0 || w->h[7] != 0.0 || w->h[8] != 1.0;
+}
+
+void dt_warp_translate(dt_warp_t *w, const double tx, const double ty)
+{
+  const double m[9] = { 1.0, 0.0, tx, 0.0, 1.0, ty, 0.0, 0.0, 1.0 };
+  dt_warp_homography(w, m);
+}
+
+void dt_warp_scale(dt_warp_t *w, const double sx, const double sy)
+{
+  const double m[9] = { sx, 0.0, 0.0, 0.0, sy, 0.0, 0.0, 0.0, 1.0 };
+  dt_warp_homography(w, m);
+}
+
+void dt_warp_linear(dt_warp_t *w, const float m[4])
+{
+  const double h[9] = { m[0], m[1], 0.0, m[2], m[3], 0.0, 0.0, 0.0, 1.0 };
+  dt_warp_homography(w, h);
+}
+
+int dt_warp_bound(dt_warp_t *w, const int width, const int height)
+{
+  if(w->backtransform || w->bounds == DT_WARP_MAX_BOUNDS) return 0;
+  dt_warp_bound_t *b = w->bound + w->bounds++;
+  memcpy(b->h, w->h, sizeof(b->h));
+  b->width = width;
+  b->height = height;
+  return 1;
+}
+
+static inline void _exact(const dt_warp_t *w, const int x, const int y, float *p)
+{
+  p[0] = x;
+  p[1] = y;
+  w->backtransform(w->data, p);
+}
+
+static void _row_generic(const dt_warp_t *w, const int x, const int y, const int n, float *xy)
+{
+  _exact(w, x, y, xy);
+  for(int a = 0; a < n - 1; a += DT_WARP_KNOT_STEP)
+  {
+    const int b = MIN(a + DT_WARP_KNOT_STEP, n - 1);
+    _exact(w, x + b, y, xy + 2 * b);
+    if(b - a < 2) continue;
+
+    // check the linear step in the middle of the segment, the mappings we see are smooth
+    const int m = (a + b) / 2;
+    const float t = (float)(m - a) / (b - a);
+    float p[2];
+    _exact(w, x + m, y, p);
+    const float ex = xy[2 * a] + t * (xy[2 * b] - xy[2 * a]) - p[0];
+    const float ey = xy[2 * a + 1] + t * (xy[2 * b + 1] - xy[2 * a + 1]) - p[1];
+
+    if(fabsf(ex) < DT_WARP_TOLERANCE && fabsf(ey) < DT_WARP_TOLERANCE)
+    {
+      const float dx = (xy[2 * b] - xy[2 * a]) / (b - a);
+      const float dy = (xy[2 * b + 1] - xy[2 * a + 1]) / (b - a);
+      for(int k = a + 1; k < b; k++)
+      {
+        xy[2 * k] = xy[2 * a] + (k - a) * dx;
+        xy[2 * k + 1] = xy[2 * a + 1] + (k - a) * dy;
+      }
+    }
+    else
+    {
+      for(int k = a + 1; k < b; k++) _exact(w, x + k, y, xy + 2 * k);
+    }
+  }
+}
+
+// a pixel survives an intermediate buffer if interpolation.c reads it from there, else it ends up black
+static void _row_bound(const dt_warp_bound_t *b, const int x, const int y, const int n, float *xy)
+{
+  const double *h = b->h;
+  const double px = h[0] * x + h[1] * y + h[2];
+  const double py = h[3] * x + h[4] * y + h[5];
+  const double pw = h[6] * x + h[7] * y + h[8];
+  for(int k = 0; k < n; k++)
+  {
+    const double iw = 1.0 / (pw + k * h[6]);
+    const double bx = (px + k * h[0]) * iw;
+    const double by = (py + k * h[3]) * iw;
+    if(bx > -1.0 && by > -1.0 && bx < b->width && by < b->height) continue;
+    xy[2 * k] = xy[2 * k + 1] = DT_WARP_OUTSIDE;
+  }
+}
+
+void dt_warp_row(const dt_warp_t *w, const int x, const int y, const int n, float *xy)
+{
+  if(w->backtransform)
+  {
+    _row_generic(w, x, y, n, xy);
+    return;
+  }
+
+  const double *h = w->h;
+  const double px = h[0] * x + h[1] * y + h[2];
+  const double py = h[3] * x + h[4] * y + h[5];
+  if(w->projective)
+  {
+    const double pw = h[6] * x + h[7] * y + h[8];
+    for(int k = 0; k < n; k++)
+    {
+      const double iw = 1.0 / (pw + k * h[6]);
+      xy[2 * k] = (px + k * h[0]) * iw;
+      xy[2 * k + 1] = (py + k * h[3]) * iw;
+    }
+  }
+  else
+  {
+    for(int k = 0; k < n; k++)
+    {
+      xy[2 * k] = px + k * h[0];
+      xy[2 * k + 1] = py + k * h[3];
+    }
+  }
+
+  for(int b = 0; b < w->bounds; b++) _row_bound(w->bound + b, x, y, n, xy);
+}
+
+// no room for the coordinates of the rows: hand on what overlaps of the input, so there is no garbage in out
+static void _warp_pass_through(const float *const in, float *const out, const int ch,
+                               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  fprintf(stderr, "[warp] failed to allocate scratch buffer, passing the input through\n");
+  const int width = MIN(roi_in->width, roi_out->width);
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    float *o = out + (size_t)ch * j * roi_out->width;
+    memset(o, 0, sizeof(float) * ch * roi_out->width);
+    if(j < roi_in->height) memcpy(o, in + (size_t)ch * j * roi_in->width, sizeof(float) * ch * width);
+  }
+}
+
+int dt_warp_process(const dt_warp_t *w, const struct dt_interpolation *itor, const float *const in,
+                    float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const int width = roi_out->width;
+  const size_t padded = dt_round_size(2 * width, 16);
+  float *const scratch = dt_alloc_align(64, sizeof(float) * padded * dt_get_num_threads());
+  if(!scratch)
+  {
+    _warp_pass_through(in, out, 4, roi_in, roi_out);
+    return 1;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, out, padded, roi_in, roi_out, scratch, width) \
+  shared(w, itor) \
+  schedule(static)
+#endif
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    float *xy = scratch + padded * dt_get_thread_num();
+    dt_warp_row(w, 0, j, width, xy);
+    dt_interpolation_compute_row4c(itor, in, out + (size_t)4 * j * width, xy, width, roi_in->width,
+                                   roi_in->height, 4 * roi_in->width);
+  }
+
+  dt_free_align(scratch);
+  return 0;
+}
+
+int dt_warp_process_1c(const dt_warp_t *w, const struct dt_interpolation *itor, const float *const in,
+                       float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const int width = roi_out->width;
+  const size_t padded = dt_round_size(2 * width, 16);
+  float *const scratch = dt_alloc_align(64, sizeof(float) * padded * dt_get_num_threads());
+  if(!scratch)
+  {
+    _warp_pass_through(in, out, 1, roi_in, roi_out);
+    return 1;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, out, padded, roi_in, roi_out, scratch, width) \
+  shared(w, itor) \
+  schedule(static)
+#endif
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    float *xy = scratch + padded * dt_get_thread_num();
+    dt_warp_row(w, 0, j, width, xy);
+    dt_interpolation_compute_row1c(itor, in, out + (size_t)j * width, xy, width, roi_in->width,
+                                   roi_in->height, roi_in->width);
+  }
+
+  dt_free_align(scratch);
+  return 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
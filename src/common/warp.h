@@ -0,0 +1,85 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/interpolation.h"
+
+/**
+ * resampling of a buffer through a geometric mapping, for modules that rotate, scale or correct
+ * perspective. the mapping goes backwards from the pixel indices of roi_out to coordinates in roi_in.
+ *
+ * affine and projective mappings are kept as a 3x3 matrix and walked incrementally along each output row.
+ * other mappings are given as a callback, which is evaluated every few pixels and linearly interpolated in
+ * between wherever that is accurate enough.
+ */
+
+/** maps a point of the output to the input, in place */
+typedef void (*dt_warp_backtransform_t)(const void *data, float *p);
+
+/** most intermediate buffers a matrix mapping keeps the bounds of, see dt_warp_bound() */
+#define DT_WARP_MAX_BOUNDS 8
+
+typedef struct dt_warp_bound_t
+{
+  double h[9];       // (x, y, w) in the intermediate buffer = h * (i, j, 1)
+  int width, height; // its size
+} dt_warp_bound_t;
+
+typedef struct dt_warp_t
+{
+  double h[9];                           // (x, y, w) in the input = h * (i, j, 1), row major
+  int projective;                        // h[6..8] is not (0, 0, 1)
+  dt_warp_backtransform_t backtransform; // set for all other mappings, h is unused then
+  const void *data;
+  int bounds;                            // used entries of bound
+  dt_warp_bound_t bound[DT_WARP_MAX_BOUNDS];
+} dt_warp_t;
+
+/** identity mapping */
+void dt_warp_init(dt_warp_t *w);
+/** mapping given by a callback */
+void dt_warp_init_generic(dt_warp_t *w, dt_warp_backtransform_t backtransform, const void *data);
+
+/** the following ones append a step to a matrix mapping, in the order they are applied to the point */
+void dt_warp_translate(dt_warp_t *w, const double tx, const double ty);
+void dt_warp_scale(dt_warp_t *w, const double sx, const double sy);
+/** 2x2 matrix, as in o[0] = m[0] * p[0] + m[1] * p[1], o[1] = m[2] * p[0] + m[3] * p[1] */
+void dt_warp_linear(dt_warp_t *w, const float m[4]);
+/** general 3x3 matrix on homogeneous coordinates, row major */
+void dt_warp_homography(dt_warp_t *w, const double m[9]);
+
+/** pixels which the mapping so far takes outside of [0, width) x [0, height) come out black, as if the image
+ * was resampled into a buffer of that size in between. matrix mappings only, returns 0 if there is no room left
+ * for another bound. */
+int dt_warp_bound(dt_warp_t *w, const int width, const int height);
+
+/** input coordinates of the n output pixels (x, y) .. (x + n - 1, y) */
+void dt_warp_row(const dt_warp_t *w, const int x, const int y, const int n, float *xy);
+
+/** fills roi_out from the 4 channel buffer in. returns non-zero if there was no memory for it, out then holds
+ * the input cropped to roi_out. */
+int dt_warp_process(const dt_warp_t *w, const struct dt_interpolation *itor, const float *const in,
+                    float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out);
+/** same for single channel buffers (masks) */
+int dt_warp_process_1c(const dt_warp_t *w, const struct dt_interpolation *itor, const float *const in,
+                       float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -200,15 +200,25 @@ typedef struct dt_control_t
 
   // job management
   int32_t running;
-  gboolean export_scheduled;
-  dt_pthread_mutex_t queue_mutex, cond_mutex, run_mutex;
+  int32_t export_scheduled;
+  dt_pthread_mutex_t cond_mutex, run_mutex;
   pthread_cond_t cond;
   int32_t num_threads;
   pthread_t *thread, kick_on_workers_thread;
-  dt_job_t **job;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  // every queue has its own lock, so adding to one queue never waits on workers picking from another.
+  // the lengths are updated atomically and can be peeked at without the lock.
+  dt_pthread_mutex_t queue_mutex[DT_JOB_QUEUE_MAX];
+  GQueue queues[DT_JOB_QUEUE_MAX];
+  int32_t queue_length[DT_JOB_QUEUE_MAX];
+  // stride scheduling: each queue advances its virtual time by the inverse of its weight when it is picked
+  uint64_t queue_pass[DT_JOB_QUEUE_MAX];
+  uint64_t queue_vtime;
+  // system foreground jobs that are queued (job -> GList link) or running, for deduping.
+  // protected by the system foreground queue mutex.
+  GHashTable *queued_fg, *running_fg;
+  // latency and throughput statistics, see dt_control_jobs_get_stats()
+  struct dt_job_stats_t *job_stats;
 
   dt_pthread_mutex_t res_mutex;
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
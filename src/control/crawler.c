@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <gio/gio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <sqlite3.h>
@@ -24,9 +25,13 @@
 
 #include "common/darktable.h"
 #include "common/database.h"
+#include "common/debug.h"
+#include "common/file_location.h"
 #include "common/history.h"
 #include "common/image.h"
 #include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
 #include "crawler.h"
 #include "gui/gtk.h"
 #ifdef GDK_WINDOWING_QUARTZ
@@ -53,144 +58,727 @@ typedef struct dt_control_crawler_result_t
   char *image_path, *xmp_path;
 } dt_control_crawler_result_t;
 
+#define DT_CRAWLER_CACHE_VERSION 2
+#define DT_CRAWLER_CACHE_TYPE "(ua(sxta(sxxt)as))"
 
-GList *dt_control_crawler_run()
+// what we remember about a file between crawls
+typedef struct dt_crawler_stat_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  gint64 mtime, size;
+  guint64 inode;
+} dt_crawler_stat_t;
 
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags "
-                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
-                     -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
+// what the last crawl saw of a folder: its own stat and the files of interest that exist in it. only xmp files
+// get their stat filled in, for the other ones we just need to know that they are there.
+typedef struct dt_crawler_folder_cache_t
+{
+  dt_crawler_stat_t dir;
+  GHashTable *files;   // file name -> dt_crawler_stat_t
+  GHashTable *missing; // images that were looked for and not found
+} dt_crawler_folder_cache_t;
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+// an image from the database
+typedef struct dt_crawler_image_t
+{
+  int id, version, flags, new_flags;
+  time_t timestamp;
+  char *filename;
+} dt_crawler_image_t;
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+// all the images of one folder, and what the crawl found out about them
+typedef struct dt_crawler_folder_t
+{
+  char *path;
+  GArray *images;                   // dt_crawler_image_t
+  dt_crawler_folder_cache_t *seen;  // new cache entry, NULL if the cached one was still valid
+  GList *results;                   // dt_control_crawler_result_t
+} dt_crawler_folder_t;
+
+typedef struct dt_crawler_params_t
+{
+  GList *folders; // the folders to look at, NULL for all film rolls
+  gboolean force; // ignore the stat cache, for folders we were told have changed
+} dt_crawler_params_t;
+
+// state shared by the threads of one crawl
+typedef struct dt_crawler_run_t
+{
+  dt_job_t *job;
+  gboolean look_for_xmp, use_cache;
+  gint64 start;           // wall clock seconds when the crawl started
+  gint64 interval;        // microseconds between two file system accesses, 0 for no limit
+  gint64 next_slot;
+  int done, total;
+  dt_pthread_mutex_t lock;
+} dt_crawler_run_t;
+
+// folder -> dt_crawler_folder_cache_t, persisted in the cache directory between sessions. crawls hold the
+// lock while they run, so there is only ever one of them touching the file system and the cache.
+static GMutex _cache_lock;
+static GHashTable *_cache = NULL;
+
+// the gui side, only touched from the gui thread
+static GHashTable *_monitors = NULL; // folder -> GFileMonitor
+static GHashTable *_pending = NULL;  // folders that changed since they got crawled last
+static guint _pending_timeout = 0;
+
+// sidecars darktable wrote itself, so that the monitors don't crawl because of them
+static GMutex _written_lock;
+static GHashTable *_written = NULL; // path -> monotonic time of the write
+#define DT_CRAWLER_OWN_WRITE_USECS (5 * G_USEC_PER_SEC)
+
+static void _folder_cache_free(gpointer data)
+{
+  dt_crawler_folder_cache_t *entry = (dt_crawler_folder_cache_t *)data;
+  if(!entry) return;
+  g_hash_table_destroy(entry->files);
+  g_hash_table_destroy(entry->missing);
+  g_free(entry);
+}
+
+static dt_crawler_folder_cache_t *_folder_cache_new()
+{
+  dt_crawler_folder_cache_t *entry = g_malloc0(sizeof(dt_crawler_folder_cache_t));
+  entry->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  entry->missing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  return entry;
+}
+
+static void _folder_cache_add(dt_crawler_folder_cache_t *entry, const char *name, const dt_crawler_stat_t *st)
+{
+  dt_crawler_stat_t *copy = g_malloc0(sizeof(dt_crawler_stat_t));
+  if(st) *copy = *st;
+  g_hash_table_insert(entry->files, g_strdup(name), copy);
+}
+
+static gchar *_cache_filename()
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "crawler.cache", NULL);
+}
+
+// needs _cache_lock
+static void _cache_load()
+{
+  if(_cache) return;
+  _cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _folder_cache_free);
+
+  gchar *filename = _cache_filename();
+  gchar *data = NULL;
+  gsize size = 0;
+  const gboolean ok = g_file_get_contents(filename, &data, &size, NULL);
+  g_free(filename);
+  if(!ok) return;
+
+  // not trusted, a broken file just reads as empty arrays
+  GVariant *cache = g_variant_new_from_data(G_VARIANT_TYPE(DT_CRAWLER_CACHE_TYPE), data, size, FALSE, g_free, data);
+  guint32 version = 0;
+  GVariantIter *folders = NULL;
+  g_variant_get(cache, DT_CRAWLER_CACHE_TYPE, &version, &folders);
+  if(version == DT_CRAWLER_CACHE_VERSION)
+  {
+    const gchar *folder;
+    dt_crawler_stat_t dir = { 0 };
+    GVariantIter *files = NULL, *missing = NULL;
+    while(g_variant_iter_loop(folders, "(&sxta(sxxt)as)", &folder, &dir.mtime, &dir.inode, &files, &missing))
+    {
+      dt_crawler_folder_cache_t *entry = _folder_cache_new();
+      entry->dir = dir;
+      const gchar *name;
+      dt_crawler_stat_t st = { 0 };
+      while(g_variant_iter_loop(files, "(&sxxt)", &name, &st.mtime, &st.size, &st.inode))
+        _folder_cache_add(entry, name, &st);
+      while(g_variant_iter_loop(missing, "&s", &name)) g_hash_table_add(entry->missing, g_strdup(name));
+      g_hash_table_insert(_cache, g_strdup(folder), entry);
+    }
+  }
+  g_variant_iter_free(folders);
+  g_variant_unref(cache);
+}
+
+// needs _cache_lock
+static void _cache_save()
+{
+  GVariantBuilder folders;
+  g_variant_builder_init(&folders, G_VARIANT_TYPE("a(sxta(sxxt)as)"));
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, _cache);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_crawler_folder_cache_t *entry = (dt_crawler_folder_cache_t *)value;
+    GVariantBuilder files;
+    g_variant_builder_init(&files, G_VARIANT_TYPE("a(sxxt)"));
+    GHashTableIter file_iter;
+    gpointer name, stat;
+    g_hash_table_iter_init(&file_iter, entry->files);
+    while(g_hash_table_iter_next(&file_iter, &name, &stat))
+    {
+      const dt_crawler_stat_t *st = (dt_crawler_stat_t *)stat;
+      g_variant_builder_add(&files, "(sxxt)", (const char *)name, st->mtime, st->size, st->inode);
+    }
+    GVariantBuilder missing;
+    g_variant_builder_init(&missing, G_VARIANT_TYPE("as"));
+    g_hash_table_iter_init(&file_iter, entry->missing);
+    while(g_hash_table_iter_next(&file_iter, &name, NULL))
+      g_variant_builder_add(&missing, "s", (const char *)name);
+    g_variant_builder_add(&folders, "(sxta(sxxt)as)", (const char *)key, entry->dir.mtime, entry->dir.inode,
+                          &files, &missing);
+  }
+
+  GVariant *cache = g_variant_ref_sink(g_variant_new(DT_CRAWLER_CACHE_TYPE, DT_CRAWLER_CACHE_VERSION, &folders));
+  gchar *filename = _cache_filename();
+  GError *error = NULL;
+  if(!g_file_set_contents(filename, g_variant_get_data(cache), g_variant_get_size(cache), &error))
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
+    dt_print(DT_DEBUG_CONTROL, "[crawler] can't write `%s': %s\n", filename, error->message);
+    g_error_free(error);
+  }
+  g_free(filename);
+  g_variant_unref(cache);
+}
+
+static gboolean _crawler_stat(const char *path, dt_crawler_stat_t *st)
+{
+  GStatBuf statbuf;
+  if(g_stat(path, &statbuf) == -1) return FALSE;
+  st->mtime = statbuf.st_mtime;
+  st->size = statbuf.st_size;
+  st->inode = statbuf.st_ino;
+  return TRUE;
+}
+
+// rate limiting of file system accesses, to not hog network shares
+static void _crawler_throttle(dt_crawler_run_t *run)
+{
+  if(run->interval <= 0) return;
+  dt_pthread_mutex_lock(&run->lock);
+  const gint64 now = g_get_monotonic_time();
+  const gint64 slot = MAX(now, run->next_slot);
+  run->next_slot = slot + run->interval;
+  dt_pthread_mutex_unlock(&run->lock);
+  if(slot > now) g_usleep(slot - now);
+}
+
+// the sidecar name of an image, in a buffer of PATH_MAX
+static gboolean _xmp_name(const dt_crawler_image_t *image, char *xmp_name)
+{
+  g_strlcpy(xmp_name, image->filename, PATH_MAX);
+  dt_image_path_append_version_no_db(image->version, xmp_name, PATH_MAX);
+  return g_strlcat(xmp_name, ".xmp", PATH_MAX) < PATH_MAX;
+}
+
+// the name of the image with the extension replaced, as associated text and audio files are named
+static gchar *_extra_name(const char *filename, const char *extension)
+{
+  const char *dot = strrchr(filename, '.');
+  const size_t len = dot ? dot - filename : strlen(filename);
+  return g_strdup_printf("%.*s.%s", (int)len, filename, extension);
+}
+
+static const char *_extra_extensions[] = { "txt", "TXT", "wav", "WAV" };
+
+// reads the folder listing once instead of testing for every single file and keeps the files that
+// matter for its images
+static dt_crawler_folder_cache_t *_crawler_list_folder(dt_crawler_run_t *run, const dt_crawler_folder_t *folder,
+                                                       const dt_crawler_stat_t *dir)
+{
+  _crawler_throttle(run);
+  GDir *gdir = g_dir_open(folder->path, 0, NULL);
+  if(!gdir) return NULL;
+  GHashTable *listing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  const gchar *name;
+  while((name = g_dir_read_name(gdir))) g_hash_table_add(listing, g_strdup(name));
+  g_dir_close(gdir);
+
+  dt_crawler_folder_cache_t *entry = _folder_cache_new();
+  entry->dir = *dir;
+  // a folder that changed within the last second might change again without its mtime showing it. we
+  // don't trust such an entry next time.
+  if(dir->mtime >= run->start - 1) entry->dir.mtime = 0;
+
+  for(guint k = 0; k < folder->images->len; k++)
+  {
+    const dt_crawler_image_t *image = &g_array_index(folder->images, dt_crawler_image_t, k);
+    if(!g_hash_table_contains(listing, image->filename))
+    {
+      g_hash_table_add(entry->missing, g_strdup(image->filename));
+      continue;
+    }
+    _folder_cache_add(entry, image->filename, NULL);
+
+    char xmp_name[PATH_MAX];
+    if(run->look_for_xmp && _xmp_name(image, xmp_name) && g_hash_table_contains(listing, xmp_name)
+       && !g_hash_table_contains(entry->files, xmp_name))
+    {
+      gchar *xmp_path = g_build_filename(folder->path, xmp_name, NULL);
+      dt_crawler_stat_t st;
+      _crawler_throttle(run);
+      if(_crawler_stat(xmp_path, &st)) _folder_cache_add(entry, xmp_name, &st);
+      g_free(xmp_path);
+    }
+
+    for(int e = 0; e < G_N_ELEMENTS(_extra_extensions); e++)
+    {
+      gchar *extra_name = _extra_name(image->filename, _extra_extensions[e]);
+      if(g_hash_table_contains(listing, extra_name)) _folder_cache_add(entry, extra_name, NULL);
+      g_free(extra_name);
+    }
+  }
+  g_hash_table_destroy(listing);
+  return entry;
+}
+
+static gboolean _has_extra(const dt_crawler_folder_cache_t *entry, const char *filename, const char *lower,
+                           const char *upper)
+{
+  gchar *name = _extra_name(filename, lower);
+  gboolean found = g_hash_table_contains(entry->files, name);
+  g_free(name);
+  if(found) return TRUE;
+  name = _extra_name(filename, upper);
+  found = g_hash_table_contains(entry->files, name);
+  g_free(name);
+  return found;
+}
+
+// the current write timestamp of an image, only looked up for the few that seem to have newer sidecars
+static time_t _crawler_write_timestamp(const dt_crawler_image_t *image)
+{
+  time_t timestamp = image->timestamp;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT write_timestamp FROM main.images WHERE id = ?1", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, image->id);
+  if(sqlite3_step(stmt) == SQLITE_ROW) timestamp = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return timestamp;
+}
+
+static void _crawler_folder(dt_crawler_run_t *run, dt_crawler_folder_t *folder,
+                            const dt_crawler_folder_cache_t *cached)
+{
+  dt_crawler_stat_t dir;
+  _crawler_throttle(run);
+  if(!_crawler_stat(folder->path, &dir))
+  {
+    dt_print(DT_DEBUG_CONTROL, "[crawler] folder `%s' is missing.\n", folder->path);
+    return;
+  }
+
+  // a folder whose mtime didn't change still has the same files, we don't have to list it again. that says
+  // nothing about their contents: darktable and others write sidecars in place, so those get a stat() anyway.
+  const dt_crawler_folder_cache_t *entry = cached;
+  gboolean valid = cached && run->use_cache && cached->dir.mtime != 0 && cached->dir.mtime == dir.mtime
+                   && cached->dir.inode == dir.inode;
+  // images imported since then weren't looked for
+  for(guint k = 0; valid && k < folder->images->len; k++)
+  {
+    const char *filename = g_array_index(folder->images, dt_crawler_image_t, k).filename;
+    valid = g_hash_table_contains(cached->files, filename) || g_hash_table_contains(cached->missing, filename);
+  }
+  if(!valid)
+  {
+    folder->seen = _crawler_list_folder(run, folder, &dir);
+    entry = folder->seen;
+  }
+  if(!entry) return;
+
+  for(guint k = 0; k < folder->images->len; k++)
+  {
+    dt_crawler_image_t *image = &g_array_index(folder->images, dt_crawler_image_t, k);
 
     // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
+    if(!g_hash_table_contains(entry->files, image->filename))
     {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing.\n", image_path, id);
+      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s" G_DIR_SEPARATOR_S "%s' (id: %d) is missing.\n", folder->path,
+               image->filename, image->id);
       continue;
     }
 
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+    // step 1: check if the xmp is newer than our db entry
+    char xmp_name[PATH_MAX];
+    if(run->look_for_xmp && _xmp_name(image, xmp_name))
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      struct stat statbuf;
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = g_locale_from_utf8(xmp_path, -1, NULL, NULL, NULL);
-      const int stat_res = stat(xmp_path, &statbuf);
-      g_free(xmp_path_locale);
-      if(stat_res == -1) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
+      const dt_crawler_stat_t *st = (dt_crawler_stat_t *)g_hash_table_lookup(entry->files, xmp_name);
+      dt_crawler_stat_t current;
+      if(st && entry == cached)
+      {
+        gchar *xmp_path = g_build_filename(folder->path, xmp_name, NULL);
+        _crawler_throttle(run);
+        st = _crawler_stat(xmp_path, &current) ? &current : NULL;
+        g_free(xmp_path);
+      }
       // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
+      // the timestamp is from when the crawl started, darktable may have written the sidecar since then
+      if(st && image->timestamp < st->mtime) image->timestamp = _crawler_write_timestamp(image);
+      if(st && image->timestamp < st->mtime)
       {
         dt_control_crawler_result_t *item
             = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_append(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        item->id = image->id;
+        item->timestamp_xmp = st->mtime;
+        item->timestamp_db = image->timestamp;
+        item->image_path = g_build_filename(folder->path, image->filename, NULL);
+        item->xmp_path = g_build_filename(folder->path, xmp_name, NULL);
+
+        folder->results = g_list_append(folder->results, item);
+        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", item->xmp_path, image->id);
       }
-      // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
     }
 
     // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    const char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) c--;
-    len = c - image_path + 1;
+    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
+    // else cases)
+    image->new_flags = image->flags;
+    if(_has_extra(entry, image->filename, "txt", "TXT"))
+      image->new_flags |= DT_IMAGE_HAS_TXT;
+    else
+      image->new_flags &= ~DT_IMAGE_HAS_TXT;
+    if(_has_extra(entry, image->filename, "wav", "WAV"))
+      image->new_flags |= DT_IMAGE_HAS_WAV;
+    else
+      image->new_flags &= ~DT_IMAGE_HAS_WAV;
+  }
+}
 
-    char *extra_path = (char *)calloc(len + 3 + 1, sizeof(char));
-    g_strlcpy(extra_path, image_path, len + 1);
+static gboolean _crawler_show_results(gpointer user_data)
+{
+  dt_control_crawler_show_image_list((GList *)user_data);
+  return FALSE;
+}
 
-    extra_path[len] = 't';
-    extra_path[len + 1] = 'x';
-    extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+static void _crawler_folder_free(gpointer data)
+{
+  dt_crawler_folder_t *folder = (dt_crawler_folder_t *)data;
+  for(guint k = 0; k < folder->images->len; k++)
+    g_free(g_array_index(folder->images, dt_crawler_image_t, k).filename);
+  g_array_free(folder->images, TRUE);
+  _folder_cache_free(folder->seen);
+  g_free(folder->path);
+  g_free(folder);
+}
 
-    if(!has_txt)
+// all images of the given folders (or of all film rolls), grouped by folder
+static GPtrArray *_crawler_collect(const GList *folders)
+{
+  GPtrArray *result = g_ptr_array_new_with_free_func(_crawler_folder_free);
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              folders
+                              ? "SELECT i.id, write_timestamp, version, filename, flags, folder "
+                                "FROM main.images i, main.film_rolls f ON i.film_id = f.id "
+                                "WHERE f.folder = ?1 ORDER BY filename"
+                              : "SELECT i.id, write_timestamp, version, filename, flags, folder "
+                                "FROM main.images i, main.film_rolls f ON i.film_id = f.id "
+                                "ORDER BY f.id, filename",
+                              -1, &stmt, NULL);
+  // clang-format on
+
+  const GList *iter = folders;
+  do
+  {
+    if(iter) DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, (const char *)iter->data, -1, SQLITE_TRANSIENT);
+    dt_crawler_folder_t *folder = NULL;
+    while(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      const char *path = (const char *)sqlite3_column_text(stmt, 5);
+      if(!folder || strcmp(folder->path, path))
+      {
+        folder = g_malloc0(sizeof(dt_crawler_folder_t));
+        folder->path = g_strdup(path);
+        folder->images = g_array_new(FALSE, FALSE, sizeof(dt_crawler_image_t));
+        g_ptr_array_add(result, folder);
+      }
+      dt_crawler_image_t image = { 0 };
+      image.id = sqlite3_column_int(stmt, 0);
+      image.timestamp = sqlite3_column_int(stmt, 1);
+      image.version = sqlite3_column_int(stmt, 2);
+      image.filename = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+      image.flags = image.new_flags = sqlite3_column_int(stmt, 4);
+      g_array_append_val(folder->images, image);
     }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if(iter) iter = g_list_next(iter);
+  } while(iter);
+  sqlite3_finalize(stmt);
+  return result;
+}
 
-    extra_path[len] = 'w';
-    extra_path[len + 1] = 'a';
-    extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+static int32_t _crawler_job_run(dt_job_t *job)
+{
+  dt_crawler_params_t *params = (dt_crawler_params_t *)dt_control_job_get_params(job);
+  const double start = dt_get_wtime();
+
+  GPtrArray *folders = _crawler_collect(params->folders);
+  if(folders->len == 0)
+  {
+    g_ptr_array_free(folders, TRUE);
+    return 0;
+  }
+
+  dt_crawler_run_t run = { 0 };
+  run.job = job;
+  run.look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  run.use_cache = !params->force && dt_conf_get_bool("crawler/trust_folder_mtime");
+  run.start = g_get_real_time() / G_USEC_PER_SEC;
+  const int rate = dt_conf_get_int("crawler/max_files_per_second");
+  run.interval = rate > 0 ? G_USEC_PER_SEC / rate : 0;
+  run.total = folders->len;
+  dt_pthread_mutex_init(&run.lock, NULL);
+
+  g_mutex_lock(&_cache_lock);
+  _cache_load();
+
+  // the file system part doesn't need the database, so we can look at several folders at once. that hides
+  // the latency of network shares.
+  const int count = folders->len;
+  const int threads = CLAMP(dt_conf_get_int("crawler/threads"), 1, 64);
+  GHashTable *cache = _cache;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(cache, count, folders, job) \
+  shared(run) \
+  num_threads(threads) \
+  schedule(dynamic)
+#endif
+  for(int k = 0; k < count; k++)
+  {
+    if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED || !dt_control_running()) continue;
+    dt_crawler_folder_t *folder = (dt_crawler_folder_t *)g_ptr_array_index(folders, k);
+    _crawler_folder(&run, folder, (dt_crawler_folder_cache_t *)g_hash_table_lookup(cache, folder->path));
 
-    if(!has_wav)
+    // hand the findings to the gui as they come in, not only once everything is done
+    if(folder->results)
     {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      g_idle_add(_crawler_show_results, folder->results);
+      folder->results = NULL;
     }
 
-    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
-    // else cases)
-    int new_flags = flags;
-    if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
-    else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
-    if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
-    else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
+    dt_pthread_mutex_lock(&run.lock);
+    run.done++;
+    dt_control_job_set_progress(job, run.done / (double)run.total);
+    dt_pthread_mutex_unlock(&run.lock);
+  }
+
+  // let's wrap this into a transaction, it might make it a little faster. the flags we read are from when the
+  // crawl started, only the txt and wav bits are ours to change, the user might have changed the others since.
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET flags = (flags & ~?3) | ?1 WHERE id = ?2", -1, &stmt, NULL);
+  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  int listed = 0;
+  for(int k = 0; k < count; k++)
+  {
+    dt_crawler_folder_t *folder = (dt_crawler_folder_t *)g_ptr_array_index(folders, k);
+    for(guint i = 0; i < folder->images->len; i++)
+    {
+      const dt_crawler_image_t *image = &g_array_index(folder->images, dt_crawler_image_t, i);
+      if(image->flags == image->new_flags) continue;
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, image->new_flags & (DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV));
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, image->id);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+    }
+    if(folder->seen)
     {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
+      g_hash_table_insert(_cache, g_strdup(folder->path), folder->seen);
+      folder->seen = NULL;
+      listed++;
     }
+  }
+  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  sqlite3_finalize(stmt);
 
-    free(extra_path);
+  if(listed) _cache_save();
+  g_mutex_unlock(&_cache_lock);
+
+  dt_print(DT_DEBUG_CONTROL | DT_DEBUG_PERF, "[crawler] looked at %d folders, listed %d of them, in %.3f secs\n",
+           count, listed, dt_get_wtime() - start);
+
+  dt_pthread_mutex_destroy(&run.lock);
+  g_ptr_array_free(folders, TRUE);
+  return 0;
+}
+
+static void _crawler_params_free(void *data)
+{
+  dt_crawler_params_t *params = (dt_crawler_params_t *)data;
+  g_list_free_full(params->folders, g_free);
+  free(params);
+}
+
+// takes ownership of folders
+static void _crawler_start(GList *folders, const gboolean force)
+{
+  dt_job_t *job = dt_control_job_create(&_crawler_job_run, "crawl xmp files");
+  if(!job)
+  {
+    g_list_free_full(folders, g_free);
+    return;
   }
+  dt_crawler_params_t *params = (dt_crawler_params_t *)calloc(1, sizeof(dt_crawler_params_t));
+  params->folders = folders;
+  params->force = force;
+  dt_control_job_set_params(job, params, _crawler_params_free);
+  dt_control_job_add_progress(job, _("looking for updated xmp files"), TRUE);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, job);
+}
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+static gboolean _crawler_pending_timeout(gpointer user_data)
+{
+  GList *folders = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _pending);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    folders = g_list_prepend(folders, key);
+    g_hash_table_iter_steal(&iter);
+  }
+  _pending_timeout = 0;
+  // files may be modified in place, the folder mtime can't be trusted here
+  _crawler_start(folders, TRUE);
+  return FALSE;
+}
+
+void dt_control_crawler_sidecar_written(const char *filename)
+{
+  g_mutex_lock(&_written_lock);
+  if(_written)
+  {
+    gint64 *when = g_malloc(sizeof(gint64));
+    *when = g_get_monotonic_time();
+    g_hash_table_insert(_written, g_strdup(filename), when);
+  }
+  g_mutex_unlock(&_written_lock);
+}
+
+// whether darktable wrote the file itself just now. forgets about older writes on the way.
+static gboolean _crawler_own_write(GFile *file)
+{
+  gchar *path = g_file_get_path(file);
+  const gint64 now = g_get_monotonic_time();
+  gboolean own = FALSE;
+  g_mutex_lock(&_written_lock);
+  if(_written)
+  {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, _written);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+    {
+      if(now - *(gint64 *)value > DT_CRAWLER_OWN_WRITE_USECS)
+        g_hash_table_iter_remove(&iter);
+      else if(path && !strcmp((const char *)key, path))
+        own = TRUE;
+    }
+  }
+  g_mutex_unlock(&_written_lock);
+  g_free(path);
+  return own;
+}
 
+static void _crawler_monitor_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                     GFileMonitorEvent event_type, gpointer user_data)
+{
+  if(event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED || event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT
+     || event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+    return;
+
+  // only sidecars and associated text and audio files are of interest. renames arrive as deleted and created.
+  gchar *name = g_file_get_basename(file);
+  const char *dot = name ? strrchr(name, '.') : NULL;
+  const gboolean interesting = dot && (!g_ascii_strcasecmp(dot, ".xmp") || !g_ascii_strcasecmp(dot, ".txt")
+                                       || !g_ascii_strcasecmp(dot, ".wav"));
+  g_free(name);
+  if(!interesting || _crawler_own_write(file)) return;
+
+  // wait for things to settle down before crawling the folder
+  g_hash_table_add(_pending, g_strdup((const char *)user_data));
+  if(!_pending_timeout) _pending_timeout = g_timeout_add_seconds(2, _crawler_pending_timeout, NULL);
+}
+
+// watch the folders of all film rolls, and only those
+static void _crawler_update_monitors(gpointer instance, gpointer user_data)
+{
+  if(!dt_conf_get_bool("crawler/monitor_folders")) return;
+
+  GHashTable *monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT folder FROM main.film_rolls", -1, &stmt,
+                              NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *folder = (const char *)sqlite3_column_text(stmt, 0);
+    if(!folder || g_hash_table_contains(monitors, folder)) continue;
+
+    gpointer key, monitor;
+    if(g_hash_table_lookup_extended(_monitors, folder, &key, &monitor))
+    {
+      g_hash_table_steal(_monitors, folder);
+      g_hash_table_insert(monitors, key, monitor);
+      continue;
+    }
+
+    GFile *file = g_file_new_for_path(folder);
+    monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    g_object_unref(file);
+    if(!monitor) continue;
+    key = g_strdup(folder);
+    g_signal_connect(monitor, "changed", G_CALLBACK(_crawler_monitor_changed), key);
+    g_hash_table_insert(monitors, key, monitor);
+  }
   sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
 
-  return result;
+  // whatever is left belongs to film rolls that are gone
+  g_hash_table_destroy(_monitors);
+  _monitors = monitors;
+}
+
+void dt_control_crawler_init(const gboolean crawl)
+{
+  _monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  _pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  if(crawl) _crawler_start(NULL, FALSE);
+
+  if(dt_conf_get_bool("crawler/monitor_folders"))
+  {
+    g_mutex_lock(&_written_lock);
+    _written = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    g_mutex_unlock(&_written_lock);
+    _crawler_update_monitors(NULL, NULL);
+    dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED,
+                              G_CALLBACK(_crawler_update_monitors), NULL);
+  }
+}
+
+void dt_control_crawler_cleanup()
+{
+  if(!_monitors) return;
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_crawler_update_monitors), NULL);
+  if(_pending_timeout) g_source_remove(_pending_timeout);
+  _pending_timeout = 0;
+  g_hash_table_destroy(_monitors);
+  g_hash_table_destroy(_pending);
+  _monitors = _pending = NULL;
+
+  g_mutex_lock(&_written_lock);
+  if(_written) g_hash_table_destroy(_written);
+  _written = NULL;
+  g_mutex_unlock(&_written_lock);
+
+  g_mutex_lock(&_cache_lock);
+  if(_cache) g_hash_table_destroy(_cache);
+  _cache = NULL;
+  g_mutex_unlock(&_cache_lock);
 }
 
 
@@ -203,15 +791,41 @@ typedef struct dt_control_crawler_gui_t
   gulong select_all_handler_id;
 } dt_control_crawler_gui_t;
 
+// the open dialog, results coming in later get added to it
+static dt_control_crawler_gui_t *_crawler_gui = NULL;
+
 // close the window and clean up
 static void dt_control_crawler_response_callback(GtkWidget *dialog, gint response_id, gpointer user_data)
 {
   dt_control_crawler_gui_t *gui = (dt_control_crawler_gui_t *)user_data;
+  if(_crawler_gui == gui) _crawler_gui = NULL;
   g_object_unref(G_OBJECT(gui->model));
   gtk_widget_destroy(dialog);
   free(gui);
 }
 
+static void _append_images(GtkListStore *store, GList *images)
+{
+  GList *list_iter = g_list_first(images);
+  while(list_iter)
+  {
+    GtkTreeIter iter;
+    dt_control_crawler_result_t *item = list_iter->data;
+    char timestamp_db[64], timestamp_xmp[64];
+    strftime(timestamp_db, sizeof(timestamp_db), "%c", localtime(&item->timestamp_db));
+    strftime(timestamp_xmp, sizeof(timestamp_xmp), "%c", localtime(&item->timestamp_xmp));
+    gtk_list_store_append(store, &iter);
+    gtk_list_store_set(store, &iter, DT_CONTROL_CRAWLER_COL_SELECTED, 0, DT_CONTROL_CRAWLER_COL_ID, item->id,
+                       DT_CONTROL_CRAWLER_COL_IMAGE_PATH, item->image_path, DT_CONTROL_CRAWLER_COL_XMP_PATH,
+                       item->xmp_path, DT_CONTROL_CRAWLER_COL_TS_XMP, timestamp_xmp,
+                       DT_CONTROL_CRAWLER_COL_TS_DB, timestamp_db, -1);
+    g_free(item->image_path);
+    g_free(item->xmp_path);
+    list_iter = g_list_next(list_iter);
+  }
+  g_list_free_full(images, free);
+}
+
 // unselect the "select all" toggle
 static void _clear_select_all(dt_control_crawler_gui_t *gui)
 {
@@ -310,6 +924,13 @@ void dt_control_crawler_show_image_list(GList *images)
 {
   if(!images) return;
 
+  // the crawler reports as it goes, add to the list that is already shown
+  if(_crawler_gui)
+  {
+    _append_images(GTK_LIST_STORE(_crawler_gui->model), images);
+    return;
+  }
+
   dt_control_crawler_gui_t *gui = (dt_control_crawler_gui_t *)malloc(sizeof(dt_control_crawler_gui_t));
 
   // a list with all the images
@@ -326,25 +947,7 @@ void dt_control_crawler_show_image_list(GList *images)
                                            );
 
   gui->model = GTK_TREE_MODEL(store);
-
-  GList *list_iter = g_list_first(images);
-  while(list_iter)
-  {
-    GtkTreeIter iter;
-    dt_control_crawler_result_t *item = list_iter->data;
-    char timestamp_db[64], timestamp_xmp[64];
-    strftime(timestamp_db, sizeof(timestamp_db), "%c", localtime(&item->timestamp_db));
-    strftime(timestamp_xmp, sizeof(timestamp_xmp), "%c", localtime(&item->timestamp_xmp));
-    gtk_list_store_append(store, &iter);
-    gtk_list_store_set(store, &iter, DT_CONTROL_CRAWLER_COL_SELECTED, 0, DT_CONTROL_CRAWLER_COL_ID, item->id,
-                       DT_CONTROL_CRAWLER_COL_IMAGE_PATH, item->image_path, DT_CONTROL_CRAWLER_COL_XMP_PATH,
-                       item->xmp_path, DT_CONTROL_CRAWLER_COL_TS_XMP, timestamp_xmp,
-                       DT_CONTROL_CRAWLER_COL_TS_DB, timestamp_db, -1);
-    g_free(item->image_path);
-    g_free(item->xmp_path);
-    list_iter = g_list_next(list_iter);
-  }
-  g_list_free_full(images, g_free);
+  _append_images(store, images);
 
   GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
 
@@ -372,7 +975,7 @@ void dt_control_crawler_show_image_list(GList *images)
   // build a dialog window that contains the list of images
   GtkWidget *win = dt_ui_main_window(darktable.gui->ui);
   GtkWidget *dialog = gtk_dialog_new_with_buttons(_("updated xmp sidecar files found"), GTK_WINDOW(win),
-                                                  GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                                                  GTK_DIALOG_DESTROY_WITH_PARENT,
                                                   _("_close"), GTK_RESPONSE_CLOSE, NULL);
 #ifdef GDK_WINDOWING_QUARTZ
   dt_osx_disallow_fullscreen(dialog);
@@ -405,6 +1008,7 @@ void dt_control_crawler_show_image_list(GList *images)
   gtk_widget_show_all(dialog);
 
   g_signal_connect(dialog, "response", G_CALLBACK(dt_control_crawler_response_callback), gui);
+  _crawler_gui = gui;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
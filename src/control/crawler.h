@@ -20,18 +20,19 @@
 
 #include <glib.h>
 
-/** this isn't a background job on purpose. it has to be really fast so it shouldn't
- *  require locking from image cache or anything like that.
- *  should we find out that we want to have a background job that crawls over all images
- *  we can maybe refactor this, but for now it's good the way it is.
- */
-
-// this function iterates over ALL images from the database and checks whether
+// looks at ALL images from the database in a background job and checks whether
 // - the XMP file on disk is newer than the timestamp from db
 // - there is a .txt or .wav file associated with the image and mark so in the db
 //   or if such a file no longer exists
-// it returns the list of images with a (supposedly) updated xmp file to let the user decide
-GList *dt_control_crawler_run();
+// images with a (supposedly) updated xmp file are shown to the user as they are found to let them decide.
+// folders are looked at in parallel and only listed again when their mtime changed since the last crawl, what
+// was seen is kept in a stat cache in the cache directory. xmp files are always checked, they are written in
+// place. with crawler/monitor_folders the film roll folders are watched and crawled again when sidecars in
+// them change, except for the ones darktable writes itself.
+void dt_control_crawler_init(const gboolean crawl);
+void dt_control_crawler_cleanup();
+// tells the folder monitors that darktable is about to write this sidecar itself
+void dt_control_crawler_sidecar_written(const char *filename);
 
 // show a popup with the images, let the user decide what to do and free the list afterwards
 void dt_control_crawler_show_image_list(GList *images);
@@ -19,8 +19,20 @@
 #include "control/jobs.h"
 #include "control/control.h"
 
-#define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
+// virtual time a queue advances by when it gets picked is DT_CONTROL_STRIDE / weight
+#define DT_CONTROL_STRIDE 1024
+
+// share of the workers each queue gets when all of them have jobs waiting. this replaces
+// aging of the queue heads: a queue that didn't get picked falls behind in virtual time
+// and will win once the others have advanced far enough.
+static const uint32_t _queue_weight[DT_JOB_QUEUE_MAX] = {
+  16, // DT_JOB_QUEUE_USER_FG
+  8,  // DT_JOB_QUEUE_SYSTEM_FG
+  2,  // DT_JOB_QUEUE_USER_BG
+  2,  // DT_JOB_QUEUE_USER_EXPORT
+  1,  // DT_JOB_QUEUE_SYSTEM_BG
+};
 
 /* the queue can have scheduled jobs but all
     the workers are sleeping, so this kicks the workers
@@ -44,30 +56,127 @@ typedef struct _dt_job_t
   dt_pthread_mutex_t wait_mutex;
 
   dt_job_state_t state;
-  unsigned char priority;
   dt_job_queue_t queue;
 
   dt_job_state_change_callback state_changed_cb;
 
   dt_progress_t *progress;
 
+  // for the statistics: the unformatted description identifies the kind of job
+  const char *type;
+  double added_time;
+
   char description[DT_CONTROL_DESCRIPTION_LEN];
 } _dt_job_t;
 
+/* job statistics. timings go to histograms with power of two buckets in microseconds,
+ * bucket k holding [2^k, 2^(k+1)) us, the last one everything longer. */
+
+typedef struct dt_job_type_stats_t
+{
+  uint64_t run;
+  dt_job_timing_stats_t wait, run_time;
+} dt_job_type_stats_t;
+
+typedef struct dt_job_stats_t
+{
+  dt_pthread_mutex_t mutex;
+  double start_time;
+  double busy_time; // summed over all workers
+  dt_job_queue_stats_t queue[DT_JOB_QUEUE_MAX];
+  GHashTable *types; // type string -> dt_job_type_stats_t
+} dt_job_stats_t;
+
+static const char *_queue_name[DT_JOB_QUEUE_MAX] = { "user_fg", "system_fg", "user_bg", "user_export", "system_bg" };
+
+static void _stats_add_timing(dt_job_timing_stats_t *t, const double seconds)
+{
+  const double us = MAX(seconds * 1e6, 0.0);
+  int bucket = 0;
+  while(bucket < DT_JOB_STATS_BUCKETS - 1 && us >= (double)(2u << bucket)) bucket++;
+  t->histogram[bucket]++;
+  t->total += seconds;
+  t->max = MAX(t->max, seconds);
+}
+
+static void _stats_count(dt_control_t *control, const dt_job_queue_t queue, const size_t offset)
+{
+  dt_job_stats_t *stats = control->job_stats;
+  if(!stats || (unsigned int)queue >= DT_JOB_QUEUE_MAX) return;
+  dt_pthread_mutex_lock(&stats->mutex);
+  (*(uint64_t *)((char *)&stats->queue[queue] + offset))++;
+  dt_pthread_mutex_unlock(&stats->mutex);
+}
+
+#define dt_control_job_stats_count(control, queue, field)                                                    \
+  _stats_count(control, queue, offsetof(dt_job_queue_stats_t, field))
+
+static void _stats_job_done(dt_control_t *control, const _dt_job_t *job, const double start, const double end)
+{
+  dt_job_stats_t *stats = control->job_stats;
+  if(!stats) return;
+  const double wait = start - job->added_time;
+  const double run = end - start;
+
+  dt_pthread_mutex_lock(&stats->mutex);
+  stats->busy_time += run;
+  if((unsigned int)job->queue < DT_JOB_QUEUE_MAX)
+  {
+    dt_job_queue_stats_t *q = &stats->queue[job->queue];
+    q->run++;
+    _stats_add_timing(&q->wait, wait);
+    _stats_add_timing(&q->run_time, run);
+  }
+  const char *type = job->type ? job->type : job->description;
+  dt_job_type_stats_t *t = g_hash_table_lookup(stats->types, type);
+  if(!t)
+  {
+    t = (dt_job_type_stats_t *)calloc(1, sizeof(dt_job_type_stats_t));
+    g_hash_table_insert(stats->types, g_strdup(type), t);
+  }
+  t->run++;
+  _stats_add_timing(&t->wait, wait);
+  _stats_add_timing(&t->run_time, run);
+  dt_pthread_mutex_unlock(&stats->mutex);
+}
+
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
    match
     we don't want to compare result, priority or state since these will change during the course of
    processing.
     NOTE: maybe allow to pass a comparator for params.
  */
+// jobs with params are the same if their params are, all others if their descriptions are
 static inline int dt_control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
 {
   if(!j1 || !j2) return 0;
-  if(j1->params_size != 0 && j1->params_size == j2->params_size)
-    return (j1->execute == j2->execute && j1->state_changed_cb == j2->state_changed_cb
-            && j1->queue == j2->queue && (memcmp(j1->params, j2->params, j1->params_size) == 0));
-  return (j1->execute == j2->execute && j1->state_changed_cb == j2->state_changed_cb && j1->queue == j2->queue
-          && (g_strcmp0(j1->description, j2->description) == 0));
+  if(j1->execute != j2->execute || j1->state_changed_cb != j2->state_changed_cb || j1->queue != j2->queue
+     || j1->params_size != j2->params_size)
+    return 0;
+  if(j1->params_size != 0) return memcmp(j1->params, j2->params, j1->params_size) == 0;
+  return g_strcmp0(j1->description, j2->description) == 0;
+}
+
+/** hash over exactly the fields dt_control_job_equal() compares, used to dedup system foreground jobs */
+static guint dt_control_job_hash(gconstpointer key)
+{
+  const _dt_job_t *job = (const _dt_job_t *)key;
+  guint hash = g_direct_hash(job->execute) ^ g_direct_hash(job->state_changed_cb) ^ job->queue
+               ^ (guint)job->params_size;
+  if(job->params_size != 0)
+  {
+    // fnv-1a over the params
+    const uint8_t *p = (const uint8_t *)job->params;
+    for(size_t k = 0; k < job->params_size; k++) hash = (hash ^ p[k]) * 16777619u;
+  }
+  else
+    hash ^= g_str_hash(job->description);
+  return hash;
+}
+
+static gboolean dt_control_job_equal_func(gconstpointer a, gconstpointer b)
+{
+  return dt_control_job_equal((_dt_job_t *)a, (_dt_job_t *)b);
 }
 
 static void dt_control_job_set_state(_dt_job_t *job, dt_job_state_t state)
@@ -129,6 +238,9 @@ dt_job_t *dt_control_job_create(dt_job_execute_callback execute, const char *msg
 
   job->execute = execute;
   job->state = DT_JOB_STATE_INITIALIZED;
+  job->queue = DT_JOB_QUEUE_MAX; // not queued (yet), e.g. executed synchronously
+  job->type = msg;
+  job->added_time = dt_get_wtime();
 
   dt_pthread_mutex_init(&job->state_mutex, NULL);
   dt_pthread_mutex_init(&job->wait_mutex, NULL);
@@ -159,7 +271,7 @@ void dt_control_job_set_state_callback(_dt_job_t *job, dt_job_state_change_callb
 static void dt_control_job_print(_dt_job_t *job)
 {
   if(!job) return;
-  dt_print(DT_DEBUG_CONTROL, "%s | queue: %d | priority: %d", job->description, job->queue, job->priority);
+  dt_print(DT_DEBUG_CONTROL, "%s | queue: %d", job->description, job->queue);
 }
 
 void dt_control_job_cancel(_dt_job_t *job)
@@ -212,10 +324,13 @@ static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
     dt_control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
     /* execute job */
+    const double start = dt_get_wtime();
     job->result = job->execute(job);
+    const double end = dt_get_wtime();
 
     dt_control_job_set_state(job, DT_JOB_STATE_FINISHED);
-    dt_print(DT_DEBUG_CONTROL, "[run_job-] %02d %f ", res, dt_get_wtime());
+    _stats_job_done(control, job, start, end);
+    dt_print(DT_DEBUG_CONTROL, "[run_job-] %02d %f ", res, end);
     dt_control_job_print(job);
     dt_print(DT_DEBUG_CONTROL, "\n");
   }
@@ -228,63 +343,65 @@ static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
 {
   /*
    * job scheduling works like this:
-   * - when there is a single job in the queue head with a maximal priority -> pick it
-   * - otherwise pick among the ones with the maximal priority in the following order:
+   * - every queue has a virtual time, advanced by DT_CONTROL_STRIDE / weight whenever a job is taken from it
+   * - among the queues having jobs, pick the one which is furthest behind. on ties the order of the queues wins:
    *   * user foreground
    *   * system foreground
    *   * user background
+   *   * user export (only one of these is running at a time)
    *   * system background
-   * - the jobs that didn't get picked this round get their priority incremented
+   * - the queues are only peeked at without locking, only the winner gets locked to take its head.
+   *   if somebody else was faster we just try again.
    */
 
-  dt_pthread_mutex_lock(&control->queue_mutex);
-
-  // find the job
-  _dt_job_t *job = NULL;
-  int winner_queue = DT_JOB_QUEUE_MAX;
-  int max_priority = -1;
-  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  while(TRUE)
   {
-    if(control->queues[i] == NULL) continue;
-    if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
-    if(_job->priority > max_priority)
+    int winner_queue = DT_JOB_QUEUE_MAX;
+    uint64_t min_pass = UINT64_MAX;
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
     {
-      max_priority = _job->priority;
-      job = _job;
-      winner_queue = i;
+      if(g_atomic_int_get(&control->queue_length[i]) <= 0) continue;
+      if(i == DT_JOB_QUEUE_USER_EXPORT && g_atomic_int_get(&control->export_scheduled)) continue;
+      const uint64_t pass = __sync_fetch_and_add(&control->queue_pass[i], 0);
+      if(pass < min_pass)
+      {
+        min_pass = pass;
+        winner_queue = i;
+      }
     }
-  }
 
-  if(!job)
-  {
-    dt_pthread_mutex_unlock(&control->queue_mutex);
-    return NULL;
-  }
+    if(winner_queue == DT_JOB_QUEUE_MAX) return NULL;
 
-  // the order of the queues in control->queues matches our priority, and we only update job when the priority
-  // is strictly bigger
-  // invariant -> job is the one we are looking for
+    // only one export may run at any time
+    if(winner_queue == DT_JOB_QUEUE_USER_EXPORT
+       && !g_atomic_int_compare_and_exchange(&control->export_scheduled, FALSE, TRUE))
+      continue;
 
-  // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
-  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
+    dt_pthread_mutex_lock(&control->queue_mutex[winner_queue]);
+    _dt_job_t *job = (_dt_job_t *)g_queue_pop_head(&control->queues[winner_queue]);
+    if(job)
+    {
+      g_atomic_int_add(&control->queue_length[winner_queue], -1);
+      __sync_fetch_and_add(&control->queue_pass[winner_queue], DT_CONTROL_STRIDE / _queue_weight[winner_queue]);
+      // everyone entering the race later starts from here, not from where they left off
+      uint64_t vtime = __sync_fetch_and_add(&control->queue_vtime, 0);
+      while(vtime < min_pass && !__sync_bool_compare_and_swap(&control->queue_vtime, vtime, min_pass))
+        vtime = __sync_fetch_and_add(&control->queue_vtime, 0);
+
+      if(winner_queue == DT_JOB_QUEUE_SYSTEM_FG)
+      {
+        // move it from the queued to the scheduled set (for job deduping)
+        g_hash_table_remove(control->queued_fg, job);
+        g_hash_table_add(control->running_fg, job);
+      }
+    }
+    dt_pthread_mutex_unlock(&control->queue_mutex[winner_queue]);
 
-  // and place it in scheduled job array (for job deduping)
-  control->job[dt_control_get_threadid()] = job;
+    if(job) return job;
 
-  // increment the priorities of the others
-  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
-  {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    // somebody else took the last job of this queue
+    if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) g_atomic_int_set(&control->export_scheduled, FALSE);
   }
-
-  dt_pthread_mutex_unlock(&control->queue_mutex);
-
-  return job;
 }
 
 static void dt_control_job_execute(_dt_job_t *job)
@@ -297,12 +414,15 @@ static void dt_control_job_execute(_dt_job_t *job)
   dt_control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
   /* execute job */
+  const double start = dt_get_wtime();
   job->result = job->execute(job);
+  const double end = dt_get_wtime();
 
   dt_control_job_set_state(job, DT_JOB_STATE_FINISHED);
+  _stats_job_done(darktable.control, job, start, end);
 
   dt_print(DT_DEBUG_CONTROL, "[run_job-] %02d %f ", DT_CTL_WORKER_RESERVED + dt_control_get_threadid(),
-           dt_get_wtime());
+           end);
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 }
@@ -320,11 +440,15 @@ static int32_t dt_control_run_job(dt_control_t *control)
 
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
-  // remove the job from scheduled job array (for job deduping)
-  dt_pthread_mutex_lock(&control->queue_mutex);
-  control->job[dt_control_get_threadid()] = NULL;
-  if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  // remove the job from the scheduled set (for job deduping)
+  if(job->queue == DT_JOB_QUEUE_SYSTEM_FG)
+  {
+    dt_pthread_mutex_lock(&control->queue_mutex[DT_JOB_QUEUE_SYSTEM_FG]);
+    g_hash_table_remove(control->running_fg, job);
+    dt_pthread_mutex_unlock(&control->queue_mutex[DT_JOB_QUEUE_SYSTEM_FG]);
+  }
+  else if(job->queue == DT_JOB_QUEUE_USER_EXPORT)
+    g_atomic_int_set(&control->export_scheduled, FALSE);
 
   // and free it
   dt_control_job_dispose(job);
@@ -375,6 +499,10 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
     return 1;
   }
 
+  job->queue = queue_id;
+  job->added_time = dt_get_wtime();
+  dt_control_job_stats_count(control, queue_id, added);
+
   if(!control->running)
   {
     // whatever we are adding here won't be scheduled as the system isn't running. execute it synchronous instead.
@@ -386,93 +514,87 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
     return 0;
   }
 
-  job->queue = queue_id;
-
   _dt_job_t *job_for_disposal = NULL;
 
-  dt_pthread_mutex_lock(&control->queue_mutex);
+  dt_pthread_mutex_lock(&control->queue_mutex[queue_id]);
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
+  GQueue *queue = &control->queues[queue_id];
 
-  dt_print(DT_DEBUG_CONTROL, "[add_job] %zu | ", length);
+  dt_print(DT_DEBUG_CONTROL, "[add_job] %u | ", g_queue_get_length(queue));
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 
+  // a queue that was idle joins the race at the current virtual time, so it
+  // doesn't get a burst of picks for the time it had nothing to do
+  if(g_queue_is_empty(queue))
+  {
+    const uint64_t vtime = __sync_fetch_and_add(&control->queue_vtime, 0);
+    if(control->queue_pass[queue_id] < vtime) control->queue_pass[queue_id] = vtime;
+  }
+
   if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
   {
     // this is a stack with limited size and bubble up and all that stuff
-    job->priority = DT_CONTROL_FG_PRIORITY;
 
     // check if we have already scheduled the job
-    for(int k = 0; k < control->num_threads; k++)
+    _dt_job_t *other_job = (_dt_job_t *)g_hash_table_lookup(control->running_fg, job);
+    if(other_job)
     {
-      _dt_job_t *other_job = (_dt_job_t *)control->job[k];
-      if(dt_control_job_equal(job, other_job))
-      {
-        dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in scheduled: ");
-        dt_control_job_print(other_job);
-        dt_print(DT_DEBUG_CONTROL, "\n");
+      dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in scheduled: ");
+      dt_control_job_print(other_job);
+      dt_print(DT_DEBUG_CONTROL, "\n");
 
-        dt_pthread_mutex_unlock(&control->queue_mutex);
+      dt_pthread_mutex_unlock(&control->queue_mutex[queue_id]);
 
-        dt_control_job_set_state(job, DT_JOB_STATE_DISCARDED);
-        dt_control_job_dispose(job);
+      dt_control_job_stats_count(control, queue_id, deduped);
+      dt_control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(job);
 
-        return 0; // there can't be any further copy
-      }
+      return 0; // there can't be any further copy
     }
 
     // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
+    GList *link = NULL;
+    if(g_hash_table_lookup_extended(control->queued_fg, job, (gpointer *)&other_job, (gpointer *)&link))
     {
-      _dt_job_t *other_job = (_dt_job_t *)iter->data;
-      if(dt_control_job_equal(job, other_job))
-      {
-        dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
-        dt_control_job_print(other_job);
-        dt_print(DT_DEBUG_CONTROL, "\n");
+      dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
+      dt_control_job_print(other_job);
+      dt_print(DT_DEBUG_CONTROL, "\n");
 
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
+      g_queue_unlink(queue, link);
+      g_queue_push_head_link(queue, link);
 
-        job_for_disposal = job;
-
-        job = other_job;
-        break; // there can't be any further copy in the list
-      }
+      dt_control_job_stats_count(control, queue_id, deduped);
+      job_for_disposal = job;
+      job = other_job;
     }
-
-    // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
-
-    // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
+    else
     {
-      GList *last = g_list_last(*queue);
-      dt_control_job_set_state((_dt_job_t *)last->data, DT_JOB_STATE_DISCARDED);
-      dt_control_job_dispose((_dt_job_t *)last->data);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
-    }
+      // now we can add the new job to the list
+      g_queue_push_head(queue, job);
+      g_hash_table_insert(control->queued_fg, job, queue->head);
+      g_atomic_int_inc(&control->queue_length[queue_id]);
 
-    control->queue_length[queue_id] = length;
+      // and take care of the maximal queue size
+      if(g_queue_get_length(queue) > DT_CONTROL_MAX_JOBS)
+      {
+        _dt_job_t *last = (_dt_job_t *)g_queue_pop_tail(queue);
+        g_hash_table_remove(control->queued_fg, last);
+        g_atomic_int_add(&control->queue_length[queue_id], -1);
+        dt_control_job_stats_count(control, queue_id, discarded);
+        dt_control_job_set_state(last, DT_JOB_STATE_DISCARDED);
+        dt_control_job_dispose(last);
+      }
+    }
   }
   else
   {
     // the rest are FIFOs
-    if(queue_id == DT_JOB_QUEUE_USER_BG ||
-       queue_id == DT_JOB_QUEUE_USER_EXPORT ||
-       queue_id == DT_JOB_QUEUE_SYSTEM_BG)
-      job->priority = 0;
-    else
-      job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
+    g_queue_push_tail(queue, job);
+    g_atomic_int_inc(&control->queue_length[queue_id]);
   }
   dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  dt_pthread_mutex_unlock(&control->queue_mutex[queue_id]);
 
   // notify workers
   dt_pthread_mutex_lock(&control->cond_mutex);
@@ -604,10 +726,21 @@ double dt_control_job_get_progress(dt_job_t *job)
 // moved out of control.c to be able to make some helper functions static
 void dt_control_jobs_init(dt_control_t *control)
 {
-  // start threads
-  control->num_threads = CLAMP(dt_conf_get_int("worker_threads"), 1, 8);
+  for(int k = 0; k < DT_JOB_QUEUE_MAX; k++)
+  {
+    dt_pthread_mutex_init(&control->queue_mutex[k], NULL);
+    g_queue_init(&control->queues[k]);
+    control->queue_length[k] = 0;
+    control->queue_pass[k] = 0;
+  }
+  control->queue_vtime = 0;
+  control->export_scheduled = FALSE;
+  control->queued_fg = g_hash_table_new(dt_control_job_hash, dt_control_job_equal_func);
+  control->running_fg = g_hash_table_new(dt_control_job_hash, dt_control_job_equal_func);
+
+  // start threads, as many as the machine has cores at most
+  control->num_threads = CLAMP(dt_conf_get_int("worker_threads"), 1, MAX(dt_get_num_threads(), 1));
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
-  control->job = (dt_job_t **)calloc(control->num_threads, sizeof(dt_job_t *));
   dt_pthread_mutex_lock(&control->run_mutex);
   control->running = 1;
   dt_pthread_mutex_unlock(&control->run_mutex);
@@ -637,8 +770,122 @@ void dt_control_jobs_init(dt_control_t *control)
 
 void dt_control_jobs_cleanup(dt_control_t *control)
 {
-  free(control->job);
   free(control->thread);
+  g_hash_table_destroy(control->queued_fg);
+  g_hash_table_destroy(control->running_fg);
+  for(int k = 0; k < DT_JOB_QUEUE_MAX; k++)
+  {
+    g_queue_clear(&control->queues[k]);
+    dt_pthread_mutex_destroy(&control->queue_mutex[k]);
+  }
+}
+
+void dt_control_jobs_stats_init(dt_control_t *control)
+{
+  dt_job_stats_t *stats = (dt_job_stats_t *)calloc(1, sizeof(dt_job_stats_t));
+  dt_pthread_mutex_init(&stats->mutex, NULL);
+  stats->start_time = dt_get_wtime();
+  stats->types = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free);
+  control->job_stats = stats;
+}
+
+void dt_control_jobs_stats_cleanup(dt_control_t *control)
+{
+  dt_job_stats_t *stats = control->job_stats;
+  if(!stats) return;
+  control->job_stats = NULL;
+  g_hash_table_destroy(stats->types);
+  dt_pthread_mutex_destroy(&stats->mutex);
+  free(stats);
+}
+
+void dt_control_jobs_get_stats(dt_control_t *control, const dt_job_queue_t queue, dt_job_queue_stats_t *out)
+{
+  memset(out, 0, sizeof(dt_job_queue_stats_t));
+  dt_job_stats_t *stats = control->job_stats;
+  if(!stats || (unsigned int)queue >= DT_JOB_QUEUE_MAX) return;
+  dt_pthread_mutex_lock(&stats->mutex);
+  *out = stats->queue[queue];
+  dt_pthread_mutex_unlock(&stats->mutex);
+  out->length = g_atomic_int_get(&control->queue_length[queue]);
+}
+
+static void _json_append_string(GString *json, const char *str)
+{
+  g_string_append_c(json, '"');
+  for(const char *c = str; *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+      g_string_append_printf(json, "\\%c", *c);
+    else if((unsigned char)*c < 0x20)
+      g_string_append_c(json, ' ');
+    else
+      g_string_append_c(json, *c);
+  }
+  g_string_append_c(json, '"');
+}
+
+static void _json_append_timing(GString *json, const char *name, const dt_job_timing_stats_t *t,
+                                const uint64_t count)
+{
+  g_string_append_printf(json, "\"%s\": { \"total\": %.6f, \"mean\": %.6f, \"max\": %.6f, \"histogram_us_log2\": [",
+                         name, t->total, count ? t->total / count : 0.0, t->max);
+  for(int k = 0; k < DT_JOB_STATS_BUCKETS; k++)
+    g_string_append_printf(json, "%s%" PRIu64, k ? ", " : "", t->histogram[k]);
+  g_string_append(json, "] }");
+}
+
+gchar *dt_control_jobs_stats_json(dt_control_t *control)
+{
+  dt_job_stats_t *stats = control->job_stats;
+  if(!stats) return g_strdup("{}");
+
+  GString *json = g_string_new("{\n");
+  dt_pthread_mutex_lock(&stats->mutex);
+
+  const double uptime = dt_get_wtime() - stats->start_time;
+  // busy_time is summed over the generic and the reserved workers. without them running, jobs are executed
+  // synchronously by the one thread adding them.
+  const int workers = control->running ? control->num_threads + DT_CTL_WORKER_RESERVED : 1;
+  g_string_append_printf(json, "  \"uptime\": %.3f,\n  \"workers\": %d,\n  \"utilization\": %.4f,\n", uptime,
+                         workers, uptime > 0.0 ? stats->busy_time / (uptime * workers) : 0.0);
+
+  g_string_append(json, "  \"queues\": [\n");
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    const dt_job_queue_stats_t *q = &stats->queue[i];
+    g_string_append_printf(json,
+                           "    { \"name\": \"%s\", \"length\": %d, \"added\": %" PRIu64 ", \"run\": %" PRIu64
+                           ", \"discarded\": %" PRIu64 ", \"deduped\": %" PRIu64 ", ",
+                           _queue_name[i], g_atomic_int_get(&control->queue_length[i]), q->added, q->run,
+                           q->discarded, q->deduped);
+    _json_append_timing(json, "wait", &q->wait, q->run);
+    g_string_append(json, ", ");
+    _json_append_timing(json, "run_time", &q->run_time, q->run);
+    g_string_append_printf(json, " }%s\n", i < DT_JOB_QUEUE_MAX - 1 ? "," : "");
+  }
+  g_string_append(json, "  ],\n  \"job_types\": [\n");
+
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean first = TRUE;
+  g_hash_table_iter_init(&iter, stats->types);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_job_type_stats_t *t = (dt_job_type_stats_t *)value;
+    g_string_append(json, first ? "    { \"name\": " : ",\n    { \"name\": ");
+    _json_append_string(json, (const char *)key);
+    g_string_append_printf(json, ", \"run\": %" PRIu64 ", ", t->run);
+    _json_append_timing(json, "wait", &t->wait, t->run);
+    g_string_append(json, ", ");
+    _json_append_timing(json, "run_time", &t->run_time, t->run);
+    g_string_append(json, " }");
+    first = FALSE;
+  }
+  g_string_append(json, first ? "  ]\n}\n" : "\n  ]\n}\n");
+
+  dt_pthread_mutex_unlock(&stats->mutex);
+  return g_string_free(json, FALSE);
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -52,6 +52,23 @@ typedef enum dt_job_queue_t
 
 typedef struct _dt_job_t dt_job_t;
 
+// number of power of two buckets (in microseconds) of the job timing histograms
+#define DT_JOB_STATS_BUCKETS 28
+
+typedef struct dt_job_timing_stats_t
+{
+  double total, max; // seconds
+  uint64_t histogram[DT_JOB_STATS_BUCKETS];
+} dt_job_timing_stats_t;
+
+typedef struct dt_job_queue_stats_t
+{
+  int32_t length;
+  uint64_t added, run, discarded, deduped;
+  dt_job_timing_stats_t wait;     // from adding the job to the queue until it starts running
+  dt_job_timing_stats_t run_time; // execution of the job
+} dt_job_queue_stats_t;
+
 typedef int32_t (*dt_job_execute_callback)(dt_job_t *);
 typedef void (*dt_job_state_change_callback)(dt_job_t *, dt_job_state_t state);
 typedef void (*dt_job_destroy_callback)(void *data);
@@ -90,6 +107,15 @@ int32_t dt_control_add_job_res(struct dt_control_t *s, dt_job_t *job, int32_t re
 
 int32_t dt_control_get_threadid();
 
+/** job system statistics, collected from dt_init() on */
+void dt_control_jobs_stats_init(struct dt_control_t *control);
+void dt_control_jobs_stats_cleanup(struct dt_control_t *control);
+/** get a snapshot of the statistics of one queue */
+void dt_control_jobs_get_stats(struct dt_control_t *control, const dt_job_queue_t queue,
+                               dt_job_queue_stats_t *stats);
+/** dump all statistics, per queue and per job type, as json. free with g_free() */
+gchar *dt_control_jobs_stats_json(struct dt_control_t *control);
+
 #ifdef HAVE_GPHOTO2
 #include "control/jobs/camera_jobs.h"
 #endif
@@ -62,6 +62,76 @@ dt_job_t *dt_image_load_job_create(int32_t id, dt_mipmap_size_t mip)
   return job;
 }
 
+typedef struct dt_image_prefetch_t
+{
+  GList *imgs;
+  dt_mipmap_size_t mip;
+  int generation;
+} dt_image_prefetch_t;
+
+// bumped by every new prefetch job, so that a running one stops once another film roll gets opened
+static int _prefetch_generation = 0;
+
+static int32_t dt_image_prefetch_job_run(dt_job_t *job)
+{
+  dt_image_prefetch_t *params = dt_control_job_get_params(job);
+
+  // image cache entries first, they only need the database and are wanted by every thumbnail
+  for(GList *l = params->imgs; l; l = g_list_next(l))
+  {
+    if(g_atomic_int_get(&_prefetch_generation) != params->generation
+       || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+      return 0;
+    const dt_image_t *img = dt_image_cache_get(darktable.image_cache, GPOINTER_TO_INT(l->data), 'r');
+    if(img) dt_image_cache_read_release(darktable.image_cache, img);
+  }
+
+  if(params->mip >= DT_MIPMAP_F) return 0;
+
+  // then the thumbnails, in collection order
+  for(GList *l = params->imgs; l; l = g_list_next(l))
+  {
+    if(g_atomic_int_get(&_prefetch_generation) != params->generation
+       || dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+      return 0;
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, GPOINTER_TO_INT(l->data), params->mip, DT_MIPMAP_BLOCKING,
+                        'r');
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  }
+  return 0;
+}
+
+static void dt_image_prefetch_job_cleanup(void *p)
+{
+  dt_image_prefetch_t *params = p;
+  g_list_free(params->imgs);
+  free(params);
+}
+
+dt_job_t *dt_image_prefetch_job_create(GList *imgs, dt_mipmap_size_t mip)
+{
+  dt_job_t *job = dt_control_job_create(&dt_image_prefetch_job_run, "prefetch %d images mip %d",
+                                        g_list_length(imgs), mip);
+  if(!job)
+  {
+    g_list_free(imgs);
+    return NULL;
+  }
+  dt_image_prefetch_t *params = (dt_image_prefetch_t *)calloc(1, sizeof(dt_image_prefetch_t));
+  if(!params)
+  {
+    g_list_free(imgs);
+    dt_control_job_dispose(job);
+    return NULL;
+  }
+  dt_control_job_set_params(job, params, dt_image_prefetch_job_cleanup);
+  params->imgs = imgs;
+  params->mip = mip;
+  params->generation = g_atomic_int_add(&_prefetch_generation, 1) + 1;
+  return job;
+}
+
 typedef struct dt_image_import_t
 {
   uint32_t film_id;
@@ -24,6 +24,9 @@
 #include <inttypes.h>
 
 dt_job_t *dt_image_load_job_create(int32_t imgid, dt_mipmap_size_t mip);
+/** warms the image cache and the given mip for the list of image ids, which the job takes over (and frees
+ * if it can't be created). a newer prefetch job stops the older ones. */
+dt_job_t *dt_image_prefetch_job_create(GList *imgs, dt_mipmap_size_t mip);
 
 dt_job_t *dt_image_import_job_create(uint32_t filmid, const char *filename);
 
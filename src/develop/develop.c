@@ -47,7 +47,7 @@
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
 #define DT_IOP_ORDER_INFO (darktable.unmuted & DT_DEBUG_IOPORDER)
 
-const gchar *dt_dev_scope_type_names[DT_DEV_SCOPE_N] = { "histogram", "waveform" };
+const gchar *dt_dev_scope_type_names[DT_DEV_SCOPE_N] = { "histogram", "waveform", "vectorscope" };
 
 void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
 {
@@ -86,6 +86,8 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
     dev->scope_type = DT_DEV_SCOPE_HISTOGRAM;
   else if(g_strcmp0(mode, "waveform") == 0)
     dev->scope_type = DT_DEV_SCOPE_WAVEFORM;
+  else if(g_strcmp0(mode, "vectorscope") == 0)
+    dev->scope_type = DT_DEV_SCOPE_VECTORSCOPE;
   else if(g_strcmp0(mode, "linear") == 0)
   { // update legacy conf
     dev->scope_type = DT_DEV_SCOPE_HISTOGRAM;
@@ -150,6 +152,8 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
     // to be safe, and the histogram is for the sake of UI, after all
     dev->histogram_waveform_stride = cairo_format_stride_for_width(CAIRO_FORMAT_A8, dev->histogram_waveform_width);
     dev->histogram_waveform = calloc(dev->histogram_waveform_height * dev->histogram_waveform_stride * 3, sizeof(uint8_t));
+    dev->histogram_vectorscope = calloc(DT_DEV_VECTORSCOPE_SIZE * DT_DEV_VECTORSCOPE_SIZE, sizeof(uint8_t));
+    dev->histogram_sampling = CLAMP(dt_conf_get_int("plugins/darkroom/histogram/sampling"), 1, 8);
   }
 
   dev->iop_instance = 0;
@@ -236,6 +240,7 @@ void dt_dev_cleanup(dt_develop_t *dev)
   free(dev->histogram_pre_tonecurve);
   free(dev->histogram_pre_levels);
   free(dev->histogram_waveform);
+  free(dev->histogram_vectorscope);
 
   g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
   g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
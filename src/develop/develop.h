@@ -80,9 +80,13 @@ typedef enum dt_dev_scope_type_t
 {
   DT_DEV_SCOPE_HISTOGRAM = 0,
   DT_DEV_SCOPE_WAVEFORM,
+  DT_DEV_SCOPE_VECTORSCOPE,
   DT_DEV_SCOPE_N // needs to be the last one
 } dt_dev_scope_type_t;
 
+// the vectorscope is a square of chroma bins, stored as a cairo A8 surface
+#define DT_DEV_VECTORSCOPE_SIZE 128
+
 typedef enum dt_dev_histogram_type_t
 {
   DT_DEV_HISTOGRAM_LOGARITHMIC = 0,
@@ -198,6 +202,9 @@ typedef struct dt_develop_t
   uint32_t histogram_max, histogram_pre_tonecurve_max, histogram_pre_levels_max;
   uint8_t *histogram_waveform;
   uint32_t histogram_waveform_width, histogram_waveform_height, histogram_waveform_stride;
+  uint8_t *histogram_vectorscope;
+  // the waveform and vectorscope of the preview pipe only look at every n-th row
+  int histogram_sampling;
   dt_dev_scope_type_t scope_type;
   dt_dev_histogram_type_t histogram_type;
 
@@ -62,6 +62,10 @@ typedef struct dt_iop_buffer_dsc_t
   int cst;
   /** work profile info of the image */
   struct dt_iop_order_iccprofile_info_t *work_profile_info;
+
+  /** the float data is stored as half floats. only ever set inside the pixelpipe cache,
+   * buffers handed out by the cache are always unpacked. */
+  int packed;
 } dt_iop_buffer_dsc_t;
 
 size_t dt_iop_buffer_dsc_to_bpp(const struct dt_iop_buffer_dsc_t *dsc);
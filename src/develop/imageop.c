@@ -48,6 +48,7 @@
 #endif
 
 #include <assert.h>
+#include <glib/gstdio.h>
 #include <gmodule.h>
 #include <math.h>
 #include <stdlib.h>
@@ -296,6 +297,8 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
     module->cleanup_global = NULL;
   if(!g_module_symbol(module->module, "init_presets", (gpointer) & (module->init_presets)))
     module->init_presets = NULL;
+  if(!g_module_symbol(module->module, "presets_stamp", (gpointer) & (module->presets_stamp)))
+    module->presets_stamp = NULL;
   if(!g_module_symbol(module->module, "commit_params", (gpointer) & (module->commit_params)))
     module->commit_params = default_commit_params;
   if(!g_module_symbol(module->module, "change_image", (gpointer) & (module->change_image)))
@@ -328,6 +331,8 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
     module->distort_backtransform = default_distort_backtransform;
   if(!g_module_symbol(module->module, "distort_mask", (gpointer) & (module->distort_mask)))
     module->distort_mask = NULL;
+  if(!g_module_symbol(module->module, "distort_warp", (gpointer) & (module->distort_warp)))
+    module->distort_warp = NULL;
 
   if(!g_module_symbol(module->module, "modify_roi_in", (gpointer) & (module->modify_roi_in)))
     module->modify_roi_in = dt_iop_modify_roi_in;
@@ -456,6 +461,7 @@ int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt
   module->distort_transform = so->distort_transform;
   module->distort_backtransform = so->distort_backtransform;
   module->distort_mask = so->distort_mask;
+  module->distort_warp = so->distort_warp;
   module->modify_roi_in = so->modify_roi_in;
   module->modify_roi_out = so->modify_roi_out;
   module->legacy_params = so->legacy_params;
@@ -1210,21 +1216,97 @@ void dt_iop_cleanup_histogram(gpointer data, gpointer user_data)
   module->histogram_stats.pixels = 0;
 }
 
+// the built-in presets of a module only change with darktable, the module build, the module and blend
+// versions, the language their names are translated to, the module's auto-apply setting and whatever else
+// the module reports in presets_stamp(). this is stored in data.db_info and the presets are only written
+// again when something changed. the package version stays the same between development builds, the size
+// and mtime of the module's library don't.
+static gchar *_presets_stamp(dt_iop_module_so_t *module_so)
+{
+  gchar *auto_apply_key = g_strdup_printf("plugins/darkroom/%s/auto_apply", module_so->op);
+  const int auto_apply = dt_conf_key_exists(auto_apply_key) ? dt_conf_get_bool(auto_apply_key) : -1;
+  g_free(auto_apply_key);
+
+  GStatBuf st = { 0 };
+  const gchar *library = module_so->module ? g_module_name(module_so->module) : NULL;
+  if(!library || g_stat(library, &st)) memset(&st, 0, sizeof(st));
+
+  gchar *module_stamp = module_so->presets_stamp ? module_so->presets_stamp(module_so) : NULL;
+  gchar *stamp = g_strdup_printf("%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %d %d %s %d %s",
+                                 darktable_package_version, (gint64)st.st_size, (gint64)st.st_mtime,
+                                 module_so->version(), dt_develop_blend_version(), g_get_language_names()[0],
+                                 auto_apply, module_stamp ? module_stamp : "");
+  g_free(module_stamp);
+  return stamp;
+}
+
 static void init_presets(dt_iop_module_so_t *module_so)
 {
-  if(module_so->init_presets) module_so->init_presets(module_so);
+  if(module_so->init_presets)
+  {
+    gchar *key = g_strdup_printf("presets/%s", module_so->op);
+    gchar *stamp = _presets_stamp(module_so);
+    gboolean current = FALSE;
+
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT value FROM data.db_info WHERE key = ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+    if(sqlite3_step(stmt) == SQLITE_ROW) current = !g_strcmp0((const char *)sqlite3_column_text(stmt, 0), stamp);
+    sqlite3_finalize(stmt);
+
+    // also write them again if they got lost on the way, e.g. removed by an older version
+    if(current)
+    {
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "SELECT 1 FROM data.presets WHERE operation = ?1 AND writeprotect = 1 LIMIT 1",
+                                  -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module_so->op, -1, SQLITE_TRANSIENT);
+      current = sqlite3_step(stmt) == SQLITE_ROW;
+      sqlite3_finalize(stmt);
+    }
+
+    if(!current)
+    {
+      // the old built-in presets were kept by dt_gui_presets_init(), some of them may be gone now
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "DELETE FROM data.presets WHERE operation = ?1 AND writeprotect = 1", -1, &stmt,
+                                  NULL);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module_so->op, -1, SQLITE_TRANSIENT);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+
+      module_so->init_presets(module_so);
+
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "INSERT OR REPLACE INTO data.db_info (key, value) VALUES (?1, ?2)", -1, &stmt,
+                                  NULL);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, stamp, -1, SQLITE_TRANSIENT);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+    }
+    dt_print(DT_DEBUG_PERF, "[init_presets] %s: built-in presets %s\n", module_so->op,
+             current ? "up to date" : "written");
+
+    g_free(stamp);
+    g_free(key);
+  }
 
   // this seems like a reasonable place to check for and update legacy
-  // presets.
+  // presets. only outdated ones are looked at, the others need nothing.
 
   int32_t module_version = module_so->version();
 
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(
       dt_database_get(darktable.db),
-      "SELECT name, op_version, op_params, blendop_version, blendop_params FROM data.presets WHERE operation = ?1",
+      "SELECT name, op_version, op_params, blendop_version, blendop_params FROM data.presets"
+      " WHERE operation = ?1 AND (op_version < ?2 OR blendop_version < ?3 OR blendop_params IS NULL)",
       -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module_so->op, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, module_version);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, dt_develop_blend_version());
 
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -43,6 +43,7 @@ struct dt_dev_pixelpipe_iop_t;
 struct dt_develop_blend_params_t;
 struct dt_develop_tiling_t;
 struct dt_iop_color_picker_t;
+struct dt_warp_t;
 
 typedef enum dt_iop_module_header_icons_t
 {
@@ -158,6 +159,8 @@ typedef struct dt_iop_module_so_t
 
   /** this initializes static, hardcoded presets for this module and is called only once per run of dt. */
   void (*init_presets)(struct dt_iop_module_so_t *self);
+  /** optional: everything else init_presets() depends on, g_free()d by the caller. */
+  char *(*presets_stamp)(struct dt_iop_module_so_t *self);
   /** called once per module, at startup. */
   void (*init_global)(struct dt_iop_module_so_t *self);
   /** called once per module, at shutdown. */
@@ -269,6 +272,8 @@ typedef struct dt_iop_module_so_t
                                float *points, size_t points_count);
   void (*distort_mask)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                        float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out);
+  int (*distort_warp)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                      const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out, struct dt_warp_t *w);
 
   // introspection related callbacks
   gboolean have_introspection;
@@ -525,6 +530,10 @@ typedef struct dt_iop_module_t
   /** apply the image distortion to a single channel float buffer. only needed by iops that distort the image */
   void (*distort_mask)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                        float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out);
+  /** the mapping from roi_out to roi_in that process() resamples with, if it is a projective one. returns 0
+   * otherwise. lets the pixelpipe merge consecutive distortions into a single resampling step. */
+  int (*distort_warp)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                      const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out, struct dt_warp_t *w);
 
   /** Key accelerator registration callbacks */
   void (*connect_key_accels)(struct dt_iop_module_t *self);
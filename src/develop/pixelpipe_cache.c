@@ -21,6 +21,9 @@
 #include "develop/pixelpipe_hb.h"
 #include "libs/lib.h"
 #include <stdlib.h>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
 
 
 // TODO: make cache global (needs to be thread safe then)
@@ -43,6 +46,9 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, si
 #endif
   cache->hash = (uint64_t *)calloc(entries, sizeof(uint64_t));
   cache->used = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->payload = (size_t *)calloc(entries, sizeof(size_t));
+  cache->intermediate = (int *)calloc(entries, sizeof(int));
+  cache->fp16 = 0;
   for(int k = 0; k < entries; k++)
   {
     cache->size[k] = size;
@@ -85,6 +91,129 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
   free(cache->hash);
   free(cache->used);
   free(cache->size);
+  free(cache->payload);
+  free(cache->intermediate);
+}
+
+void dt_dev_pixelpipe_cache_set_fp16(dt_dev_pixelpipe_cache_t *cache, const int fp16)
+{
+  cache->fp16 = fp16;
+}
+
+void dt_dev_pixelpipe_cache_set_intermediate(dt_dev_pixelpipe_cache_t *cache, void *data, const int intermediate)
+{
+  for(int k = 0; k < cache->entries; k++)
+    if(cache->data[k] == data) cache->intermediate[k] = intermediate;
+}
+
+// float <-> half conversion with round to nearest even, after fabian giesen's public domain code.
+// only used where the cpu doesn't have f16c.
+static inline uint16_t _float_to_half(const float f)
+{
+  const union { uint32_t i; float f; } f32infty = { 255u << 23 }, f16max = { (127u + 16u) << 23 },
+                                       denorm_magic = { ((127u - 15u) + (23u - 10u) + 1u) << 23 };
+  union { uint32_t i; float f; } u = { .f = f };
+  const uint32_t sign = u.i & 0x80000000u;
+  u.i ^= sign;
+  uint16_t o;
+  if(u.i >= f16max.i) // inf or nan
+    o = (u.i > f32infty.i) ? 0x7e00 : 0x7c00;
+  else if(u.i < (113u << 23)) // subnormal or zero: let the fpu round the mantissa into place
+  {
+    u.f += denorm_magic.f;
+    o = u.i - denorm_magic.i;
+  }
+  else
+  {
+    const uint32_t mant_odd = (u.i >> 13) & 1;
+    u.i += ((uint32_t)(15 - 127) << 23) + 0xfff + mant_odd;
+    o = u.i >> 13;
+  }
+  return o | (sign >> 16);
+}
+
+static inline float _half_to_float(const uint16_t h)
+{
+  const union { uint32_t i; float f; } magic = { 113u << 23 };
+  const uint32_t shifted_exp = 0x7c00u << 13;
+  union { uint32_t i; float f; } o;
+  o.i = (h & 0x7fffu) << 13;
+  const uint32_t exp = shifted_exp & o.i;
+  o.i += (127u - 15u) << 23;
+  if(exp == shifted_exp) // inf or nan
+    o.i += (128u - 16u) << 23;
+  else if(exp == 0) // zero or subnormal
+  {
+    o.i += 1u << 23;
+    o.f -= magic.f;
+  }
+  o.i |= (h & 0x8000u) << 16;
+  return o.f;
+}
+
+static void _pack_fp16(uint16_t *const out, const float *const in, const size_t n)
+{
+  const size_t n4 = n & ~(size_t)3;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(in, out, n4) schedule(static)
+#endif
+  for(size_t k = 0; k < n4; k += 4)
+  {
+#if defined(__F16C__)
+    _mm_storel_epi64((__m128i *)(out + k), _mm_cvtps_ph(_mm_loadu_ps(in + k), _MM_FROUND_TO_NEAREST_INT));
+#else
+    for(int c = 0; c < 4; c++) out[k + c] = _float_to_half(in[k + c]);
+#endif
+  }
+  for(size_t k = n4; k < n; k++) out[k] = _float_to_half(in[k]);
+}
+
+static void _unpack_fp16(float *const out, const uint16_t *const in, const size_t n)
+{
+  const size_t n4 = n & ~(size_t)3;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(in, out, n4) schedule(static)
+#endif
+  for(size_t k = 0; k < n4; k += 4)
+  {
+#if defined(__F16C__)
+    _mm_storeu_ps(out + k, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(in + k))));
+#else
+    for(int c = 0; c < 4; c++) out[k + c] = _half_to_float(in[k + c]);
+#endif
+  }
+  for(size_t k = n4; k < n; k++) out[k] = _half_to_float(in[k]);
+}
+
+// replace the float buffer of line k by a half float copy of its payload
+static void _cache_pack(dt_dev_pixelpipe_cache_t *cache, const int k)
+{
+  const size_t n = cache->payload[k] / sizeof(float);
+  uint16_t *packed = (uint16_t *)dt_alloc_align(64, n * sizeof(uint16_t));
+  if(!packed) return; // just keep it as it is
+  ASAN_UNPOISON_MEMORY_REGION(cache->data[k], cache->payload[k]);
+  _pack_fp16(packed, (const float *)cache->data[k], n);
+  dt_free_align(cache->data[k]);
+  cache->data[k] = packed;
+  cache->size[k] = n * sizeof(uint16_t);
+  cache->dsc[k].packed = 1;
+  ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
+}
+
+// back to floats, in a buffer of at least size bytes. returns 0 if there is no memory for that.
+static int _cache_unpack(dt_dev_pixelpipe_cache_t *cache, const int k, const size_t size)
+{
+  const size_t n = cache->payload[k] / sizeof(float);
+  const size_t sz = MAX(size, cache->payload[k]);
+  float *unpacked = (float *)dt_alloc_align(64, sz);
+  if(!unpacked) return 0;
+  ASAN_UNPOISON_MEMORY_REGION(cache->data[k], cache->size[k]);
+  _unpack_fp16(unpacked, (const uint16_t *)cache->data[k], n);
+  dt_free_align(cache->data[k]);
+  cache->data[k] = unpacked;
+  cache->size[k] = sz;
+  cache->dsc[k].packed = 0;
+  return 1;
 }
 
 uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const dt_iop_roi_t *roi, dt_dev_pixelpipe_t *pipe, int module)
@@ -147,7 +276,7 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
 {
   cache->queries++;
   *data = NULL;
-  int max_used = -1, max = 0;
+  int max_used = -1, max = 0, found = -1;
   size_t sz = 0;
   for(int k = 0; k < cache->entries; k++)
   {
@@ -160,16 +289,34 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
     cache->used[k]++; // age all entries
     if(cache->hash[k] == hash)
     {
+      if(cache->dsc[k].packed && !_cache_unpack(cache, k, size))
+      {
+        // can't get it back, drop the line
+        cache->hash[k] = -1;
+        continue;
+      }
       *data = cache->data[k];
       *dsc = &cache->dsc[k];
       sz = cache->size[k];
       cache->used[k] = weight; // this is the MRU entry
+      cache->intermediate[k] = 0; // handed out again, in use until the pipe releases it
+      found = k;
 
       ASAN_POISON_MEMORY_REGION(*data, sz);
       ASAN_UNPOISON_MEMORY_REGION(*data, size);
     }
   }
 
+  // packing replaces the buffer, so only lines the pipe has released may be packed: nobody holds a pointer
+  // to them any more.
+  if(cache->fp16)
+    for(int k = 0; k < cache->entries; k++)
+      if(k != found && k != max && cache->hash[k] != (uint64_t)-1 && cache->data[k] && !cache->dsc[k].packed
+         && cache->intermediate[k] && cache->dsc[k].datatype == TYPE_FLOAT && cache->payload[k])
+        _cache_pack(cache, k);
+
+  if(found >= 0) cache->payload[found] = size;
+
   if(!*data || sz < size)
   {
     // kill LRU entry
@@ -189,10 +336,13 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
 
     // first, update our copy, then update the pointer to point at our copy
     cache->dsc[max] = **dsc;
+    cache->dsc[max].packed = 0;
     *dsc = &cache->dsc[max];
 
     cache->hash[max] = hash;
     cache->used[max] = weight;
+    cache->payload[max] = size;
+    cache->intermediate[max] = 0;
     cache->misses++;
     return 1;
   }
@@ -238,7 +388,7 @@ void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
   for(int k = 0; k < cache->entries; k++)
   {
     printf("pixelpipe cacheline %d ", k);
-    printf("used %d by %" PRIu64 "", cache->used[k], cache->hash[k]);
+    printf("used %d by %" PRIu64 "%s", cache->used[k], cache->hash[k], cache->dsc[k].packed ? " (fp16)" : "");
     printf("\n");
   }
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
@@ -38,6 +38,9 @@ typedef struct dt_dev_pixelpipe_cache_t
   struct dt_iop_buffer_dsc_t *dsc;
   uint64_t *hash;
   int32_t *used;
+  size_t *payload;  // bytes requested for the line, which is what gets packed
+  int *intermediate; // set by the pipe once it is done with a float line, the only ones that get packed
+  int fp16;         // pack float lines to half floats while they are not in use
 #ifdef HAVE_OPENCL
   void **gpu_mem;
 #endif
@@ -78,6 +81,15 @@ void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data
 /** mark the given cache line pointer as invalid. */
 void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *data);
 
+/** with fp16 set, float cache lines the pipe has released are stored as half floats, and unpacked again when
+ * they get hit. this is lossy, but halves their memory. */
+void dt_dev_pixelpipe_cache_set_fp16(dt_dev_pixelpipe_cache_t *cache, const int fp16);
+
+/** marks the cache line of this buffer as a float intermediate the pipe is done with, which may be packed.
+ * getting the line again clears the mark. the output of the pipe must never be marked, the gui keeps
+ * pointing to it. */
+void dt_dev_pixelpipe_cache_set_intermediate(dt_dev_pixelpipe_cache_t *cache, void *data, const int intermediate);
+
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
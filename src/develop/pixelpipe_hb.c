@@ -21,6 +21,8 @@
 #include "common/imageio.h"
 #include "common/opencl.h"
 #include "common/iop_order.h"
+#include "common/warp.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -151,7 +153,13 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->processed_height = pipe->backbuf_height = pipe->iheight = 0;
   pipe->nodes = NULL;
   pipe->backbuf_size = size;
-  if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
+  // packed lines take half the memory. the input and output of the module being processed and the backbuf
+  // are never packed, the memory of the other lines holds twice as many packed ones.
+  const int unpacked = 3;
+  const int fp16 = entries > unpacked && dt_conf_get_bool("pixelpipe_cache_fp16");
+  if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), fp16 ? 2 * entries - unpacked : entries, pipe->backbuf_size))
+    return 0;
+  dt_dev_pixelpipe_cache_set_fp16(&(pipe->cache), fp16);
   pipe->cache_obsolete = 0;
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.0f;
@@ -167,6 +175,8 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->shutdown = 0;
   pipe->opencl_error = 0;
   pipe->tiling = 0;
+  pipe->merge_distortions = 1;
+  pipe->merge_error = 0;
   pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_NONE;
   pipe->bypass_blendif = 0;
   pipe->input_timestamp = 0;
@@ -914,10 +924,40 @@ static void _pixelpipe_pick_primary_colorpicker(dt_develop_t *dev, const float *
   if(xform_rgb2rgb) cmsDeleteTransform(xform_rgb2rgb);
 }
 
-static void _pixelpipe_final_histogram(dt_develop_t *dev, const float *const input, const dt_iop_roi_t *roi_in)
+// the histogram and the scopes show the image in the histogram profile. returns the preview converted to it,
+// or NULL if it is in that profile already or there is no memory, and the profile in any case.
+static float *_pixelpipe_histogram_input(dt_develop_t *dev, const float *const input, const dt_iop_roi_t *roi_in,
+                                         const dt_iop_order_iccprofile_info_t **profile_info)
 {
-  float *img_tmp = NULL;
+  dt_colorspaces_color_profile_type_t histogram_type = DT_COLORSPACE_SRGB;
+  gchar *histogram_filename = NULL;
+  gchar _histogram_filename[1] = { 0 };
+
+  dt_ioppr_get_histogram_profile_type(&histogram_type, &histogram_filename);
+  if(histogram_filename == NULL) histogram_filename = _histogram_filename;
+
+  *profile_info = dt_ioppr_add_profile_info_to_list(dev, histogram_type, histogram_filename, INTENT_PERCEPTUAL);
 
+  if((histogram_type != darktable.color_profiles->display_type)
+     || (histogram_type == DT_COLORSPACE_FILE
+         && strcmp(histogram_filename, darktable.color_profiles->display_filename)))
+  {
+    float *img_tmp = dt_alloc_align(64, (size_t)roi_in->width * roi_in->height * 4 * sizeof(float));
+    if(!img_tmp) return NULL;
+
+    const dt_iop_order_iccprofile_info_t *const profile_info_from
+        = dt_ioppr_add_profile_info_to_list(dev, darktable.color_profiles->display_type,
+                                            darktable.color_profiles->display_filename, INTENT_PERCEPTUAL);
+
+    dt_ioppr_transform_image_colorspace_rgb(input, img_tmp, roi_in->width, roi_in->height, profile_info_from,
+                                            *profile_info, "final histogram");
+    return img_tmp;
+  }
+  return NULL;
+}
+
+static void _pixelpipe_final_histogram(dt_develop_t *dev, const float *const input, const dt_iop_roi_t *roi_in)
+{
   dt_dev_histogram_collection_params_t histogram_params = { 0 };
   const dt_iop_colorspace_type_t cst = iop_cs_rgb;
   dt_dev_histogram_stats_t histogram_stats = { .bins_count = 256, .ch = 4, .pixels = 0 };
@@ -946,29 +986,6 @@ static void _pixelpipe_final_histogram(dt_develop_t *dev, const float *const inp
     }
   }
 
-  dt_colorspaces_color_profile_type_t histogram_type = DT_COLORSPACE_SRGB;
-  gchar *histogram_filename = NULL;
-  gchar _histogram_filename[1] = { 0 };
-
-  dt_ioppr_get_histogram_profile_type(&histogram_type, &histogram_filename);
-  if(histogram_filename == NULL) histogram_filename = _histogram_filename;
-
-  if((histogram_type != darktable.color_profiles->display_type)
-     || (histogram_type == DT_COLORSPACE_FILE
-         && strcmp(histogram_filename, darktable.color_profiles->display_filename)))
-  {
-    img_tmp = dt_alloc_align(64, roi_in->width * roi_in->height * 4 * sizeof(float));
-
-    const dt_iop_order_iccprofile_info_t *const profile_info_from
-        = dt_ioppr_add_profile_info_to_list(dev, darktable.color_profiles->display_type,
-                                            darktable.color_profiles->display_filename, INTENT_PERCEPTUAL);
-    const dt_iop_order_iccprofile_info_t *const profile_info_to
-        = dt_ioppr_add_profile_info_to_list(dev, histogram_type, histogram_filename, INTENT_PERCEPTUAL);
-
-    dt_ioppr_transform_image_colorspace_rgb(input, img_tmp, roi_in->width, roi_in->height, profile_info_from,
-                                            profile_info_to, "final histogram");
-  }
-
   dt_times_t start_time = { 0 };
   if(darktable.unmuted & DT_DEBUG_PERF) dt_get_times(&start_time);
 
@@ -979,12 +996,10 @@ static void _pixelpipe_final_histogram(dt_develop_t *dev, const float *const inp
   histogram_params.bins_count = 256;
   histogram_params.mul = histogram_params.bins_count - 1;
 
-  dt_histogram_helper(&histogram_params, &histogram_stats, cst, iop_cs_NONE, (img_tmp) ? img_tmp: input, &dev->histogram, FALSE, NULL);
+  dt_histogram_helper(&histogram_params, &histogram_stats, cst, iop_cs_NONE, input, &dev->histogram, FALSE, NULL);
   dt_histogram_max_helper(&histogram_stats, cst, iop_cs_NONE, &dev->histogram, histogram_max);
   dev->histogram_max = MAX(MAX(histogram_max[0], histogram_max[1]), histogram_max[2]);
 
-  if(img_tmp) dt_free_align(img_tmp);
-
   if(darktable.unmuted & DT_DEBUG_PERF)
   {
     dt_times_t end_time = { 0 };
@@ -993,11 +1008,22 @@ static void _pixelpipe_final_histogram(dt_develop_t *dev, const float *const inp
   }
 }
 
-static void _pixelpipe_final_histogram_waveform(dt_develop_t *dev, const float *const input, const dt_iop_roi_t *roi_in)
+// columns of the waveform handled by one task: the counts of a task in one row of the waveform fill exactly
+// one cache line, so no two threads ever write to the same line
+#define DT_SCOPES_BLOCK 16
+
+// waveform and vectorscope of the preview, both in one pass over the pixels so switching between them needs
+// no reprocessing. the waveform is split by columns, so each thread owns its bins, the vectorscope gets thread
+// private bins which are summed up at the end. the chroma of the vectorscope uses the luma coefficients of
+// the histogram profile, rec709 if it has no matrix.
+static void _pixelpipe_final_scopes(dt_develop_t *dev, const float *const input, const dt_iop_roi_t *roi_in,
+                                    const dt_iop_order_iccprofile_info_t *const profile_info)
 {
   dt_times_t start_time = { 0 };
   if(darktable.unmuted & DT_DEBUG_PERF) dt_get_times(&start_time);
 
+  const int sampling = MAX(dev->histogram_sampling, 1);
+
   const int waveform_height = dev->histogram_waveform_height;
   const int waveform_stride = dev->histogram_waveform_stride;
   uint8_t *const waveform = dev->histogram_waveform;
@@ -1009,74 +1035,109 @@ static void _pixelpipe_final_histogram_waveform(dt_develop_t *dev, const float *
   // width and # of bins.
   const int bin_width = ceilf(roi_in->width / (float)waveform_stride);
   const int waveform_width = ceilf(roi_in->width / (float)bin_width);
+
+  // counts, one plane per channel, rows padded to whole blocks
+  const int blocks = (waveform_width + DT_SCOPES_BLOCK - 1) / DT_SCOPES_BLOCK;
+  const size_t buf_stride = (size_t)blocks * DT_SCOPES_BLOCK;
+  const int vs_size = DT_DEV_VECTORSCOPE_SIZE;
+  const size_t vs_bins = (size_t)vs_size * vs_size;
+  const int nthreads = dt_get_num_threads();
+
+  // even bin_width 12 and height 900 image gives 10,800 byte cache, more normal will ~1K
+  const int cache_size = (roi_in->height * bin_width) + 1;
+
+  uint32_t *buf = dt_alloc_align(64, sizeof(uint32_t) * buf_stride * waveform_height * 3);
+  uint32_t *vs_buf = dt_alloc_align(64, sizeof(uint32_t) * vs_bins * nthreads);
+  uint8_t *cache = (uint8_t *)calloc(cache_size, sizeof(uint8_t));
+  if(!buf || !vs_buf || !cache)
+  {
+    // leave the scopes as they are
+    dt_free_align(buf);
+    dt_free_align(vs_buf);
+    free(cache);
+    return;
+  }
+  memset(buf, 0, sizeof(uint32_t) * buf_stride * waveform_height * 3);
+  memset(vs_buf, 0, sizeof(uint32_t) * vs_bins * nthreads);
   dev->histogram_waveform_width = waveform_width;
 
-  // max input size should be 1440x900, and with a bin_width of 1,
-  // that makes a maximum possible count of 900 in buf, while even if
-  // waveform buffer is 128 (about smallest possible), bin_width is
-  // 12, making max count of 10,800, still much smaller than uint16_t
-  uint16_t *buf = calloc(waveform_width * waveform_height * 3, sizeof(uint16_t));
-  memset(waveform, 0, sizeof(uint8_t) * waveform_height * waveform_stride * 3);
+  // luma coefficients: the Y row of the rgb to xyz matrix
+  float Kr = 0.2126f, Kg = 0.7152f, Kb = 0.0722f;
+  if(profile_info && !isnan(profile_info->matrix_in[0]))
+  {
+    Kr = profile_info->matrix_in[3];
+    Kg = profile_info->matrix_in[4];
+    Kb = profile_info->matrix_in[5];
+  }
+  // scale both chroma axes to [-0.5, 0.5]
+  const float u_scale = 0.5f / MAX(1.0f - Kb, 1e-6f);
+  const float v_scale = 0.5f / MAX(1.0f - Kr, 1e-6f);
 
   // 1.0 is at 8/9 of the height!
   const float _height = (float)(waveform_height - 1);
+  const float _vs_size = (float)(vs_size - 1);
 
-  // count the colors into buf ...
+  // count the colors into the bins ...
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(roi_in, bin_width, _height, waveform_width, input, buf) \
-  schedule(static)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(roi_in, bin_width, _height, _vs_size, waveform_width, waveform_height, input, buf, \
+                      buf_stride, vs_buf, vs_bins, vs_size, sampling, blocks, Kr, Kg, Kb, u_scale, v_scale) \
+  schedule(static) num_threads(nthreads)
 #endif
-  for(int in_y = 0; in_y < roi_in->height; in_y++)
+  for(int block = 0; block < blocks; block++)
   {
-    for(int in_x = 0; in_x < roi_in->width; in_x++)
+    const int x_start = block * DT_SCOPES_BLOCK * bin_width;
+    const int x_end = MIN(roi_in->width, (block + 1) * DT_SCOPES_BLOCK * bin_width);
+    uint32_t *const vs = vs_buf + vs_bins * omp_get_thread_num();
+    for(int in_y = 0; in_y < roi_in->height; in_y += sampling)
     {
-      const float *const in = input + 4 * (in_y*roi_in->width + in_x);
-      const int out_x = in_x / bin_width;
-      for(int k = 0; k < 3; k++)
+      const float *in = input + 4 * ((size_t)in_y * roi_in->width + x_start);
+      for(int in_x = x_start; in_x < x_end; in_x++, in += 4)
       {
-        const float v = 1.0f - (8.0f / 9.0f) * in[2 - k];
-        // flipped from dt's CLAMPS so as to treat NaN's as 0 (NaN compares false)
-        const int out_y = (v < 1.0f ? (v > 0.0f ? v : 0.0f) : 1.0f) * _height;
-        __sync_add_and_fetch(buf + (out_x + waveform_width * out_y) * 3 + k, 1);
+        const int out_x = in_x / bin_width;
+        for(int k = 0; k < 3; k++)
+        {
+          const float v = 1.0f - (8.0f / 9.0f) * in[2 - k];
+          // flipped from dt's CLAMPS so as to treat NaN's as 0 (NaN compares false)
+          const int out_y = (v < 1.0f ? (v > 0.0f ? v : 0.0f) : 1.0f) * _height;
+          buf[(k * waveform_height + out_y) * buf_stride + out_x]++;
+        }
+
+        const float Y = Kr * in[0] + Kg * in[1] + Kb * in[2];
+        const float u = 0.5f + (in[2] - Y) * u_scale;
+        const float v = 0.5f - (in[0] - Y) * v_scale;
+        const int vs_x = (u < 1.0f ? (u > 0.0f ? u : 0.0f) : 1.0f) * _vs_size;
+        const int vs_y = (v < 1.0f ? (v > 0.0f ? v : 0.0f) : 1.0f) * _vs_size;
+        vs[vs_y * vs_size + vs_x]++;
       }
     }
   }
 
-  // TODO: Find a nicer function to map buf -> image than just clipping
-  //         float factor[3];
-  //         for(int k = 0; k < 3; k++)
-  //           factor[k] = 255.0 / (float)(maxcol[k] - mincol[k]); // leave some clipping
-
   // ... and scale that into a nice image. putting the pixels into the image directly gets too
   // saturated/clips.
 
   // new scale factor to do about the same as the old one for 1MP views, but scale to hidpi
-  const float scale = 0.5 * 1e6f/(roi_in->height*roi_in->width) *
+  const float scale = 0.5 * 1e6f/(roi_in->height*roi_in->width) * sampling *
     (waveform_width*waveform_height) / (350.0f*233.)
     / 255.0f; // normalization to 0..1 for gamma correction
   const float gamma = 1.0 / 1.5; // TODO make this settable from the gui?
-  //uint32_t mincol[3] = {UINT32_MAX,UINT32_MAX,UINT32_MAX}, maxcol[3] = {0,0,0};
-  // even bin_width 12 and height 900 image gives 10,800 byte cache, more normal will ~1K
-  const int cache_size = (roi_in->height * bin_width) + 1;
-  uint8_t *cache = (uint8_t *)calloc(cache_size, sizeof(uint8_t));
+  memset(waveform, 0, sizeof(uint8_t) * waveform_height * waveform_stride * 3);
 
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(waveform_width, waveform_height, waveform_stride, buf, waveform, cache, scale, gamma) \
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(waveform_width, waveform_height, waveform_stride, buf, buf_stride, waveform, cache, \
+                      cache_size, scale, gamma) \
   schedule(static) collapse(2)
 #endif
   for(int k = 0; k < 3; k++)
   {
     for(int out_y = 0; out_y < waveform_height; out_y++)
     {
-      const uint16_t *const in = buf + (waveform_width * out_y) * 3 + k;
+      const uint32_t *const in = buf + (k * waveform_height + out_y) * buf_stride;
       uint8_t *const out = waveform + (waveform_stride * (waveform_height * k + out_y));
       for(int out_x = 0; out_x < waveform_width; out_x++)
       {
-        //mincol[k] = MIN(mincol[k], in[k]);
-        //maxcol[k] = MAX(maxcol[k], in[k]);
-        const uint16_t v = in[out_x * 3];
+        const int v = MIN(in[out_x], cache_size - 1);
         // cache XORd result so common casees cached and cache misses are quick to find
         if(!cache[v])
         {
@@ -1085,26 +1146,39 @@ static void _pixelpipe_final_histogram_waveform(dt_develop_t *dev, const float *
           cache[v] = (uint8_t)(CLAMP(powf(v * scale, gamma) * 255.0, 0, 255)) ^ 1;
         }
         out[out_x] = cache[v] ^ 1;
-        //               if(in[k] == 0)
-        //                 out[k] = 0;
-        //               else
-        //                 out[k] = (float)(in[k] - mincol[k]) * factor[k];
       }
     }
   }
-  //printf("mincol %d,%d,%d maxcol %d,%d,%d\n", mincol[0], mincol[1], mincol[2], maxcol[0], maxcol[1], maxcol[2]);
 
   free(cache);
-  free(buf);
+  dt_free_align(buf);
+
+  dt_histogram_reduce(vs_buf, nthreads, vs_bins);
+
+  uint32_t vs_max = 0;
+  for(size_t k = 0; k < vs_bins; k++) vs_max = MAX(vs_max, vs_buf[k]);
+  const float norm = vs_max ? 255.0f / logf(1.0f + vs_max) : 0.0f;
+  uint8_t *const vectorscope = dev->histogram_vectorscope;
+#ifdef _OPENMP
+#pragma omp parallel for SIMD() default(none) \
+  dt_omp_firstprivate(vs_buf, vs_bins, vectorscope, norm) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < vs_bins; k++) vectorscope[k] = (uint8_t)(logf(1.0f + vs_buf[k]) * norm);
+
+  dt_free_align(vs_buf);
 
   if(darktable.unmuted & DT_DEBUG_PERF)
   {
     dt_times_t end_time = { 0 };
     dt_get_times(&end_time);
-    fprintf(stderr, "final histogram waveform took %.3f secs (%.3f CPU)\n", end_time.clock - start_time.clock, end_time.user - start_time.user);
+    fprintf(stderr, "final histogram %s took %.3f secs (%.3f CPU)\n", dt_dev_scope_type_names[dev->scope_type],
+            end_time.clock - start_time.clock, end_time.user - start_time.user);
   }
 }
 
+#undef DT_SCOPES_BLOCK
+
 // returns 1 if blend process need the module default colorspace
 static int _transform_for_blend(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const int cst_in, const int cst_out)
 {
@@ -1123,6 +1197,89 @@ static int _transform_for_blend(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *p
 }
 
 // recursive helper for process:
+// can the resampling of this piece be folded into the one of a module further down the pipe?
+static gboolean _warp_mergeable(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_iop_module_t *module,
+                                dt_dev_pixelpipe_iop_t *piece)
+{
+  if(!module->distort_warp || piece->colors != 4) return FALSE;
+  // nothing may look at the buffers in between
+  if(piece->request_histogram & DT_REQUEST_ON) return FALSE;
+  if(dev->gui_attached && module == dev->gui_module) return FALSE;
+  const dt_develop_blend_params_t *const bp = (dt_develop_blend_params_t *)piece->blendop_data;
+  if(bp && (bp->mask_mode & DEVELOP_MASK_ENABLED)) return FALSE;
+  return module->input_colorspace(module, pipe, piece) == module->output_colorspace(module, pipe, piece);
+}
+
+// the merged resampling runs in one piece, so it must not need tiling for the rois of the whole run
+static gboolean _warp_fits_memory(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
+                                  const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
+{
+  if(!piece->process_tiling_ready) return TRUE;
+  dt_develop_tiling_t tiling = { 0 };
+  module->tiling_callback(module, piece, roi_in, roi_out, &tiling);
+  return dt_tiling_piece_fits_host_memory(MAX(roi_in->width, roi_out->width),
+                                          MAX(roi_in->height, roi_out->height), 4 * sizeof(float), tiling.factor,
+                                          tiling.overhead);
+}
+
+// collects the run of purely geometric modules ending in *modules into one mapping from roi_out to the input
+// of the first one, so the image gets resampled once instead of once per module. on return *modules, *pieces
+// and *pos point at the first module of the run and roi_in is its input. returns the number of modules that
+// got merged into the current one.
+static int _merge_distortions(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi_out,
+                              dt_iop_roi_t *roi_in, dt_warp_t *warp, GList **modules, GList **pieces, int *pos)
+{
+#ifdef HAVE_OPENCL
+  // the opencl path keeps processing module by module
+  if(dt_opencl_is_inited() && pipe->opencl_enabled && pipe->devid >= 0) return 0;
+#endif
+  if(pipe->mask_display || !pipe->merge_distortions) return 0;
+
+  dt_iop_module_t *module = (dt_iop_module_t *)(*modules)->data;
+  dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(*pieces)->data;
+  if(!_warp_mergeable(pipe, dev, module, piece)) return 0;
+  if(module->distort_warp(module, piece, roi_in, roi_out, warp) != 1 || warp->backtransform) return 0;
+  if(!_warp_fits_memory(module, piece, roi_in, roi_out)) return 0;
+  const int cst = module->input_colorspace(module, pipe, piece);
+
+  int merged = 0;
+  GList *m = g_list_previous(*modules);
+  GList *p = g_list_previous(*pieces);
+  for(int k = *pos - 1; m; m = g_list_previous(m), p = g_list_previous(p), k--)
+  {
+    dt_iop_module_t *prev = (dt_iop_module_t *)m->data;
+    dt_dev_pixelpipe_iop_t *prev_piece = (dt_dev_pixelpipe_iop_t *)p->data;
+    // skipped by dt_dev_pixelpipe_process_rec() anyways
+    if(!prev_piece->enabled
+       || (dev->gui_module && dev->gui_module->operation_tags_filter() & prev->operation_tags()))
+      continue;
+    if(!_warp_mergeable(pipe, dev, prev, prev_piece) || prev->input_colorspace(prev, pipe, prev_piece) != cst)
+      break;
+    // starting from a cached buffer is cheaper than resampling from further up
+    if(dt_dev_pixelpipe_cache_available(&(pipe->cache), dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_in, pipe, k)))
+      break;
+
+    dt_iop_roi_t prev_roi_in = *roi_in;
+    prev->modify_roi_in(prev, prev_piece, roi_in, &prev_roi_in);
+    dt_warp_t w;
+    if(prev->distort_warp(prev, prev_piece, &prev_roi_in, roi_in, &w) != 1 || w.backtransform) break;
+    if(!_warp_fits_memory(module, piece, &prev_roi_in, roi_out)) break;
+
+    // what falls off the output of prev stays black, as with prev writing that buffer. our coordinates in
+    // the input of prev are the ones in its output mapped by prev.
+    if(!dt_warp_bound(warp, roi_in->width, roi_in->height)) break;
+    dt_warp_homography(warp, w.h);
+    prev_piece->processed_roi_in = prev_roi_in;
+    prev_piece->processed_roi_out = *roi_in;
+    *roi_in = prev_roi_in;
+    *modules = m;
+    *pieces = p;
+    *pos = k;
+    merged++;
+  }
+  return merged;
+}
+
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
                                         const dt_iop_roi_t *roi_out, GList *modules, GList *pieces, int pos)
@@ -1135,6 +1292,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
   *cl_mem_output = NULL;
   dt_iop_module_t *module = NULL;
   dt_dev_pixelpipe_iop_t *piece = NULL;
+  // distortions of modules further up resampled together with this one
+  dt_warp_t warp;
+  GList *in_modules = NULL, *in_pieces = NULL;
+  int in_pos = 0, merged = 0;
   if(modules)
   {
     module = (dt_iop_module_t *)modules->data;
@@ -1263,25 +1424,40 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       return 1;
     }
     module->modify_roi_in(module, piece, roi_out, &roi_in);
+
+    piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+
+    piece->processed_roi_in = roi_in;
+    piece->processed_roi_out = *roi_out;
+
+    // fold the distortions right before this one into its resampling
+    in_modules = modules;
+    in_pieces = pieces;
+    in_pos = pos;
+    merged = _merge_distortions(pipe, dev, roi_out, &roi_in, &warp, &in_modules, &in_pieces, &in_pos);
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
 
+    if(merged)
+      dt_print(DT_DEBUG_DEV, "[dev_pixelpipe] %s resamples the output of %d more module(s) in one pass [%s]\n",
+               module->op, merged, _pipe_type_to_str(pipe->type));
+
     // recurse to get actual data of input buffer
 
     dt_iop_buffer_dsc_t _input_format = { 0 };
     dt_iop_buffer_dsc_t *input_format = &_input_format;
 
-    piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
-
-    piece->processed_roi_in = roi_in;
-    piece->processed_roi_out = *roi_out;
-
     if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, &roi_in,
-                                    g_list_previous(modules), g_list_previous(pieces), pos - 1))
+                                    g_list_previous(in_modules), g_list_previous(in_pieces), in_pos - 1))
       return 1;
 
     const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
 
     piece->dsc_out = piece->dsc_in = *input_format;
+    for(GList *p = in_pieces; p != pieces; p = g_list_next(p))
+    {
+      dt_dev_pixelpipe_iop_t *merged_piece = (dt_dev_pixelpipe_iop_t *)p->data;
+      if(merged_piece->enabled) merged_piece->dsc_out = merged_piece->dsc_in = *input_format;
+    }
 
     module->output_format(module, pipe, piece, &piece->dsc_out);
 
@@ -1361,6 +1537,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
                    (size_t)in_bpp * roi_in.width);
 #endif
 
+      if(input_format->datatype == TYPE_FLOAT)
+        dt_dev_pixelpipe_cache_set_intermediate(&(pipe->cache), input, 1);
       dt_pthread_mutex_unlock(&pipe->busy_mutex);
       return 0;
     }
@@ -2212,7 +2390,21 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       }
 
       /* process module on cpu. use tiling if needed and possible. */
-      if(piece->process_tiling_ready
+      if(merged)
+      {
+        if(dt_warp_process(&warp, dt_interpolation_new(DT_INTERPOLATION_USERPREF), (const float *)input,
+                           (float *)*output, &roi_in, roi_out))
+        {
+          // leave it to dt_dev_pixelpipe_process() to run the modules one by one
+          dt_dev_pixelpipe_cache_invalidate(&(pipe->cache), *output);
+          pipe->merge_error = 1;
+          dt_pthread_mutex_unlock(&pipe->busy_mutex);
+          return 1;
+        }
+        pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
+        pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+      }
+      else if(piece->process_tiling_ready
          && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
                                               MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
                                               tiling.factor, tiling.overhead))
@@ -2318,7 +2510,21 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     }
 
     /* process module on cpu. use tiling if needed and possible. */
-    if(piece->process_tiling_ready
+    if(merged)
+    {
+      if(dt_warp_process(&warp, dt_interpolation_new(DT_INTERPOLATION_USERPREF), (const float *)input,
+                         (float *)*output, &roi_in, roi_out))
+      {
+        // leave it to dt_dev_pixelpipe_process() to run the modules one by one
+        dt_dev_pixelpipe_cache_invalidate(&(pipe->cache), *output);
+        pipe->merge_error = 1;
+        dt_pthread_mutex_unlock(&pipe->busy_mutex);
+        return 1;
+      }
+      pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
+      pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+    }
+    else if(piece->process_tiling_ready
        && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
                                             MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
                                             tiling.factor, tiling.overhead))
@@ -2551,32 +2757,43 @@ post_process_collect_info:
     {
       // FIXME: input may not be available, so we use the output from gamma
       // this may lead to some rounding errors
+      float *input_tmp = NULL;
+      const dt_iop_roi_t *roi_hist = &roi_in;
       if(input == NULL)
       {
-        float *input_tmp = (float *)dt_alloc_align(64, roi_out->width * roi_out->height * 4 * sizeof(float));
-        const uint8_t *const pixel = (uint8_t *)*output;
-
-        const int imgsize = roi_out->height * roi_out->width * 4;
-        for(int i = 0; i < imgsize; i += 4)
+        input_tmp = (float *)dt_alloc_align(64, roi_out->width * roi_out->height * 4 * sizeof(float));
+        roi_hist = roi_out;
+        if(input_tmp)
         {
-          for(int c = 0; c < 3; c++) input_tmp[i + c] = ((float)pixel[i + (2 - c)]) * (1.0f / 255.0f);
-          input_tmp[i + 3] = 0.0f;
-        }
-
-        _pixelpipe_final_histogram(dev, (const float *const)input_tmp, roi_out);
+          const uint8_t *const pixel = (uint8_t *)*output;
 
-        dt_free_align(input_tmp);
+          const int imgsize = roi_out->height * roi_out->width * 4;
+          for(int i = 0; i < imgsize; i += 4)
+          {
+            for(int c = 0; c < 3; c++) input_tmp[i + c] = ((float)pixel[i + (2 - c)]) * (1.0f / 255.0f);
+            input_tmp[i + 3] = 0.0f;
+          }
+        }
       }
-      else
-        _pixelpipe_final_histogram(dev, (const float *const)input, &roi_in);
+      const float *const hist_src = input ? (const float *)input : input_tmp;
 
-      // this HAS to be done on the float input data, otherwise we get really ugly artifacts due to rounding
-      // issues when putting colors into the bins.
-      // FIXME: is above comment true now that waveform is scaled via Cairo?
-      if(input && dev->scope_type == DT_DEV_SCOPE_WAVEFORM)
+      if(hist_src)
       {
-        _pixelpipe_final_histogram_waveform(dev, (const float *const )input, &roi_in);
+        const dt_iop_order_iccprofile_info_t *profile_info = NULL;
+        float *hist_tmp = _pixelpipe_histogram_input(dev, hist_src, roi_hist, &profile_info);
+        const float *const hist_in = hist_tmp ? hist_tmp : hist_src;
+
+        _pixelpipe_final_histogram(dev, hist_in, roi_hist);
+
+        // this HAS to be done on the float input data, otherwise we get really ugly artifacts due to rounding
+        // issues when putting colors into the bins.
+        // FIXME: is above comment true now that waveform is scaled via Cairo?
+        if(input && (dev->scope_type == DT_DEV_SCOPE_WAVEFORM || dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE))
+          _pixelpipe_final_scopes(dev, hist_in, roi_hist, profile_info);
+
+        dt_free_align(hist_tmp);
       }
+      dt_free_align(input_tmp);
 
       dt_pthread_mutex_unlock(&pipe->busy_mutex);
     }
@@ -2584,6 +2801,11 @@ post_process_collect_info:
     {
       dt_pthread_mutex_unlock(&pipe->busy_mutex);
     }
+
+    // done with the input, it may be packed now. gamma writes 8 bit pixels whatever its format says, but its
+    // output is the end of the pipe and never comes back here as an input.
+    if(input && input_format->datatype == TYPE_FLOAT)
+      dt_dev_pixelpipe_cache_set_intermediate(&(pipe->cache), input, 1);
   }
 
   return 0;
@@ -2716,6 +2938,10 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
   GList *modules = g_list_last(pipe->iop);
   GList *pieces = g_list_last(pipe->nodes);
 
+  // try resampling runs of distortions in one pass again, the lack of memory may have been temporary
+  pipe->merge_distortions = 1;
+  pipe->merge_error = 0;
+
 // re-entry point: in case of late opencl errors we start all over again with opencl-support disabled
 restart:
 
@@ -2776,6 +3002,18 @@ restart:
     goto restart; // try again (this time without opencl)
   }
 
+  // the merged resampling of several distortions ran out of memory: redo them module by module
+  if(err && pipe->merge_error && !pipe->shutdown)
+  {
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    pipe->merge_distortions = 0;
+    pipe->merge_error = 0;
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    dt_print(DT_DEBUG_DEV, "[pixelpipe_process] [%s] falling back to processing distortions one by one\n",
+             _pipe_type_to_str(pipe->type));
+    goto restart;
+  }
+
   // release resources:
   if (pipe->forms)
   {
@@ -2794,6 +3032,9 @@ restart:
     return 1;
   }
 
+  // the output stays in use as the backbuf, whatever module produced it
+  dt_dev_pixelpipe_cache_set_intermediate(&(pipe->cache), buf, 0);
+
   // terminate
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
   pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
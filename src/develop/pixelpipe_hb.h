@@ -133,6 +133,10 @@ typedef struct dt_dev_pixelpipe_t
   int opencl_error;
   // running in a tiling context?
   int tiling;
+  // resample runs of distortions in one pass?
+  int merge_distortions;
+  // such a merged resampling failed?
+  int merge_error;
   // should this pixelpipe display a mask in the end?
   int mask_display;
   // should this pixelpipe completely suppressed the blendif module?
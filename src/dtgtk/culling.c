@@ -274,6 +274,7 @@ static void _thumbs_move(dt_culling_t *table, int move)
 
   if(new_offset != table->offset)
   {
+    table->navigation_direction = move < 0 ? -1 : 1;
     table->offset = new_offset;
     dt_culling_full_redraw(table, TRUE);
   }
@@ -883,27 +884,14 @@ void dt_culling_init(dt_culling_t *table, int offset)
   table->offset_imgid = first_id;
 }
 
-static void _thumbs_prefetch(dt_culling_t *table)
+// prefetch the count images following (or preceding) the ones currently shown
+static void _thumbs_prefetch_side(dt_culling_t *table, const gboolean next, const int count,
+                                  const dt_mipmap_size_t mip)
 {
-  if(!table || g_list_length(table->list) < 1) return;
-
-  // get the mip level by using the max image size actually shown
-  int maxw = 0;
-  int maxh = 0;
-  GList *l = table->list;
-  while(l)
-  {
-    dt_thumbnail_t *th = (dt_thumbnail_t *)l->data;
-    maxw = MAX(maxw, th->width);
-    maxh = MAX(maxh, th->height);
-    l = g_list_next(l);
-  }
-  dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
-
-  // prefetch next image
+  dt_thumbnail_t *th
+      = (dt_thumbnail_t *)(next ? g_list_last(table->list)->data : g_list_first(table->list)->data);
   gchar *query;
   sqlite3_stmt *stmt;
-  dt_thumbnail_t *last = (dt_thumbnail_t *)g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
     query
@@ -911,10 +899,10 @@ static void _thumbs_prefetch(dt_culling_t *table)
                           "SELECT m.imgid "
                           "FROM memory.collected_images AS m, main.selected_images AS s "
                           "WHERE m.imgid = s.imgid"
-                          " AND m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
+                          " AND m.rowid %s (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
+                          "ORDER BY m.rowid %s "
+                          "LIMIT %d",
+                          next ? ">" : "<", th->imgid, next ? "" : "DESC", count);
   }
   else
   {
@@ -922,51 +910,50 @@ static void _thumbs_prefetch(dt_culling_t *table)
         = dt_util_dstrcat(NULL,
                           "SELECT m.imgid "
                           "FROM memory.collected_images AS m "
-                          "WHERE m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
+                          "WHERE m.rowid %s (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
+                          "ORDER BY m.rowid %s "
+                          "LIMIT %d",
+                          next ? ">" : "<", th->imgid, next ? "" : "DESC", count);
   }
+  GList *ids = NULL;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    if(id > 0) ids = g_list_prepend(ids, GINT_TO_POINTER(id));
   }
   sqlite3_finalize(stmt);
   g_free(query);
 
-  // prefetch previous image
-  dt_thumbnail_t *prev = (dt_thumbnail_t *)g_list_first(table->list)->data;
-  if(table->navigate_inside_selection)
-  {
-    query
-        = dt_util_dstrcat(NULL,
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m, main.selected_images AS s "
-                          "WHERE m.imgid = s.imgid"
-                          " AND m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
-  }
-  else
-  {
-    query
-        = dt_util_dstrcat(NULL,
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
-  }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  // farthest first, the closest image ends up on top of the prefetch stack
+  for(GList *l = ids; l; l = g_list_next(l))
+    dt_mipmap_cache_get(darktable.mipmap_cache, NULL, GPOINTER_TO_INT(l->data), mip, DT_MIPMAP_PREFETCH, 'r');
+  g_list_free(ids);
+}
+
+static void _thumbs_prefetch(dt_culling_t *table)
+{
+  if(!table || g_list_length(table->list) < 1) return;
+
+  // get the mip level by using the max image size actually shown
+  int maxw = 0;
+  int maxh = 0;
+  GList *l = table->list;
+  while(l)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    dt_thumbnail_t *th = (dt_thumbnail_t *)l->data;
+    maxw = MAX(maxw, th->width);
+    maxh = MAX(maxh, th->height);
+    l = g_list_next(l);
   }
+  dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
+
+  // the images in navigation direction are loaded first and further ahead than the other side.
+  // prefetch jobs run in reverse order, so the side we move to is queued last.
+  const int ahead = CLAMP(dt_conf_get_int("plugins/lighttable/culling/decode_ahead"), 1, 16);
+  const gboolean forward = table->navigation_direction >= 0;
+  _thumbs_prefetch_side(table, !forward, forward ? 1 : ahead, mip);
+  _thumbs_prefetch_side(table, forward, forward ? ahead : 1, mip);
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table, const int offset)
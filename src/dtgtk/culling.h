@@ -56,6 +56,7 @@ typedef struct dt_culling_t
   GdkRectangle thumbs_area;    // coordinate of all the currently loaded thumbs area
 
   gboolean navigate_inside_selection; // do we navigate inside selection or inside full collection
+  int navigation_direction;           // direction of the last move (1 or -1), used to prefetch images
   gboolean selection_sync;            // should the selection follow current culling images
 
   gboolean select_desactivate;
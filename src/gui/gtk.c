@@ -940,6 +940,27 @@ static gboolean quit_callback(GtkAccelGroup *accel_group, GObject *acceleratable
   return TRUE; // for the sake of completeness ...
 }
 
+static gboolean _job_stats_accel_callback(GtkAccelGroup *accel_group, GObject *acceleratable, guint keyval,
+                                          GdkModifierType modifier, gpointer data)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *filename = g_build_filename(cachedir, "job_stats.json", NULL);
+  gchar *job_stats = dt_control_jobs_stats_json(darktable.control);
+  GError *error = NULL;
+  if(g_file_set_contents(filename, job_stats, -1, &error))
+    dt_control_log(_("job statistics written to `%s'"), filename);
+  else
+  {
+    dt_control_log(_("failed to write job statistics to `%s'"), filename);
+    fprintf(stderr, "[job stats] can't write `%s': %s\n", filename, error->message);
+    g_error_free(error);
+  }
+  g_free(job_stats);
+  g_free(filename);
+  return TRUE;
+}
+
 #ifdef MAC_INTEGRATION
 #ifdef GTK_TYPE_OSX_APPLICATION
 static gboolean osx_quit_callback(GtkOSXApplication *OSXapp, gpointer user_data)
@@ -1369,6 +1390,11 @@ int dt_gui_gtk_init(dt_gui_gtk_t *gui)
   dt_accel_connect_global("toggle focus peaking",
                           g_cclosure_new(G_CALLBACK(_focuspeaking_switch_key_accel_callback), NULL, NULL));
 
+  // dump the job system statistics
+  dt_accel_register_global(NC_("accel", "write job statistics"), 0, 0);
+  dt_accel_connect_global("write job statistics",
+                          g_cclosure_new(G_CALLBACK(_job_stats_accel_callback), NULL, NULL));
+
   // View-switch
   dt_accel_register_global(NC_("accel", "switch view"), GDK_KEY_period, 0);
 
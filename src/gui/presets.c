@@ -78,9 +78,12 @@ typedef struct dt_gui_presets_edit_dialog_t
 // so beware, don't use any darktable.gui stuff here .. (or change this behaviour in darktable.c)
 void dt_gui_presets_init()
 {
-  // remove auto generated presets from plugins, not the user included ones.
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM data.presets WHERE writeprotect = 1", NULL,
-                        NULL, NULL);
+  // remove auto generated presets from plugins, not the user included ones. the ones of processing modules
+  // with a presets stamp in db_info are kept, init_presets() replaces them when the stamp changes.
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                        "DELETE FROM data.presets WHERE writeprotect = 1"
+                        " AND NOT EXISTS (SELECT 1 FROM data.db_info WHERE key = 'presets/' || operation)",
+                        NULL, NULL, NULL);
 }
 
 void dt_gui_presets_add_generic(const char *name, dt_dev_operation_t op, const int32_t version,
@@ -377,16 +377,24 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
     }
   }
 
-  uint8_t *row = dt_alloc_align(64, (size_t)3 * jpg->global.width * sizeof(uint8_t));
-  const uint8_t *buf;
+  // pack a band of rows at a time, the rows of the input are contiguous
+  const size_t width = jpg->global.width;
+  uint8_t *row = dt_alloc_align(64, (size_t)3 * DT_IMAGEIO_PACK_ROWS * width * sizeof(uint8_t));
+  if(!row)
+  {
+    jpeg_destroy_compress(&(jpg->cinfo));
+    fclose(f);
+    return 1;
+  }
+  JSAMPROW tmp[DT_IMAGEIO_PACK_ROWS];
+  for(int k = 0; k < DT_IMAGEIO_PACK_ROWS; k++) tmp[k] = row + (size_t)3 * k * width;
   while(jpg->cinfo.next_scanline < jpg->cinfo.image_height)
   {
-    JSAMPROW tmp[1];
-    buf = in + (size_t)jpg->cinfo.next_scanline * jpg->cinfo.image_width * 4;
-    for(int i = 0; i < jpg->global.width; i++)
-      for(int k = 0; k < 3; k++) row[3 * i + k] = buf[4 * i + k];
-    tmp[0] = row;
-    jpeg_write_scanlines(&(jpg->cinfo), tmp, 1);
+    const JDIMENSION y = jpg->cinfo.next_scanline;
+    const JDIMENSION rows = MIN(DT_IMAGEIO_PACK_ROWS, jpg->cinfo.image_height - y);
+    dt_imageio_rgba_to_rgb_ui8(row, in + (size_t)4 * y * width, (size_t)rows * width);
+    for(JDIMENSION done = 0; done < rows;)
+      done += jpeg_write_scanlines(&(jpg->cinfo), tmp + done, rows - done);
   }
   jpeg_finish_compress(&(jpg->cinfo));
   dt_free_align(row);
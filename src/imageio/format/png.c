@@ -195,29 +195,34 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_write_info(png_ptr, info_ptr);
 
-  /*
-   * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
-   * RGB (4 channels -> 3 channels). The second parameter is not used.
-   */
-  png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
-
-  png_bytep *row_pointers = dt_alloc_align(64, (size_t)height * sizeof(png_bytep));
-
-  if(p->bpp > 8)
+  // get rid of the filler bytes ourselves, packing bands of rows in parallel instead of letting libpng
+  // strip them one row at a time
+  const size_t sample_size = p->bpp > 8 ? sizeof(uint16_t) : sizeof(uint8_t);
+  uint8_t *band = dt_alloc_align(64, (size_t)3 * DT_IMAGEIO_PACK_ROWS * width * sample_size);
+  if(!band)
   {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
-
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 1;
   }
-  else
+  png_bytep row_pointers[DT_IMAGEIO_PACK_ROWS];
+  for(int k = 0; k < DT_IMAGEIO_PACK_ROWS; k++) row_pointers[k] = band + (size_t)3 * k * width * sample_size;
+
+  /* swap bytes of 16 bit files to most significant bit first */
+  if(p->bpp > 8) png_set_swap(png_ptr);
+
+  for(int y = 0; y < height; y += DT_IMAGEIO_PACK_ROWS)
   {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+    const int rows = MIN(DT_IMAGEIO_PACK_ROWS, height - y);
+    if(p->bpp > 8)
+      dt_imageio_rgba_to_rgb_ui16((uint16_t *)band, (const uint16_t *)ivoid + (size_t)4 * y * width,
+                                  (size_t)rows * width);
+    else
+      dt_imageio_rgba_to_rgb_ui8(band, (const uint8_t *)ivoid + (size_t)4 * y * width, (size_t)rows * width);
+    png_write_rows(png_ptr, row_pointers, rows);
   }
 
-  png_write_image(png_ptr, row_pointers);
-
-  dt_free_align(row_pointers);
+  dt_free_align(band);
 
   png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
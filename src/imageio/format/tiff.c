@@ -247,7 +247,8 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   }
 
   const size_t rowsize = (d->global.width * layers) * d->bpp / 8;
-  if((rowdata = malloc(rowsize)) == NULL)
+  // the integer formats are packed a band of rows at a time
+  if((rowdata = malloc(rowsize * DT_IMAGEIO_PACK_ROWS)) == NULL)
   {
     rc = 1;
     goto exit;
@@ -272,41 +273,39 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
       }
     }
   }
-  else if(d->bpp == 16)
+  else
   {
-    for(int y = 0; y < d->global.height; y++)
+    const size_t width = d->global.width;
+    for(int y = 0; y < d->global.height; y += DT_IMAGEIO_PACK_ROWS)
     {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
+      const int rows = MIN(DT_IMAGEIO_PACK_ROWS, d->global.height - y);
+      const size_t npixels = (size_t)rows * width;
+      if(d->bpp == 16)
       {
-        memcpy(out, in, layers * sizeof(uint16_t));
+        const uint16_t *in = (const uint16_t *)in_void + (size_t)4 * y * width;
+        uint16_t *out = (uint16_t *)rowdata;
+        if(layers == 3)
+          dt_imageio_rgba_to_rgb_ui16(out, in, npixels);
+        else
+          for(size_t k = 0; k < npixels; k++) out[k] = in[4 * k];
       }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
+      else
       {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, layers * sizeof(uint8_t));
+        const uint8_t *in = (const uint8_t *)in_void + (size_t)4 * y * width;
+        uint8_t *out = (uint8_t *)rowdata;
+        if(layers == 3)
+          dt_imageio_rgba_to_rgb_ui8(out, in, npixels);
+        else
+          for(size_t k = 0; k < npixels; k++) out[k] = in[4 * k];
       }
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
+      for(int r = 0; r < rows; r++)
       {
-        rc = 1;
-        goto exit;
+        if(TIFFWriteScanline(tif, (uint8_t *)rowdata + r * rowsize, y + r, 0) == -1)
+        {
+          rc = 1;
+          goto exit;
+        }
       }
     }
   }
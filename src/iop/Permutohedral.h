@@ -125,10 +125,15 @@ public:
    *  kd_: the dimensionality of the position vectors on the hyperplane.
    *  vd_: the dimensionality of the value vectors
    */
-  HashTablePermutohedral()
+  HashTablePermutohedral(size_t min_fill = 0)
   {
     capacity = 1 << 15;
     capacity_bits = 0x7fff;
+    while(maxFill() < min_fill)
+    {
+      capacity *= 2;
+      capacity_bits = (capacity_bits << 1) | 1;
+    }
     filled = 0;
     entries = new Entry[capacity];
     keys = new Key[maxFill()];
@@ -201,6 +206,43 @@ public:
     }
   }
 
+  /* Same as lookupOffset(key, true), but safe to be called by several threads at once. The table
+   * never grows here, so it has to be constructed big enough for all keys that will be inserted.
+   * Cells being filled in by another thread are marked with -2 until the key is stored.
+   */
+  int lookupOffsetShared(const Key &key)
+  {
+    size_t h = key.hash & capacity_bits;
+    while(1)
+    {
+      int idx = __atomic_load_n(&entries[h].keyIdx, __ATOMIC_ACQUIRE);
+      if(idx == -1)
+      {
+        if(!__sync_bool_compare_and_swap(&entries[h].keyIdx, -1, -2)) continue; // lost the race, look again
+        const size_t offset = __sync_fetch_and_add(&filled, 1);
+        keys[offset] = key;
+        __atomic_store_n(&entries[h].keyIdx, (int)offset, __ATOMIC_RELEASE);
+        return offset;
+      }
+      while(idx == -2) idx = __atomic_load_n(&entries[h].keyIdx, __ATOMIC_ACQUIRE);
+
+      if(keys[idx] == key) return idx;
+
+      h = (h + 1) & capacity_bits;
+    }
+  }
+
+  /* Exchanges the contents of two tables. */
+  void swap(HashTablePermutohedral &other)
+  {
+    std::swap(keys, other.keys);
+    std::swap(values, other.values);
+    std::swap(entries, other.entries);
+    std::swap(capacity, other.capacity);
+    std::swap(filled, other.filled);
+    std::swap(capacity_bits, other.capacity_bits);
+  }
+
   /* Looks up the value vector associated with a given key vector.
    *        k : reference to the key vector to be looked up.
    *   create : true if a non-existing key should be created.
@@ -329,6 +371,8 @@ public:
     scaleFactor = scaleFactorTmp;
 
     hashTables = new HashTable[nThreads];
+    blurValues = nullptr;
+    blurValuesSize = 0;
   }
 
 
@@ -338,6 +382,7 @@ public:
     delete[] replay;
     delete[] canonical;
     delete[] hashTables;
+    delete[] blurValues;
   }
 
 
@@ -453,50 +498,55 @@ public:
   {
     if(nThreads <= 1) return;
 
-    /* Because growing the hash table is expensive, we want to avoid having to do it multiple times.
-     * Only a small percentage of entries in the individual hash tables have the same key, so we
-     * won't waste much space if we simply grow the destination table enough to hold the sum of the
-     * entries in the individual tables
+    /* The merged table can't have more entries than all the thread tables together. Sizing it for that
+     * up front means it never has to grow, so all threads can insert into it at the same time. Only a
+     * small percentage of entries in the individual hash tables have the same key, so we won't waste
+     * much space.
      */
-    size_t total_entries = hashTables[0].size();
-    for(int i = 1; i < nThreads; i++)
-      total_entries += hashTables[i].size();
-    int order = 0;
-    while (total_entries > hashTables[0].maxFill())
-    {
-      order++;
-      total_entries /= 2;
-    }
-    if (order > 0)
-       hashTables[0].grow(order);
-    /* Merge the multiple hash tables into one, creating an offset remap table. */
-    int **offset_remap = new int *[nThreads];
-    for(int i = 1; i < nThreads; i++)
+    size_t *first = new size_t[nThreads + 1];
+    first[0] = 0;
+    for(int i = 0; i < nThreads; i++) first[i + 1] = first[i] + hashTables[i].size();
+    HashTable merged(first[nThreads]);
+
+    /* The offsets of the entries of all tables in the merged one, in one block. */
+    int *offset_remap = new int[first[nThreads]];
+
+    /* The tables are merged one after the other, each one by all threads. Keys are unique within a table,
+     * so no two threads ever add to the same value and only the insertion into the merged table is shared.
+     * Summing the tables in order also gives the same values as merging them serially.
+     */
+    Value *const mergedVals = merged.getValues();
+    for(int i = 0; i < nThreads; i++)
     {
       const Key *oldKeys = hashTables[i].getKeys();
       const Value *oldVals = hashTables[i].getValues();
       const int filled = hashTables[i].size();
-      offset_remap[i] = new int[filled];
+      int *remap = offset_remap + first[i];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
       for(int j = 0; j < filled; j++)
       {
-        Value *val = hashTables[0].lookup(oldKeys[j], true);
-	val->add(oldVals[j]);
-        offset_remap[i][j] = val - hashTables[0].getValues();
+        const int offset = merged.lookupOffsetShared(oldKeys[j]);
+        mergedVals[offset] += oldVals[j];
+        remap[j] = offset;
       }
     }
 
     /* Rewrite the offsets in the replay structure from the above generated table. */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
     for(int i = 0; i < nData; i++)
     {
-      if(replay[i].table > 0)
-      {
-        for (int dim = 0; dim <= D; dim++)
-	  replay[i].offset[dim] = offset_remap[replay[i].table][replay[i].offset[dim]];
-      }
+      const int *remap = offset_remap + first[replay[i].table];
+      for(int dim = 0; dim <= D; dim++) replay[i].offset[dim] = remap[replay[i].offset[dim]];
     }
 
-    for(int i = 1; i < nThreads; i++) delete[] offset_remap[i];
+    hashTables[0].swap(merged);
+
     delete[] offset_remap;
+    delete[] first;
   }
 
   /* Performs slicing out of position vectors. Note that the barycentric weights and the simplex
@@ -517,8 +567,16 @@ public:
   /* Performs a Gaussian blur along each projected axis in the hyperplane. */
   void blur()
   {
-    // Prepare arrays
-    Value *newValue = new Value[hashTables[0].size()];
+    const int size = hashTables[0].size();
+
+    // Prepare arrays. the second one is kept with the lattice and only reallocated if it is too small.
+    if(blurValuesSize < (size_t)size)
+    {
+      delete[] blurValues;
+      blurValues = new Value[size];
+      blurValuesSize = size;
+    }
+    Value *newValue = blurValues;
     Value *oldValue = hashTables[0].getValues();
     const Value *hashTableBase = oldValue;
     const Key *keyBase = hashTables[0].getKeys();
@@ -528,11 +586,12 @@ public:
     // For each of d+1 axes,
     for(int j = 0; j <= D; j++)
     {
+      // lookups don't create entries here, so the table is only read and all vertices are independent
 #ifdef _OPENMP
-#pragma omp parallel for shared(j, oldValue, newValue)
+#pragma omp parallel for shared(j, oldValue, newValue) schedule(static)
 #endif
       // For each vertex in the lattice,
-      for(int i = 0; i < hashTables[0].size(); i++) // blur point i in dimension j
+      for(int i = 0; i < size; i++) // blur point i in dimension j
       {
         const Key &key = keyBase[i]; // keys to current vertex
 	// construct keys to the neighbors along the given axis.
@@ -555,15 +614,7 @@ public:
     }
 
     // depending where we ended up, we may have to copy data
-    if(oldValue != hashTableBase)
-    {
-      std::copy(oldValue, oldValue+hashTables[0].size(), hashTables[0].getValues());
-      delete[] oldValue;
-    }
-    else
-    {
-      delete[] newValue;
-    }
+    if(oldValue != hashTableBase) std::copy(oldValue, oldValue + size, hashTables[0].getValues());
   }
 
 private:
@@ -583,6 +634,10 @@ private:
   } *replay;
 
   HashTable *hashTables;
+
+  // the second value array the blur ping-pongs with
+  Value *blurValues;
+  size_t blurValuesSize;
 };
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -25,6 +25,7 @@
 #include "common/debug.h"
 #include "common/interpolation.h"
 #include "common/opencl.h"
+#include "common/warp.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
@@ -949,20 +950,12 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   return 1;
 }
 
-void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
-                  float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+// the mapping of process(): output pixel -> original image coordinates -> inverted homography -> input pixel
+static void _ashift_warp(dt_warp_t *w, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                         const dt_iop_roi_t *const roi_out)
 {
   dt_iop_ashift_data_t *data = (dt_iop_ashift_data_t *)piece->data;
 
-  // if module is set to neutral parameters we just copy input->output and are done
-  if(isneutral(data))
-  {
-    memcpy(out, in, (size_t)roi_out->width * roi_out->height * sizeof(float));
-    return;
-  }
-
-  const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-
   float ihomograph[3][3];
   homography((float *)ihomograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear, data->f_length_kb,
              data->orthocorr, data->aspect, piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_INVERTED);
@@ -973,44 +966,33 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
   const float cx = roi_out->scale * fullwidth * data->cl;
   const float cy = roi_out->scale * fullheight * data->ct;
 
+  double h[9];
+  for(int k = 0; k < 9; k++) h[k] = ihomograph[k / 3][k % 3];
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(cx, cy, in, out, roi_in, roi_out) \
-  shared(ihomograph, interpolation) \
-  schedule(static)
-#endif
-  // go over all pixels of output image
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *_out = out + (size_t)j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++, _out++)
-    {
-      float pin[3], pout[3];
-
-      // convert output pixel coordinates to original image coordinates
-      pout[0] = roi_out->x + i + cx;
-      pout[1] = roi_out->y + j + cy;
-      pout[0] /= roi_out->scale;
-      pout[1] /= roi_out->scale;
-      pout[2] = 1.0f;
-
-      // apply homograph
-      mat3mulv(pin, (float *)ihomograph, pout);
+  dt_warp_init(w);
+  dt_warp_translate(w, roi_out->x + cx, roi_out->y + cy);
+  dt_warp_scale(w, 1.0 / roi_out->scale, 1.0 / roi_out->scale);
+  dt_warp_homography(w, h);
+  dt_warp_scale(w, roi_in->scale, roi_in->scale);
+  dt_warp_translate(w, -roi_in->x, -roi_in->y);
+}
 
-      // convert to input pixel coordinates
-      pin[0] /= pin[2];
-      pin[1] /= pin[2];
-      pin[0] *= roi_in->scale;
-      pin[1] *= roi_in->scale;
-      pin[0] -= roi_in->x;
-      pin[1] -= roi_in->y;
+void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                  float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_ashift_data_t *data = (dt_iop_ashift_data_t *)piece->data;
 
-      // get output values by interpolation from input image
-      dt_interpolation_compute_pixel1c(interpolation, in, _out, pin[0], pin[1], roi_in->width,
-                                       roi_in->height, roi_in->width);
-    }
+  // if module is set to neutral parameters we just copy input->output and are done
+  if(isneutral(data))
+  {
+    memcpy(out, in, (size_t)roi_out->width * roi_out->height * sizeof(float));
+    return;
   }
+
+  const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  dt_warp_t w;
+  _ashift_warp(&w, piece, roi_in, roi_out);
+  dt_warp_process_1c(&w, interpolation, in, out, roi_in, roi_out);
 }
 
 void modify_roi_out(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, dt_iop_roi_t *roi_out,
@@ -2852,6 +2834,21 @@ error:
 }
 
 
+int distort_warp(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                 const dt_iop_roi_t *const roi_out, dt_warp_t *w)
+{
+  dt_iop_ashift_data_t *data = (dt_iop_ashift_data_t *)piece->data;
+
+  // process() keeps a copy of the preview input for the fitting
+  if(self->dev->gui_attached && self->gui_data && piece->pipe->type == DT_DEV_PIXELPIPE_PREVIEW) return 0;
+
+  if(isneutral(data))
+    dt_warp_init(w);
+  else
+    _ashift_warp(w, piece, roi_in, roi_out);
+  return 1;
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -2859,7 +2856,6 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)self->gui_data;
 
   const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
 
   // only for preview pipe: collect input buffer data and do some other evaluations
   if(self->dev->gui_attached && g && piece->pipe->type == DT_DEV_PIXELPIPE_PREVIEW)
@@ -2930,55 +2926,9 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   }
 
   const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-
-  float ihomograph[3][3];
-  homography((float *)ihomograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear, data->f_length_kb,
-             data->orthocorr, data->aspect, piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_INVERTED);
-
-  // clipping offset
-  const float fullwidth = (float)piece->buf_out.width / (data->cr - data->cl);
-  const float fullheight = (float)piece->buf_out.height / (data->cb - data->ct);
-  const float cx = roi_out->scale * fullwidth * data->cl;
-  const float cy = roi_out->scale * fullheight * data->ct;
-
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ch, ch_width, cx, cy, ivoid, ovoid, roi_in, roi_out) \
-  shared(ihomograph, interpolation) \
-  schedule(static)
-#endif
-  // go over all pixels of output image
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *out = ((float *)ovoid) + (size_t)ch * j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++, out += ch)
-    {
-      float pin[3], pout[3];
-
-      // convert output pixel coordinates to original image coordinates
-      pout[0] = roi_out->x + i + cx;
-      pout[1] = roi_out->y + j + cy;
-      pout[0] /= roi_out->scale;
-      pout[1] /= roi_out->scale;
-      pout[2] = 1.0f;
-
-      // apply homograph
-      mat3mulv(pin, (float *)ihomograph, pout);
-
-      // convert to input pixel coordinates
-      pin[0] /= pin[2];
-      pin[1] /= pin[2];
-      pin[0] *= roi_in->scale;
-      pin[1] *= roi_in->scale;
-      pin[0] -= roi_in->x;
-      pin[1] -= roi_in->y;
-
-      // get output values by interpolation from input image
-      dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out, pin[0], pin[1], roi_in->width,
-                                       roi_in->height, ch_width);
-    }
-  }
+  dt_warp_t w;
+  _ashift_warp(&w, piece, roi_in, roi_out);
+  dt_warp_process(&w, interpolation, (const float *)ivoid, (float *)ovoid, roi_in, roi_out);
 }
 
 #ifdef HAVE_OPENCL
@@ -22,6 +22,7 @@
 #include "common/colorspaces_inline_conversions.h"
 #include "common/debug.h"
 #include "common/opencl.h"
+#include "common/pyramid.h"
 #include "common/rgb_norms.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -395,6 +396,12 @@ static void set_presets(dt_iop_module_so_t *self, const basecurve_preset_t *pres
   }
 }
 
+char *presets_stamp(dt_iop_module_so_t *self)
+{
+  // set_presets() decides about auto-applying the camera presets with this
+  return g_strdup_printf("%d", dt_conf_get_bool("plugins/darkroom/basecurve/auto_apply_percamera_presets"));
+}
+
 void init_presets(dt_iop_module_so_t *self)
 {
   // sql begin
@@ -1046,112 +1053,6 @@ static inline void compute_features(
   }
 }
 
-static inline void gauss_blur(
-    const float *const input,
-    float *const output,
-    const size_t wd,
-    const size_t ht)
-{
-  const float w[5] = { 1.f / 16.f, 4.f / 16.f, 6.f / 16.f, 4.f / 16.f, 1.f / 16.f };
-  float *tmp = dt_alloc_align(64, (size_t)wd*ht*4*sizeof(float));
-  memset(tmp, 0, 4*wd*ht*sizeof(float));
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ht, input, w, wd) \
-  shared(tmp) \
-  schedule(static)
-#endif
-  for(int j=0;j<ht;j++)
-  { // horizontal pass
-    // left borders
-    for(int i=0;i<2;i++) for(int c=0;c<4;c++)
-      for(int ii=-2;ii<=2;ii++)
-        tmp[4*(j*wd+i)+c] += input[4*(j*wd+MAX(-i-ii,i+ii))+c] * w[ii+2];
-    // most pixels
-    for(int i=2;i<wd-2;i++) for(int c=0;c<4;c++)
-      for(int ii=-2;ii<=2;ii++)
-        tmp[4*(j*wd+i)+c] += input[4*(j*wd+i+ii)+c] * w[ii+2];
-    // right borders
-    for(int i=wd-2;i<wd;i++) for(int c=0;c<4;c++)
-      for(int ii=-2;ii<=2;ii++)
-        tmp[4*(j*wd+i)+c] += input[4*(j*wd+MIN(i+ii, wd-(i+ii-wd+1) ))+c] * w[ii+2];
-  }
-  memset(output, 0, 4*wd*ht*sizeof(float));
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ht, output, w, wd) \
-  shared(tmp) \
-  schedule(static)
-#endif
-  for(int i=0;i<wd;i++)
-  { // vertical pass
-    for(int j=0;j<2;j++) for(int c=0;c<4;c++)
-      for(int jj=-2;jj<=2;jj++)
-        output[4*(j*wd+i)+c] += tmp[4*(MAX(-j-jj,j+jj)*wd+i)+c] * w[jj+2];
-    for(int j=2;j<ht-2;j++) for(int c=0;c<4;c++)
-      for(int jj=-2;jj<=2;jj++)
-        output[4*(j*wd+i)+c] += tmp[4*((j+jj)*wd+i)+c] * w[jj+2];
-    for(int j=ht-2;j<ht;j++) for(int c=0;c<4;c++)
-      for(int jj=-2;jj<=2;jj++)
-        output[4*(j*wd+i)+c] += tmp[4*(MIN(j+jj, ht-(j+jj-ht+1))*wd+i)+c] * w[jj+2];
-  }
-  dt_free_align(tmp);
-}
-
-static inline void gauss_expand(
-    const float *const input, // coarse input
-    float *const fine,        // upsampled, blurry output
-    const size_t wd,          // fine res
-    const size_t ht)
-{
-  const size_t cw = (wd-1)/2+1;
-  // fill numbers in even pixels, zero odd ones
-  memset(fine, 0, 4*wd*ht*sizeof(float));
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(cw, fine, ht, input, wd) \
-  schedule(static) \
-  collapse(2)
-#endif
-  for(int j=0;j<ht;j+=2)
-    for(int i=0;i<wd;i+=2)
-      for(int c=0;c<4;c++)
-        fine[4*(j*wd+i)+c] = 4.0f * input[4*(j/2*cw + i/2)+c];
-
-  // convolve with same kernel weights mul by 4:
-  gauss_blur(fine, fine, wd, ht);
-}
-
-// XXX FIXME: we'll need to pad up the image to get a good boundary condition!
-// XXX FIXME: downsampling will not result in an energy conserving pattern (every 4 pixels one sample)
-// XXX FIXME: neither will a mirror boundary condition (mirrors in subsampled values at random density)
-// TODO: copy laplacian code from local laplacian filters, it's faster.
-static inline void gauss_reduce(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    float *const detail,      // detail/laplacian, fine scale, or 0
-    const size_t wd,
-    const size_t ht)
-{
-  // blur, store only coarse res
-  const size_t cw = (wd-1)/2+1, ch = (ht-1)/2+1;
-
-  float *blurred = dt_alloc_align(64, (size_t)wd*ht*4*sizeof(float));
-  gauss_blur(input, blurred, wd, ht);
-  for(size_t j=0;j<ch;j++) for(size_t i=0;i<cw;i++)
-    for(int c=0;c<4;c++) coarse[4*(j*cw+i)+c] = blurred[4*(2*j*wd+2*i)+c];
-  dt_free_align(blurred);
-
-  if(detail)
-  {
-    // compute laplacian/details: expand coarse buffer into detail
-    // buffer subtract expanded buffer from input in place
-    gauss_expand(coarse, detail, wd, ht);
-    for(size_t k=0;k<wd*ht*4;k++)
-      detail[k] = input[k] - detail[k];
-  }
-}
-
 void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                     void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -1163,17 +1064,12 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   // allocate temporary buffer for wavelet transform + blending
   const int wd = roi_in->width, ht = roi_in->height;
   int num_levels = 8;
-  float **col = malloc(num_levels * sizeof(float *));
-  float **comb = malloc(num_levels * sizeof(float *));
   int w = wd, h = ht;
   const int rad = MIN(wd, (int)ceilf(256 * roi_in->scale / piece->iscale));
   int step = 1;
   for(int k = 0; k < num_levels; k++)
   {
     // coarsest step is some % of image width.
-    col[k] = dt_alloc_align(64, sizeof(float) * 4 * w * h);
-    comb[k] = dt_alloc_align(64, sizeof(float) * 4 * w * h);
-    memset(comb[k], 0, sizeof(float) * 4 * w * h);
     w = (w - 1) / 2 + 1;
     h = (h - 1) / 2 + 1;
     step *= 2;
@@ -1183,6 +1079,13 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       break;
     }
   }
+  dt_pyramid_t *const col_pyramid = dt_pyramid_alloc(wd, ht, 4, num_levels);
+  dt_pyramid_t *const comb_pyramid = dt_pyramid_alloc(wd, ht, 4, num_levels);
+  if(!col_pyramid || !comb_pyramid) goto error;
+  float **col = col_pyramid->level;
+  float **comb = comb_pyramid->level;
+  for(int k = 0; k < num_levels; k++)
+    memset(comb[k], 0, sizeof(float) * 4 * comb_pyramid->width[k] * comb_pyramid->height[k]);
 
   for(int e = 0; e < d->exposure_fusion + 1; e++)
   {
@@ -1201,7 +1104,9 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
     // create gaussian pyramid of colour buffer
     w = wd;
     h = ht;
-    gauss_reduce(col[0], col[1], out, w, h);
+    if(dt_pyramid_reduce(col[0], col[1], w, h, 4, DT_PYRAMID_BORDER_MIRROR)
+       || dt_pyramid_detail(col[0], col[1], out, w, h, 4, DT_PYRAMID_BORDER_MIRROR))
+      goto error;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
     dt_omp_firstprivate(ht, out, wd) \
@@ -1224,7 +1129,7 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 
     for(int k = 1; k < num_levels; k++)
     {
-      gauss_reduce(col[k - 1], col[k], 0, w, h);
+      if(dt_pyramid_reduce(col[k - 1], col[k], w, h, 4, DT_PYRAMID_BORDER_MIRROR)) goto error;
       w = (w - 1) / 2 + 1;
       h = (h - 1) / 2 + 1;
     }
@@ -1232,15 +1137,11 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
     // update pyramid coarse to fine
     for(int k = num_levels - 1; k >= 0; k--)
     {
-      w = wd;
-      h = ht;
-      for(int i = 0; i < k; i++)
-      {
-        w = (w - 1) / 2 + 1;
-        h = (h - 1) / 2 + 1;
-      }
+      w = col_pyramid->width[k];
+      h = col_pyramid->height[k];
       // abuse output buffer as temporary memory:
-      if(k != num_levels - 1) gauss_expand(col[k + 1], out, w, h);
+      if(k != num_levels - 1 && dt_pyramid_expand(col[k + 1], out, w, h, 4, DT_PYRAMID_BORDER_MIRROR))
+        goto error;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(out) \
@@ -1269,13 +1170,8 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   // normalise and reconstruct output pyramid buffer coarse to fine
   for(int k = num_levels - 1; k >= 0; k--)
   {
-    w = wd;
-    h = ht;
-    for(int i = 0; i < k; i++)
-    {
-      w = (w - 1) / 2 + 1;
-      h = (h - 1) / 2 + 1;
-    }
+    w = comb_pyramid->width[k];
+    h = comb_pyramid->height[k];
 
     // normalise both gaussian base and laplacians:
 #ifdef _OPENMP
@@ -1285,22 +1181,9 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       if(comb[k][i + 3] > 1e-8f)
         for(int c = 0; c < 3; c++) comb[k][i + c] /= comb[k][i + 3];
 
-    if(k < num_levels - 1)
-    { // reconstruct output image
-      gauss_expand(comb[k + 1], out, w, h);
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(out) \
-      shared(comb, w, h, k) \
-      schedule(static)
-#endif
-      for(int j = 0; j < h; j++)
-        for(int i = 0; i < w; i++)
-        {
-          const size_t x = 4ul * (w * j + i);
-          for(int c = 0; c < 3; c++) comb[k][x + c] += out[x + c];
-        }
-    }
+    if(k < num_levels - 1 // reconstruct output image
+       && dt_pyramid_collapse(comb[k + 1], comb[k], w, h, 4, DT_PYRAMID_BORDER_MIRROR))
+      goto error;
   }
 #endif
   // copy output buffer
@@ -1318,14 +1201,15 @@ void process_fusion(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
     out[k + 3] = in[k + 3]; // pass on 4th channel
   }
 
-  // free temp buffers
-  for(int k = 0; k < num_levels; k++)
-  {
-    dt_free_align(col[k]);
-    dt_free_align(comb[k]);
-  }
-  free(col);
-  free(comb);
+  dt_pyramid_free(col_pyramid);
+  dt_pyramid_free(comb_pyramid);
+  return;
+
+error:
+  dt_pyramid_free(col_pyramid);
+  dt_pyramid_free(comb_pyramid);
+  dt_control_log(_("base curve failed to allocate memory, check your RAM settings"));
+  memcpy(ovoid, ivoid, sizeof(float) * 4 * wd * ht);
 }
 
 void process_lut(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
@@ -101,6 +101,68 @@ void connect_key_accels(dt_iop_module_t *self)
   dt_accel_connect_slider_iop(self, "blue", GTK_WIDGET(g->scale5));
 }
 
+// the direct kernel costs the square of the radius per pixel, the lattice gets cheaper with larger radii. on
+// smooth images they break even at a radius of about 8, on noisy ones (many lattice points) at about 13. the
+// crossover is fixed so that the same edit always renders the same way.
+#define BILATERAL_DIRECT_MAX_RADIUS 8
+
+// brute force bilateral filter on the inner part of the image, leaving a border of rad pixels unprocessed.
+// the spatial weights are tabulated once, the range weights use a fast exp, and weights and weighted colors
+// are accumulated in one pass over the window so the inner loop over a row of the window vectorizes. each
+// thread works on a contiguous block of rows, so the window rows stay in cache from one row to the next.
+static void _process_direct(const float *const in, float *const out, const int width, const int height,
+                            const int ch, const int rad, const float sigma_s, const float isig2col[3])
+{
+  const int wd = 2 * rad + 1;
+  float *const m = (float *)dt_alloc_align(64, sizeof(float) * wd * wd);
+  for(int l = -rad; l <= rad; l++)
+    for(int k = -rad; k <= rad; k++)
+      m[(l + rad) * wd + k + rad] = expf(-(l * l + k * k) / (2.f * sigma_s * sigma_s));
+  const float is0 = isig2col[0], is1 = isig2col[1], is2 = isig2col[2];
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(ch, in, out, rad, width, height, wd, m, is0, is1, is2) \
+    schedule(static)
+#endif
+  for(int j = rad; j < height - rad; j++)
+  {
+    for(int i = rad; i < width - rad; i++)
+    {
+      const float *const center = in + (size_t)ch * ((size_t)j * width + i);
+      const float c0 = center[0], c1 = center[1], c2 = center[2];
+      float sumw = 0.0f, s0 = 0.0f, s1 = 0.0f, s2 = 0.0f;
+      for(int l = 0; l < wd; l++)
+      {
+        const float *const row = in + (size_t)ch * ((size_t)(j + l - rad) * width + i - rad);
+        const float *const ml = m + (size_t)l * wd;
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : sumw, s0, s1, s2)
+#endif
+        for(int k = 0; k < wd; k++)
+        {
+          const float *const p = row + (size_t)ch * k;
+          const float d0 = c0 - p[0], d1 = c1 - p[1], d2 = c2 - p[2];
+          const float x = -(d0 * d0 * is0 + d1 * d1 * is1 + d2 * d2 * is2);
+          const float w = ml[k] * dt_fast_expf(fmaxf(x, -100.0f));
+          sumw += w;
+          s0 += w * p[0];
+          s1 += w * p[1];
+          s2 += w * p[2];
+        }
+      }
+      // the center pixel has a weight of 1, so sumw is never 0
+      float *const o = out + (size_t)ch * ((size_t)j * width + i);
+      const float norm = 1.0f / sumw;
+      o[0] = s0 * norm;
+      o[1] = s1 * norm;
+      o[2] = s2 * norm;
+    }
+  }
+
+  dt_free_align(m);
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -119,72 +181,18 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     return;
   }
 
-  // if rad <= 6 use naive version!
   const int rad = (int)(3.0 * fmaxf(sigma[0], sigma[1]) + 1.0);
   if(rad <= 6 && (piece->pipe->type == DT_DEV_PIXELPIPE_THUMBNAIL))
   {
     // no use denoising the thumbnail. takes ages without permutohedral
     memcpy(ovoid, ivoid, (size_t)sizeof(float) * ch * roi_out->width * roi_out->height);
   }
-  else if(rad <= 6)
+  else if(rad <= BILATERAL_DIRECT_MAX_RADIUS && roi_out->width > 2 * rad && roi_out->height > 2 * rad)
   {
-    static const size_t weights_size = 2 * (6 + 1) * 2 * (6 + 1);
-    float mat[weights_size];
-    const int wd = 2 * rad + 1;
-    float *m = mat + rad * wd + rad;
-    float weight = 0.0f;
     const float isig2col[3] = { 1.f / (2.0f * sigma[2] * sigma[2]), 1.f / (2.0f * sigma[3] * sigma[3]),
                                 1.f / (2.0f * sigma[4] * sigma[4]) };
-    // init gaussian kernel
-    for(int l = -rad; l <= rad; l++)
-      for(int k = -rad; k <= rad; k++)
-        weight += m[l * wd + k] = expf(-(l * l + k * k) / (2.f * sigma[0] * sigma[0]));
-    for(int l = -rad; l <= rad; l++)
-      for(int k = -rad; k <= rad; k++) m[l * wd + k] /= weight;
-
-    float *const weights_buf = (float *)malloc(weights_size * dt_get_num_threads() * sizeof(float));
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(ch, ivoid, ovoid, rad, roi_in, roi_out, wd, weights_buf) \
-    shared(m, mat, isig2col) \
-    schedule(static)
-#endif
-    for(int j = rad; j < roi_out->height - rad; j++)
-    {
-      const float *in = ((float *)ivoid) + ch * ((size_t)j * roi_in->width + rad);
-      float *out = ((float *)ovoid) + ch * ((size_t)j * roi_out->width + rad);
-      float *weights = weights_buf + weights_size * dt_get_thread_num();
-      float *w = weights + rad * wd + rad;
-      float sumw;
-      for(int i = rad; i < roi_out->width - rad; i++)
-      {
-        sumw = 0.0f;
-        for(int l = -rad; l <= rad; l++)
-          for(int k = -rad; k <= rad; k++)
-          {
-	    const float *inp = in + ch * (l * roi_in->width + k);
-            sumw += w[l * wd + k] = m[l * wd + k]
-                                    * expf(-((in[0] - inp[0]) * (in[0] - inp[0]) * isig2col[0]
-                                             + (in[1] - inp[1]) * (in[1] - inp[1]) * isig2col[1]
-                                             + (in[2] - inp[2]) * (in[2] - inp[2]) * isig2col[2]));
-          }
-        for(int l = -rad; l <= rad; l++)
-          for(int k = -rad; k <= rad; k++) w[l * wd + k] /= sumw;
-        for(int c = 0; c < 3; c++) out[c] = 0.0f;
-        for(int l = -rad; l <= rad; l++)
-          for(int k = -rad; k <= rad; k++)
-          {
-            const float *inp = in + ch * ((size_t)l * roi_in->width + k);
-            float pix_weight = w[(size_t)l * wd + k];
-            for(int c = 0; c < 3; c++) out[c] += inp[c] * pix_weight;
-          }
-        out += ch;
-        in += ch;
-      }
-    }
-
-    free((void *)weights_buf);
+    _process_direct((const float *)ivoid, (float *)ovoid, roi_in->width, roi_in->height, ch, rad, sigma[0],
+                    isig2col);
 
     // fill unprocessed border
     for(int j = 0; j < rad; j++)
@@ -207,6 +215,8 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   {
     for(int k = 0; k < 5; k++) sigma[k] = 1.0f / sigma[k];
     PermutohedralLattice<5, 4> lattice((size_t)roi_in->width * roi_in->height, omp_get_max_threads());
+    dt_times_t start;
+    dt_get_times(&start);
 
 // splat into the lattice
 #ifdef _OPENMP
@@ -226,11 +236,20 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       }
     }
 
+    dt_show_times(&start, "[bilateral] splat");
+    dt_get_times(&start);
+
     lattice.merge_splat_threads();
 
+    dt_show_times(&start, "[bilateral] merge");
+    dt_get_times(&start);
+
     // blur the lattice
     lattice.blur();
 
+    dt_show_times(&start, "[bilateral] blur");
+    dt_get_times(&start);
+
 // slice from the lattice
 #ifdef _OPENMP
 #pragma omp parallel for
@@ -247,6 +266,8 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
         out += ch;
       }
     }
+
+    dt_show_times(&start, "[bilateral] slice");
   }
 
   if(piece->pipe->mask_display) dt_iop_alpha_copy(ivoid, ovoid, roi_out->width, roi_out->height);
@@ -23,6 +23,7 @@
 #include "common/debug.h"
 #include "common/interpolation.h"
 #include "common/opencl.h"
+#include "common/warp.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -413,6 +414,104 @@ static inline void transform(float *x, float *o, const float *m, const float t_h
 }
 
 
+// everything the per pixel mapping of process() needs
+typedef struct _clipping_warp_t
+{
+  const dt_iop_clipping_data_t *d;
+  const dt_iop_roi_t *roi_in, *roi_out;
+  float k_space[4];
+  float kxa, kya;
+  float ma, mb, md, me, mg, mh;
+} _clipping_warp_t;
+
+// maps a pixel of roi_out to roi_in, only needed with the legacy keystone correction
+static void _clipping_backtransform(const void *data, float *p)
+{
+  const _clipping_warp_t *cw = (const _clipping_warp_t *)data;
+  const dt_iop_clipping_data_t *d = cw->d;
+  const dt_iop_roi_t *const roi_in = cw->roi_in;
+  const dt_iop_roi_t *const roi_out = cw->roi_out;
+  float pi[2], po[2];
+
+  pi[0] = roi_out->x - roi_out->scale * d->enlarge_x + roi_out->scale * d->cix + p[0] + 0.5f;
+  pi[1] = roi_out->y - roi_out->scale * d->enlarge_y + roi_out->scale * d->ciy + p[1] + 0.5f;
+
+  // transform this point using matrix m
+  if(d->flip)
+  {
+    pi[1] -= d->tx * roi_out->scale;
+    pi[0] -= d->ty * roi_out->scale;
+  }
+  else
+  {
+    pi[0] -= d->tx * roi_out->scale;
+    pi[1] -= d->ty * roi_out->scale;
+  }
+  pi[0] /= roi_out->scale;
+  pi[1] /= roi_out->scale;
+  backtransform(pi, po, d->m, d->k_h, d->k_v);
+  po[0] *= roi_in->scale;
+  po[1] *= roi_in->scale;
+  po[0] += d->tx * roi_in->scale;
+  po[1] += d->ty * roi_in->scale;
+  if(d->k_apply == 1)
+    keystone_backtransform(po, (float *)cw->k_space, cw->ma, cw->mb, cw->md, cw->me, cw->mg, cw->mh, cw->kxa,
+                           cw->kya);
+  p[0] = po[0] - (roi_in->x + 0.5f);
+  p[1] = po[1] - (roi_in->y + 0.5f);
+}
+
+// sets up the mapping from roi_out to roi_in. without the legacy keystone correction it is a homography.
+static void _clipping_warp(dt_warp_t *w, _clipping_warp_t *cw, const dt_dev_pixelpipe_iop_t *piece,
+                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
+  const float rx = piece->buf_in.width * roi_in->scale;
+  const float ry = piece->buf_in.height * roi_in->scale;
+
+  cw->d = d;
+  cw->roi_in = roi_in;
+  cw->roi_out = roi_out;
+  cw->k_space[0] = d->k_space[0] * rx;
+  cw->k_space[1] = d->k_space[1] * ry;
+  cw->k_space[2] = d->k_space[2] * rx;
+  cw->k_space[3] = d->k_space[3] * ry;
+  cw->kxa = d->kxa * rx;
+  cw->kya = d->kya * ry;
+  if(d->k_apply == 1)
+    keystone_get_matrix(cw->k_space, cw->kxa, d->kxb * rx, d->kxc * rx, d->kxd * rx, cw->kya, d->kyb * ry,
+                        d->kyc * ry, d->kyd * ry, &cw->ma, &cw->mb, &cw->md, &cw->me, &cw->mg, &cw->mh);
+
+  if(d->k_h != 0.0f || d->k_v != 0.0f)
+  {
+    dt_warp_init_generic(w, _clipping_backtransform, cw);
+    return;
+  }
+
+  // same steps as _clipping_backtransform()
+  const float s_out = roi_out->scale;
+  const float s_in = roi_in->scale;
+  dt_warp_init(w);
+  dt_warp_translate(w, roi_out->x - s_out * d->enlarge_x + s_out * d->cix + 0.5f - (d->flip ? d->ty : d->tx) * s_out,
+                    roi_out->y - s_out * d->enlarge_y + s_out * d->ciy + 0.5f - (d->flip ? d->tx : d->ty) * s_out);
+  dt_warp_scale(w, 1.0 / s_out, 1.0 / s_out);
+  dt_warp_linear(w, d->m);
+  dt_warp_scale(w, s_in, s_in);
+  dt_warp_translate(w, d->tx * s_in, d->ty * s_in);
+  if(d->k_apply == 1)
+  {
+    dt_warp_translate(w, -cw->k_space[0], -cw->k_space[1]);
+    // keystone_backtransform() as a homography
+    const double a = cw->ma, b = cw->mb, dd = cw->md, e = cw->me, g = cw->mg, h = cw->mh;
+    const double w0 = dd * h - e * g, w1 = b * g - a * h, w2 = a * e - b * dd;
+    const double k[9] = { e + cw->kxa * w0, -b + cw->kxa * w1, cw->kxa * w2,
+                          -dd + cw->kya * w0, a + cw->kya * w1, cw->kya * w2,
+                          w0, w1, w2 };
+    dt_warp_homography(w, k);
+  }
+  dt_warp_translate(w, -(roi_in->x + 0.5f), -(roi_in->y + 0.5f));
+}
+
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
 {
   // as dt_iop_roi_t contain int values and not floats, we can have some rounding errors
@@ -567,60 +666,31 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
   else
   {
     const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-    const float rx = piece->buf_in.width * roi_in->scale;
-    const float ry = piece->buf_in.height * roi_in->scale;
-    float k_space[4] = { d->k_space[0] * rx, d->k_space[1] * ry, d->k_space[2] * rx, d->k_space[3] * ry };
-    const float kxa = d->kxa * rx, kxb = d->kxb * rx, kxc = d->kxc * rx, kxd = d->kxd * rx;
-    const float kya = d->kya * ry, kyb = d->kyb * ry, kyc = d->kyc * ry, kyd = d->kyd * ry;
-    float ma, mb, md, me, mg, mh;
-    if(d->k_apply == 1)
-      keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, kxa, kya, out, roi_in, roi_out) \
-    shared(d, interpolation, k_space, ma, mb, md, me, mg, mh) \
-    schedule(static)
-#endif
-    // (slow) point-by-point transformation.
-    // TODO: optimize with scanlines and linear steps between?
-    for(int j = 0; j < roi_out->height; j++)
-    {
-      float *_out = out + (size_t)j * roi_out->width;
-      for(int i = 0; i < roi_out->width; i++, _out++)
-      {
-        float pi[2] = { 0.0f }, po[2] = { 0.0f };
+    dt_warp_t w;
+    _clipping_warp_t cw;
+    _clipping_warp(&w, &cw, piece, roi_in, roi_out);
+    dt_warp_process_1c(&w, interpolation, in, out, roi_in, roi_out);
+  }
+}
 
-        pi[0] = roi_out->x - roi_out->scale * d->enlarge_x + roi_out->scale * d->cix + i + 0.5f;
-        pi[1] = roi_out->y - roi_out->scale * d->enlarge_y + roi_out->scale * d->ciy + j + 0.5f;
+int distort_warp(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                 const dt_iop_roi_t *const roi_out, dt_warp_t *w)
+{
+  dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
 
-        // transform this point using matrix m
-        if(d->flip)
-        {
-          pi[1] -= d->tx * roi_out->scale;
-          pi[0] -= d->ty * roi_out->scale;
-        }
-        else
-        {
-          pi[0] -= d->tx * roi_out->scale;
-          pi[1] -= d->ty * roi_out->scale;
-        }
-        pi[0] /= roi_out->scale;
-        pi[1] /= roi_out->scale;
-        backtransform(pi, po, d->m, d->k_h, d->k_v);
-        po[0] *= roi_in->scale;
-        po[1] *= roi_in->scale;
-        po[0] += d->tx * roi_in->scale;
-        po[1] += d->ty * roi_in->scale;
-        if(d->k_apply == 1) keystone_backtransform(po, k_space, ma, mb, md, me, mg, mh, kxa, kya);
-        po[0] -= roi_in->x + 0.5f;
-        po[1] -= roi_in->y + 0.5f;
-
-        *_out = dt_interpolation_compute_sample(interpolation, in, po[0], po[1], roi_in->width, roi_in->height, 1,
-                                                roi_in->width);
-      }
-    }
+  // the copy in the crop only path of process() is the identity
+  if(!d->flags && d->angle == 0.0 && d->all_off && roi_in->width == roi_out->width
+     && roi_in->height == roi_out->height)
+  {
+    dt_warp_init(w);
+    return 1;
   }
+
+  if(d->k_h != 0.0f || d->k_v != 0.0f) return 0;
+
+  _clipping_warp_t cw;
+  _clipping_warp(w, &cw, piece, roi_in, roi_out);
+  return 1;
 }
 
 static int _iop_clipping_set_max_clip(struct dt_iop_module_t *self)
@@ -927,7 +997,6 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   dt_iop_clipping_data_t *d = (dt_iop_clipping_data_t *)piece->data;
 
   const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
 
   assert(ch == 4);
 
@@ -956,59 +1025,10 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   else
   {
     const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-    const float rx = piece->buf_in.width * roi_in->scale;
-    const float ry = piece->buf_in.height * roi_in->scale;
-    float k_space[4] = { d->k_space[0] * rx, d->k_space[1] * ry, d->k_space[2] * rx, d->k_space[3] * ry };
-    const float kxa = d->kxa * rx, kxb = d->kxb * rx, kxc = d->kxc * rx, kxd = d->kxd * rx;
-    const float kya = d->kya * ry, kyb = d->kyb * ry, kyc = d->kyc * ry, kyd = d->kyd * ry;
-    float ma, mb, md, me, mg, mh;
-    if(d->k_apply == 1)
-      keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(ch, ch_width, ivoid, kxa, kya, ovoid, roi_in, roi_out) \
-    shared(d, interpolation, k_space, ma, mb, md, me, mg, mh) \
-    schedule(static)
-#endif
-    // (slow) point-by-point transformation.
-    // TODO: optimize with scanlines and linear steps between?
-    for(int j = 0; j < roi_out->height; j++)
-    {
-      float *out = ((float *)ovoid) + (size_t)ch * j * roi_out->width;
-      for(int i = 0; i < roi_out->width; i++, out += ch)
-      {
-        float pi[2], po[2];
-
-        pi[0] = roi_out->x - roi_out->scale * d->enlarge_x + roi_out->scale * d->cix + i + 0.5f;
-        pi[1] = roi_out->y - roi_out->scale * d->enlarge_y + roi_out->scale * d->ciy + j + 0.5f;
-
-        // transform this point using matrix m
-        if(d->flip)
-        {
-          pi[1] -= d->tx * roi_out->scale;
-          pi[0] -= d->ty * roi_out->scale;
-        }
-        else
-        {
-          pi[0] -= d->tx * roi_out->scale;
-          pi[1] -= d->ty * roi_out->scale;
-        }
-        pi[0] /= roi_out->scale;
-        pi[1] /= roi_out->scale;
-        backtransform(pi, po, d->m, d->k_h, d->k_v);
-        po[0] *= roi_in->scale;
-        po[1] *= roi_in->scale;
-        po[0] += d->tx * roi_in->scale;
-        po[1] += d->ty * roi_in->scale;
-        if(d->k_apply == 1) keystone_backtransform(po, k_space, ma, mb, md, me, mg, mh, kxa, kya);
-        po[0] -= roi_in->x + 0.5f;
-        po[1] -= roi_in->y + 0.5f;
-
-        dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out, po[0], po[1], roi_in->width,
-                                         roi_in->height, ch_width);
-      }
-    }
+    dt_warp_t w;
+    _clipping_warp_t cw;
+    _clipping_warp(&w, &cw, piece, roi_in, roi_out);
+    dt_warp_process(&w, interpolation, (const float *)ivoid, (float *)ovoid, roi_in, roi_out);
   }
 }
 
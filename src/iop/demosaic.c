@@ -149,6 +149,8 @@ typedef struct dt_iop_demosaic_data_t
   uint32_t yet_unused_data_specific_to_demosaicing_method;
   float median_thrs;
   double CAM_to_RGB[3][4];
+  char *xtrans_buffers;        // per thread scratch of Markesteijn and FDC, kept with the pipe
+  size_t xtrans_buffers_size;
 } dt_iop_demosaic_data_t;
 
 void amaze_demosaic_RT(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const in,
@@ -552,6 +554,78 @@ static void green_equilibration_favg(float *out, const float *const in, const in
 // tile size, optimized to keep data in L2 cache
 #define TS 122
 
+// a pipe runs the X-Trans demosaicers on several bands or tiles in a row, so their per thread tile buffers are
+// kept with it instead of allocating (and faulting in) a few MB per thread on every call
+static char *xtrans_buffers(dt_iop_demosaic_data_t *data, const size_t buffer_size)
+{
+  const size_t size = dt_get_num_threads() * buffer_size;
+  if(data->xtrans_buffers_size < size)
+  {
+    dt_free_align(data->xtrans_buffers);
+    data->xtrans_buffers = (char *)dt_alloc_align(64, size);
+    data->xtrans_buffers_size = data->xtrans_buffers ? size : 0;
+  }
+  return data->xtrans_buffers;
+}
+
+// homogeneity maps of the Markesteijn and FDC tiles. both steps run along whole tile rows so that the
+// compiler can vectorize them, the results are the same as counting pixel by pixel.
+static void xtrans_homogeneity(float (*const drv)[TS][TS], uint8_t (*const homo)[TS][TS],
+                               uint8_t (*const homosum)[TS][TS], const int ndir, const int pad_homo,
+                               const int pad_tile, const int mrow, const int mcol)
+{
+  /* Build homogeneity maps from the derivatives:                   */
+  memset(homo, 0, (size_t)ndir * TS * TS * sizeof(uint8_t));
+  for(int row = pad_homo; row < mrow - pad_homo; row++)
+  {
+    // threshold is eight times the smallest derivative of all directions
+    float tr[TS];
+    for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] = drv[0][row][col];
+    for(int d = 1; d < ndir; d++)
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] = fminf(tr[col], drv[d][row][col]);
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int col = pad_homo; col < mcol - pad_homo; col++) tr[col] *= 8.0f;
+
+    for(int d = 0; d < ndir; d++)
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_homo; col < mcol - pad_homo; col++)
+      {
+        int count = 0;
+        for(int v = -1; v <= 1; v++)
+          for(int h = -1; h <= 1; h++) count += drv[d][row + v][col + h] <= tr[col];
+        homo[d][row][col] = count;
+      }
+  }
+
+  /* Build 5x5 sum of homogeneity maps for each pixel & direction */
+  for(int d = 0; d < ndir; d++)
+    for(int row = pad_tile; row < mrow - pad_tile; row++)
+    {
+      // column sums of 5 rows. the sums start 5 columns before the first one used, like the rolling sums of
+      // dcraw, which leaves the columns closer to the border than pad_tile - 2 out.
+      uint8_t colsum[TS];
+      for(int col = pad_tile - 7; col < pad_tile - 2; col++) colsum[col] = 0;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_tile - 2; col < mcol - pad_tile + 2; col++)
+        colsum[col] = homo[d][row - 2][col] + homo[d][row - 1][col] + homo[d][row][col] + homo[d][row + 1][col]
+                      + homo[d][row + 2][col];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int col = pad_tile - 5; col < mcol - pad_tile; col++)
+        homosum[d][row][col] = colsum[col - 2] + colsum[col - 1] + colsum[col] + colsum[col + 1] + colsum[col + 2];
+    }
+}
+
 /** Lookup for allhex[], making sure that row/col aren't negative **/
 static inline const short * hexmap(const int row, const int col, short (*const allhex)[3][8])
 {
@@ -571,7 +645,8 @@ static inline const short * hexmap(const int row, const int col, short (*const a
 static void xtrans_markesteijn_interpolate(float *out, const float *const in,
                                            const dt_iop_roi_t *const roi_out,
                                            const dt_iop_roi_t *const roi_in,
-                                           const uint8_t (*const xtrans)[6], const int passes)
+                                           const uint8_t (*const xtrans)[6], const int passes,
+                                           dt_iop_demosaic_data_t *const data)
 {
   static const short orth[12] = { 1, 0, 0, 1, -1, 0, 0, -1, 1, 0, 0, 1 },
                      patt[2][16] = { { 0, 1, 0, -1, 2, 0, -1, 0, 1, 1, 1, -1, 0, 0, 0, 0 },
@@ -588,7 +663,7 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
   const int ndir = 4 << (passes > 1);
 
   const size_t buffer_size = (size_t)TS * TS * (ndir * 4 + 3) * sizeof(float);
-  char *const all_buffers = (char *)dt_alloc_align(64, dt_get_num_threads() * buffer_size);
+  char *const all_buffers = xtrans_buffers(data, buffer_size);
   if(!all_buffers)
   {
     printf("[demosaic] not able to allocate Markesteijn buffers\n");
@@ -967,39 +1042,9 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
           }
       }
 
-      /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, (size_t)ndir * TS * TS * sizeof(uint8_t));
+      /* Build homogeneity maps and their 5x5 sums from the derivatives: */
       const int pad_homo = (passes == 1) ? 10 : 15;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(int d = 0; d < ndir; d++)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(int d = 0; d < ndir; d++)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++) homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
-
-      /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(int d = 0; d < ndir; d++)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile-5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      xtrans_homogeneity(drv, homo, homosum, ndir, pad_homo, pad_tile, mrow, mcol);
 
       /* Average the most homogeneous pixels for the final result:       */
       for(int row = pad_tile; row < mrow - pad_tile; row++)
@@ -1031,7 +1076,6 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
         }
     }
   }
-  dt_free_align(all_buffers);
 }
 
 #undef TS
@@ -1039,7 +1083,7 @@ static void xtrans_markesteijn_interpolate(float *out, const float *const in,
 #define TS 122
 static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, const float *const in,
                                    const dt_iop_roi_t *const roi_out, const dt_iop_roi_t *const roi_in,
-                                   const uint8_t (*const xtrans)[6])
+                                   const uint8_t (*const xtrans)[6], dt_iop_demosaic_data_t *const data)
 {
 
   static const short orth[12] = { 1, 0, 0, 1, -1, 0, 0, -1, 1, 0, 0, 1 },
@@ -1584,7 +1628,7 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
               1.221201e-03f - 5.982162e-19f * _Complex_I } } };
 
   const size_t buffer_size = (size_t)TS * TS * (ndir * 4 + 7) * sizeof(float);
-  char *const all_buffers = (char *)dt_alloc_align(64, dt_get_num_threads() * buffer_size);
+  char *const all_buffers = xtrans_buffers(data, buffer_size);
   if(!all_buffers)
   {
     fprintf(stderr, "[demosaic] not able to allocate FDC base buffers\n");
@@ -1962,39 +2006,9 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
           }
       }
 
-      /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, (size_t)ndir * TS * TS * sizeof(uint8_t));
+      /* Build homogeneity maps and their 5x5 sums from the derivatives: */
       const int pad_homo = 10;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(int d = 0; d < ndir; d++)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(int d = 0; d < ndir; d++)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++) homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
-
-      /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(int d = 0; d < ndir; d++)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile - 5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      xtrans_homogeneity(drv, homo, homosum, ndir, pad_homo, pad_tile, mrow, mcol);
 
       /* Calculate chroma values in fdc:       */
       const int pad_fdc = 6;
@@ -2144,7 +2158,6 @@ static void xtrans_fdc_interpolate(struct dt_iop_module_t *self, float *out, con
         }
     }
   }
-  dt_free_align(all_buffers);
 }
 
 #undef PIX_SWAP
@@ -2857,6 +2870,117 @@ static int demosaic_qual_flags(const dt_dev_pixelpipe_iop_t *const piece,
   return flags;
 }
 
+// rows of the input demosaiced at a time when the output is downscaled anyway
+#define DEMOSAIC_BAND_ROWS 512
+
+// rows around a band (or tile) the full scale methods need to get its border right, see tiling_callback()
+static int demosaic_overlap(const int demosaicing_method, const int qual_flags)
+{
+  if(demosaicing_method == DT_IOP_DEMOSAIC_PPG || demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME
+     || demosaicing_method == DT_IOP_DEMOSAIC_AMAZE)
+    return 5;
+  if((demosaicing_method == DT_IOP_DEMOSAIC_MARKESTEIJN || demosaicing_method == DT_IOP_DEMOSAIC_MARKESTEIJN_3
+      || demosaicing_method == DT_IOP_DEMOSAIC_FDC)
+     && (qual_flags & DEMOSAIC_XTRANS_FULL))
+    return demosaicing_method == DT_IOP_DEMOSAIC_MARKESTEIJN_3 ? 17 : 12;
+  return 6;
+}
+
+// full scale demosaic of roi_in into the buffer out of the same size. in is green equilibrated already.
+static void demosaic_full(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *const out,
+                          const float *const in, dt_iop_roi_t *const roi_out, const dt_iop_roi_t *const roi_in,
+                          const int demosaicing_method, const int qual_flags)
+{
+  const dt_image_t *img = &self->dev->image_storage;
+  dt_iop_demosaic_data_t *data = (dt_iop_demosaic_data_t *)piece->data;
+  const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])piece->pipe->dsc.xtrans;
+
+  if(demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME)
+    passthrough_monochrome(out, in, roi_out, roi_in);
+  else if(piece->pipe->dsc.filters == 9u)
+  {
+    if(demosaicing_method == DT_IOP_DEMOSAIC_FDC && (qual_flags & DEMOSAIC_XTRANS_FULL))
+      xtrans_fdc_interpolate(self, out, in, roi_out, roi_in, xtrans, data);
+    else if(demosaicing_method >= DT_IOP_DEMOSAIC_MARKESTEIJN && (qual_flags & DEMOSAIC_XTRANS_FULL))
+      xtrans_markesteijn_interpolate(out, in, roi_out, roi_in, xtrans,
+                                     1 + (demosaicing_method - DT_IOP_DEMOSAIC_MARKESTEIJN) * 2, data);
+    else
+      vng_interpolate(out, in, roi_out, roi_in, piece->pipe->dsc.filters, xtrans,
+                      qual_flags & DEMOSAIC_ONLY_VNG_LINEAR);
+  }
+  else if(demosaicing_method == DT_IOP_DEMOSAIC_VNG4 || (img->flags & DT_IMAGE_4BAYER))
+  {
+    vng_interpolate(out, in, roi_out, roi_in, piece->pipe->dsc.filters, xtrans,
+                    qual_flags & DEMOSAIC_ONLY_VNG_LINEAR);
+    if(img->flags & DT_IMAGE_4BAYER)
+      dt_colorspaces_cygm_to_rgb(out, roi_out->width * roi_out->height, data->CAM_to_RGB);
+  }
+  else if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
+    demosaic_ppg(out, in, roi_out, roi_in, piece->pipe->dsc.filters,
+                 data->median_thrs); // wanted ppg or zoomed out a lot and quality is limited to 1
+  else
+    amaze_demosaic_RT(self, piece, in, out, roi_in, roi_out, piece->pipe->dsc.filters);
+}
+
+// full scale demosaic followed by downscaling, one band of rows at a time. each band covers the input rows
+// the resampling of its output rows reads plus the overlap of the demosaic method, so the result is the same
+// as demosaicing everything first but the full size rgb buffer is never allocated.
+static void demosaic_scaled(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *const out,
+                            const float *const in, const dt_iop_roi_t *const roi_in,
+                            const dt_iop_roi_t *const roi_out, const int demosaicing_method, const int qual_flags)
+{
+  const struct dt_interpolation *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  const float scale = roi_out->scale;
+  const int align = (piece->pipe->dsc.filters == 9u) ? 6 : 2;
+  const int margin = demosaic_overlap(demosaicing_method, qual_flags) + itor->width + 1;
+
+  // even out the bands, a tiny last one would mostly be overlap
+  const int rows = MAX(1, MIN(roi_out->height, (int)(DEMOSAIC_BAND_ROWS * scale)));
+  const int bands = (roi_out->height + rows - 1) / rows;
+  const int band_rows = (roi_out->height + bands - 1) / bands;
+
+  // input rows feeding output rows [oy0, oy1), the resampling plan is the one of the full image
+#define BAND_TOP(oy0) MAX(0, ((int)floorf(((oy0) - itor->width) / scale) - margin) / align * align)
+#define BAND_BOTTOM(oy1) MIN(roi_in->height, (int)ceilf(((oy1) - 1 + itor->width) / scale) + margin + 1)
+
+  int max_height = 0;
+  for(int oy0 = 0; oy0 < roi_out->height; oy0 += band_rows)
+  {
+    const int oy1 = MIN(oy0 + band_rows, roi_out->height);
+    max_height = MAX(max_height, BAND_BOTTOM(oy1) - BAND_TOP(oy0));
+  }
+
+  float *const tmp = dt_alloc_align(64, (size_t)roi_in->width * max_height * 4 * sizeof(float));
+  if(!tmp) return;
+
+  dt_print(DT_DEBUG_PERF, "[demosaic] %d bands of up to %d rows for %dx%d -> %dx%d\n", bands, max_height,
+           roi_in->width, roi_in->height, roi_out->width, roi_out->height);
+
+  const dt_iop_roi_t full = { 0, 0, roi_in->width, roi_in->height, 1.0f };
+  for(int oy0 = 0; oy0 < roi_out->height; oy0 += band_rows)
+  {
+    const int oy1 = MIN(oy0 + band_rows, roi_out->height);
+    const int y0 = BAND_TOP(oy0);
+    const int y1 = BAND_BOTTOM(oy1);
+
+    dt_iop_roi_t roi = *roi_in;
+    roi.y += y0;
+    roi.height = y1 - y0;
+    dt_iop_roi_t roo = { 0, 0, roi_in->width, y1 - y0, 1.0f };
+    demosaic_full(self, piece, tmp, in + (size_t)y0 * roi_in->width, &roo, &roi, demosaicing_method, qual_flags);
+
+    // the plan is the one of the full demosaiced image, of which tmp holds the rows from y0 on
+    const dt_iop_roi_t band = { 0, oy0, roi_out->width, oy1 - oy0, scale };
+    dt_interpolation_resample_rows(itor, out + (size_t)4 * oy0 * roi_out->width, &band,
+                                   roi_out->width * 4 * sizeof(float), tmp, y0, &full,
+                                   roi_in->width * 4 * sizeof(float));
+  }
+#undef BAND_TOP
+#undef BAND_BOTTOM
+
+  dt_free_align(tmp);
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const i, void *const o,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -2883,87 +3007,45 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 
   if(qual_flags & DEMOSAIC_FULL_SCALE)
   {
-    // Full demosaic and then scaling if needed
-    const int scaled = (roi_out->width != roi_in->width || roi_out->height != roi_in->height);
-    float *tmp = (float *) o;
-    if(scaled)
-    {
-      // demosaic and then clip and zoom
-      // we demosaic at 1:1 the size of input roi, so make sure
-      // we fit these bounds exactly, to avoid crashes..
-      roo.width = roi_in->width;
-      roo.height = roi_in->height;
-      roo.scale = 1.0f;
-      tmp = (float *)dt_alloc_align(64, (size_t)roo.width * roo.height * 4 * sizeof(float));
-    }
+    float *in = (float *)pixels;
+    float *aux;
 
-    if(demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME)
-    {
-      passthrough_monochrome(tmp, pixels, &roo, &roi);
-    }
-    else if(piece->pipe->dsc.filters == 9u)
-    {
-      if(demosaicing_method == DT_IOP_DEMOSAIC_FDC && (qual_flags & DEMOSAIC_XTRANS_FULL))
-        xtrans_fdc_interpolate(self, tmp, pixels, &roo, &roi, xtrans);
-      else if(demosaicing_method >= DT_IOP_DEMOSAIC_MARKESTEIJN && (qual_flags & DEMOSAIC_XTRANS_FULL))
-        xtrans_markesteijn_interpolate(tmp, pixels, &roo, &roi, xtrans,
-                                       1 + (demosaicing_method - DT_IOP_DEMOSAIC_MARKESTEIJN) * 2);
-      else
-        vng_interpolate(tmp, pixels, &roo, &roi, piece->pipe->dsc.filters, xtrans, qual_flags & DEMOSAIC_ONLY_VNG_LINEAR);
-    }
-    else
+    if(demosaicing_method != DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME && piece->pipe->dsc.filters != 9u
+       && !(img->flags & DT_IMAGE_4BAYER) && data->green_eq != DT_IOP_GREEN_EQ_NO)
     {
-      float *in = (float *)pixels;
-      float *aux;
-
-      if(!(img->flags & DT_IMAGE_4BAYER) && data->green_eq != DT_IOP_GREEN_EQ_NO)
+      in = (float *)dt_alloc_align(64, (size_t)roi_in->height * roi_in->width * sizeof(float));
+      switch(data->green_eq)
       {
-        in = (float *)dt_alloc_align(64, (size_t)roi_in->height * roi_in->width * sizeof(float));
-        switch(data->green_eq)
-        {
-          case DT_IOP_GREEN_EQ_FULL:
-            green_equilibration_favg(in, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
-                                     roi_in->x, roi_in->y);
-            break;
-          case DT_IOP_GREEN_EQ_LOCAL:
-            green_equilibration_lavg(in, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
-                                     roi_in->x, roi_in->y, threshold);
-            break;
-          case DT_IOP_GREEN_EQ_BOTH:
-            aux = dt_alloc_align(64, (size_t)roi_in->height * roi_in->width * sizeof(float));
-            green_equilibration_favg(aux, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
-                                     roi_in->x, roi_in->y);
-            green_equilibration_lavg(in, aux, roi_in->width, roi_in->height, piece->pipe->dsc.filters, roi_in->x,
-                                     roi_in->y, threshold);
-            dt_free_align(aux);
-            break;
-        }
-      }
-
-      if(demosaicing_method == DT_IOP_DEMOSAIC_VNG4 || (img->flags & DT_IMAGE_4BAYER))
-      {
-        vng_interpolate(tmp, in, &roo, &roi, piece->pipe->dsc.filters, xtrans, qual_flags & DEMOSAIC_ONLY_VNG_LINEAR);
-        if (img->flags & DT_IMAGE_4BAYER)
-        {
-          dt_colorspaces_cygm_to_rgb(tmp, roo.width*roo.height, data->CAM_to_RGB);
-          dt_colorspaces_cygm_to_rgb(piece->pipe->dsc.processed_maximum, 1, data->CAM_to_RGB);
-        }
+        case DT_IOP_GREEN_EQ_FULL:
+          green_equilibration_favg(in, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
+                                   roi_in->x, roi_in->y);
+          break;
+        case DT_IOP_GREEN_EQ_LOCAL:
+          green_equilibration_lavg(in, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
+                                   roi_in->x, roi_in->y, threshold);
+          break;
+        case DT_IOP_GREEN_EQ_BOTH:
+          aux = dt_alloc_align(64, (size_t)roi_in->height * roi_in->width * sizeof(float));
+          green_equilibration_favg(aux, pixels, roi_in->width, roi_in->height, piece->pipe->dsc.filters,
+                                   roi_in->x, roi_in->y);
+          green_equilibration_lavg(in, aux, roi_in->width, roi_in->height, piece->pipe->dsc.filters, roi_in->x,
+                                   roi_in->y, threshold);
+          dt_free_align(aux);
+          break;
       }
-      else if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
-        demosaic_ppg(tmp, in, &roo, &roi, piece->pipe->dsc.filters,
-                     data->median_thrs); // wanted ppg or zoomed out a lot and quality is limited to 1
-      else
-        amaze_demosaic_RT(self, piece, in, tmp, &roi, &roo, piece->pipe->dsc.filters);
-
-      if(!(img->flags & DT_IMAGE_4BAYER) && data->green_eq != DT_IOP_GREEN_EQ_NO) dt_free_align(in);
     }
 
+    // full demosaic, and downscaling on the fly if needed
+    const int scaled = (roi_out->width != roi_in->width || roi_out->height != roi_in->height);
     if(scaled)
-    {
-      roi = *roi_out;
-      dt_iop_clip_and_zoom_roi((float *)o, tmp, &roi, &roo, roi.width, roo.width);
-      dt_free_align(tmp);
-    }
+      demosaic_scaled(self, piece, (float *)o, in, roi_in, roi_out, demosaicing_method, qual_flags);
+    else
+      demosaic_full(self, piece, (float *)o, in, &roo, &roi, demosaicing_method, qual_flags);
+
+    if((img->flags & DT_IMAGE_4BAYER) && demosaicing_method != DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME)
+      dt_colorspaces_cygm_to_rgb(piece->pipe->dsc.processed_maximum, 1, data->CAM_to_RGB);
+
+    if(in != pixels) dt_free_align(in);
   }
   else
   {
@@ -4667,10 +4749,6 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   const int qual_flags = demosaic_qual_flags(piece, &self->dev->image_storage, roi_out);
   const int full_scale_demosaicing = qual_flags & DEMOSAIC_FULL_SCALE;
 
-  // check if output buffer has same dimension as input buffer (thus avoiding one
-  // additional temporary buffer)
-  const int unscaled = (roi_out->width == roi_in->width && roi_out->height == roi_in->height);
-
   if((demosaicing_method == DT_IOP_DEMOSAIC_PPG) ||
       (demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME) ||
       (demosaicing_method == DT_IOP_DEMOSAIC_AMAZE))
@@ -4678,10 +4756,9 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     // Bayer pattern with PPG, Monochrome and Amaze
     tiling->factor = 1.0f + ioratio;         // in + out
 
-    if(full_scale_demosaicing && unscaled)
+    // downscaling is done band by band, so there is no full size temporary buffer
+    if(full_scale_demosaicing)
       tiling->factor += fmax(1.0f + greeneq, smooth);  // + tmp + geeneq | + smooth
-    else if(full_scale_demosaicing)
-      tiling->factor += fmax(2.0f + greeneq, smooth);  // + tmp + aux + greeneq | + smooth
     else
       tiling->factor += smooth;                        // + smooth
 
@@ -4706,10 +4783,8 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
                       + ndir * 0.125f  // homo + homosum
                       + 1.0f;          // aux
 
-    if(full_scale_demosaicing && unscaled)
+    if(full_scale_demosaicing)
       tiling->factor += fmax(1.0f + greeneq, smooth);
-    else if(full_scale_demosaicing)
-      tiling->factor += fmax(2.0f + greeneq, smooth);
     else
       tiling->factor += smooth;
 
@@ -4724,10 +4799,8 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     // VNG
     tiling->factor = 1.0f + ioratio;
 
-    if(full_scale_demosaicing && unscaled)
+    if(full_scale_demosaicing)
       tiling->factor += fmax(1.0f + greeneq, smooth);
-    else if(full_scale_demosaicing)
-      tiling->factor += fmax(2.0f + greeneq, smooth);
     else
       tiling->factor += smooth;
 
@@ -4930,12 +5003,14 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *params, dt_dev
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_demosaic_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_demosaic_data_t));
   self->commit_params(self, self->default_params, pipe, piece);
 }
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_demosaic_data_t *d = (dt_iop_demosaic_data_t *)piece->data;
+  dt_free_align(d->xtrans_buffers);
   free(piece->data);
   piece->data = NULL;
 }
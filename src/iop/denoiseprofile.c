@@ -998,418 +998,211 @@ static inline __m128 weight_sse(const __m128 *c1, const __m128 *c2, const float
 }
 #endif
 
-#define SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj)                                                                \
-  do                                                                                                         \
-  {                                                                                                          \
-    const float f = filter[(ii)] * filter[(jj)];                                                             \
-    const float wp = weight(px, px2, inv_sigma2);                                                            \
-    const float w = f * wp;                                                                                  \
-    float pd[4];                                                                                             \
-    for(int c = 0; c < 4; c++) pd[c] = w * px2[c];                                                           \
-    for(int c = 0; c < 4; c++) sum[c] += pd[c];                                                              \
-    for(int c = 0; c < 4; c++) wgt[c] += w;                                                                  \
-  } while(0)
-
-#if defined(__SSE__)
-#define SUM_PIXEL_CONTRIBUTION_COMMON_SSE(ii, jj)                                                            \
-  do                                                                                                         \
-  {                                                                                                          \
-    const __m128 f = _mm_set1_ps(filter[(ii)] * filter[(jj)]);                                               \
-    const __m128 wp = weight_sse(px, px2, inv_sigma2);                                                       \
-    const __m128 w = _mm_mul_ps(f, wp);                                                                      \
-    const __m128 pd = _mm_mul_ps(w, *px2);                                                                   \
-    sum = _mm_add_ps(sum, pd);                                                                               \
-    wgt = _mm_add_ps(wgt, w);                                                                                \
-  } while(0)
-#endif
-
-#define SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj)                                                             \
-  do                                                                                                         \
-  {                                                                                                          \
-    const int iii = (ii)-2;                                                                                  \
-    const int jjj = (jj)-2;                                                                                  \
-    int x = i + mult * iii;                                                                                  \
-    int y = j + mult * jjj;                                                                                  \
-                                                                                                             \
-    if(x < 0) x = 0;                                                                                         \
-    if(x >= width) x = width - 1;                                                                            \
-    if(y < 0) y = 0;                                                                                         \
-    if(y >= height) y = height - 1;                                                                          \
-                                                                                                             \
-    px2 = ((float *)in) + 4 * x + (size_t)4 * y * width;                                                     \
-                                                                                                             \
-    SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj);                                                                   \
-  } while(0)
-
-#if defined(__SSE__)
-#define SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE(ii, jj)                                                         \
-  do                                                                                                         \
-  {                                                                                                          \
-    const int iii = (ii)-2;                                                                                  \
-    const int jjj = (jj)-2;                                                                                  \
-    int x = i + mult * iii;                                                                                  \
-    int y = j + mult * jjj;                                                                                  \
-                                                                                                             \
-    if(x < 0) x = 0;                                                                                         \
-    if(x >= width) x = width - 1;                                                                            \
-    if(y < 0) y = 0;                                                                                         \
-    if(y >= height) y = height - 1;                                                                          \
-                                                                                                             \
-    px2 = ((__m128 *)in) + x + (size_t)y * width;                                                            \
-                                                                                                             \
-    SUM_PIXEL_CONTRIBUTION_COMMON_SSE(ii, jj);                                                               \
-  } while(0)
-#endif
-
-#define ROW_PROLOGUE                                                                                         \
-  const float *px = ((float *)in) + (size_t)4 * j * width;                                                   \
-  const float *px2;                                                                                          \
-  float *pdetail = detail + (size_t)4 * j * width;                                                           \
-  float *pcoarse = out + (size_t)4 * j * width;
-
-#if defined(__SSE__)
-#define ROW_PROLOGUE_SSE                                                                                     \
-  const __m128 *px = ((__m128 *)in) + (size_t)j * width;                                                     \
-  const __m128 *px2;                                                                                         \
-  float *pdetail = detail + (size_t)4 * j * width;                                                           \
-  float *pcoarse = out + (size_t)4 * j * width;
-#endif
-
-#define SUM_PIXEL_PROLOGUE                                                                                   \
-  float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };                                                                 \
-  float wgt[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-#if defined(__SSE__)
-#define SUM_PIXEL_PROLOGUE_SSE                                                                               \
-  __m128 sum = _mm_setzero_ps();                                                                             \
-  __m128 wgt = _mm_setzero_ps();
-#endif
-
-#define SUM_PIXEL_EPILOGUE                                                                                   \
-  for(int c = 0; c < 4; c++) sum[c] /= wgt[c];                                                               \
-                                                                                                             \
-  for(int c = 0; c < 4; c++) pdetail[c] = (px[c] - sum[c]);                                                  \
-  for(int c = 0; c < 4; c++) pcoarse[c] = sum[c];                                                            \
-  px += 4;                                                                                                   \
-  pdetail += 4;                                                                                              \
-  pcoarse += 4;
-
-#if defined(__SSE__)
-#define SUM_PIXEL_EPILOGUE_SSE                                                                               \
-  sum = _mm_div_ps(sum, wgt);                                                                                \
-                                                                                                             \
-  _mm_stream_ps(pdetail, _mm_sub_ps(*px, sum));                                                              \
-  _mm_stream_ps(pcoarse, sum);                                                                               \
-  px++;                                                                                                      \
-  pdetail += 4;                                                                                              \
-  pcoarse += 4;
-#endif
-
-typedef void((*eaw_decompose_t)(float *const out, const float *const in, float *const detail, const int scale,
-                                const float inv_sigma2, const int32_t width, const int32_t height));
-
-static void eaw_decompose(float *const out, const float *const in, float *const detail, const int scale,
-                          const float inv_sigma2, const int32_t width, const int32_t height)
+typedef void((*eaw_decompose_t)(float *const out, const float *const in, float *const detail, float sum_y2[3],
+                                const int scale, const float inv_sigma2, const int32_t width,
+                                const int32_t height));
+
+/* All rows go through the same loop: the five rows under the 5x5 kernel are
+ * clamped to the image once per row, and the five columns once per pixel,
+ * which replaces the separate slow paths for the borders. The sums of the
+ * squared details, which bayesshrink needs later on, are collected on the
+ * way while the details are still in cache. They are added up in double per
+ * thread, so they differ in the last bits from a serial float sum and with
+ * the number of threads, and so do the thresholds derived from them. */
+static void eaw_decompose(float *const out, const float *const in, float *const detail, float sum_y2[3],
+                          const int scale, const float inv_sigma2, const int32_t width, const int32_t height)
 {
   const int mult = 1u << scale;
   static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0;
 
-/* The first "2*mult" lines use the macro with tests because the 5x5 kernel
- * requires nearest pixel interpolation for at least a pixel in the sum */
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
+  reduction(+ : sum0, sum1, sum2) \
   schedule(static)
 #endif
-  for(int j = 0; j < 2 * mult; j++)
+  for(int j = 0; j < height; j++)
   {
-    ROW_PROLOGUE
+    const float *rows[5];
+    for(int jj = 0; jj < 5; jj++)
+      rows[jj] = in + (size_t)4 * width * CLAMP(j + mult * (jj - 2), 0, height - 1);
+
+    const float *px = in + (size_t)4 * j * width;
+    float *pdetail = detail + (size_t)4 * j * width;
+    float *pcoarse = out + (size_t)4 * j * width;
+    float sq[3] = { 0.0f, 0.0f, 0.0f };
 
     for(int i = 0; i < width; i++)
     {
-      SUM_PIXEL_PROLOGUE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
-  schedule(static)
-#endif
-  for(int j = 2 * mult; j < height - 2 * mult; j++)
-  {
-    ROW_PROLOGUE
+      int cols[5];
+      for(int ii = 0; ii < 5; ii++) cols[ii] = 4 * CLAMP(i + mult * (ii - 2), 0, width - 1);
 
-    /* The first "2*mult" pixels use the macro with tests because the 5x5 kernel
-     * requires nearest pixel interpolation for at least a pixel in the sum */
-    for(int i = 0; i < 2 * mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
+      float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      float wgt = 0.0f;
       for(int jj = 0; jj < 5; jj++)
       {
         for(int ii = 0; ii < 5; ii++)
         {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
+          const float *px2 = rows[jj] + cols[ii];
+          const float w = filter[ii] * filter[jj] * weight(px, px2, inv_sigma2);
+          for(int c = 0; c < 4; c++) sum[c] += w * px2[c];
+          wgt += w;
         }
       }
-      SUM_PIXEL_EPILOGUE
-    }
 
-    /* For pixels [2*mult, width-2*mult], we can safely use macro w/o tests
-     * to avoid unneeded branching in the inner loops */
-    for(int i = 2 * mult; i < width - 2 * mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_COMMON(ii, jj);
-          px2 += (size_t)4 * mult;
-        }
-        px2 += (size_t)4 * (width - 5) * mult;
-      }
-      SUM_PIXEL_EPILOGUE
+      for(int c = 0; c < 4; c++) sum[c] /= wgt;
+      for(int c = 0; c < 4; c++) pdetail[c] = px[c] - sum[c];
+      for(int c = 0; c < 4; c++) pcoarse[c] = sum[c];
+      for(int c = 0; c < 3; c++) sq[c] += pdetail[c] * pdetail[c];
+      px += 4;
+      pdetail += 4;
+      pcoarse += 4;
     }
 
-    /* Last two pixels in the row require a slow variant... blablabla */
-    for(int i = width - 2 * mult; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
+    sum0 += sq[0];
+    sum1 += sq[1];
+    sum2 += sq[2];
   }
 
-/* The last "2*mult" lines use the macro with tests because the 5x5 kernel
- * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
-  schedule(static)
-#endif
-  for(int j = height - 2 * mult; j < height; j++)
-  {
-    ROW_PROLOGUE
-
-    for(int i = 0; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE
-    }
-  }
+  sum_y2[0] = sum0;
+  sum_y2[1] = sum1;
+  sum_y2[2] = sum2;
 }
 
-#undef SUM_PIXEL_CONTRIBUTION_COMMON
-#undef SUM_PIXEL_CONTRIBUTION_WITH_TEST
-#undef ROW_PROLOGUE
-#undef SUM_PIXEL_PROLOGUE
-#undef SUM_PIXEL_EPILOGUE
-
 #if defined(__SSE2__)
-static void eaw_decompose_sse(float *const out, const float *const in, float *const detail, const int scale,
-                              const float inv_sigma2, const int32_t width, const int32_t height)
+static void eaw_decompose_sse(float *const out, const float *const in, float *const detail, float sum_y2[3],
+                              const int scale, const float inv_sigma2, const int32_t width, const int32_t height)
 {
   const int mult = 1u << scale;
   static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0;
 
-/* The first "2*mult" lines use the macro with tests because the 5x5 kernel
- * requires nearest pixel interpolation for at least a pixel in the sum */
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
+  reduction(+ : sum0, sum1, sum2) \
   schedule(static)
 #endif
-  for(int j = 0; j < 2 * mult; j++)
+  for(int j = 0; j < height; j++)
   {
-    ROW_PROLOGUE_SSE
-
-    for(int i = 0; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE_SSE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE_SSE
-    }
-  }
+    const __m128 *rows[5];
+    for(int jj = 0; jj < 5; jj++)
+      rows[jj] = (const __m128 *)in + (size_t)width * CLAMP(j + mult * (jj - 2), 0, height - 1);
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
-  schedule(static)
-#endif
-  for(int j = 2 * mult; j < height - 2 * mult; j++)
-  {
-    ROW_PROLOGUE_SSE
+    const __m128 *px = (const __m128 *)in + (size_t)j * width;
+    float *pdetail = detail + (size_t)4 * j * width;
+    float *pcoarse = out + (size_t)4 * j * width;
+    __m128 sq = _mm_setzero_ps();
 
-    /* The first "2*mult" pixels use the macro with tests because the 5x5 kernel
-     * requires nearest pixel interpolation for at least a pixel in the sum */
-    for(int i = 0; i < 2 * mult; i++)
+    for(int i = 0; i < width; i++)
     {
-      SUM_PIXEL_PROLOGUE_SSE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE_SSE
-    }
+      int cols[5];
+      for(int ii = 0; ii < 5; ii++) cols[ii] = CLAMP(i + mult * (ii - 2), 0, width - 1);
 
-    /* For pixels [2*mult, width-2*mult], we can safely use macro w/o tests
-     * to avoid unneeded branching in the inner loops */
-    for(int i = 2 * mult; i < width - 2 * mult; i++)
-    {
-      SUM_PIXEL_PROLOGUE_SSE
-      px2 = ((__m128 *)in) + i - 2 * mult + (size_t)(j - 2 * mult) * width;
+      __m128 sum = _mm_setzero_ps();
+      __m128 wgt = _mm_setzero_ps();
       for(int jj = 0; jj < 5; jj++)
       {
         for(int ii = 0; ii < 5; ii++)
         {
-          SUM_PIXEL_CONTRIBUTION_COMMON_SSE(ii, jj);
-          px2 += mult;
+          const __m128 *px2 = rows[jj] + cols[ii];
+          const __m128 w = _mm_mul_ps(_mm_set1_ps(filter[ii] * filter[jj]), weight_sse(px, px2, inv_sigma2));
+          sum = _mm_add_ps(sum, _mm_mul_ps(w, *px2));
+          wgt = _mm_add_ps(wgt, w);
         }
-        px2 += (width - 5) * mult;
       }
-      SUM_PIXEL_EPILOGUE_SSE
-    }
 
-    /* Last two pixels in the row require a slow variant... blablabla */
-    for(int i = width - 2 * mult; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE_SSE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE_SSE
+      sum = _mm_div_ps(sum, wgt);
+      const __m128 d = _mm_sub_ps(*px, sum);
+      _mm_stream_ps(pdetail, d);
+      _mm_stream_ps(pcoarse, sum);
+      sq = _mm_add_ps(sq, _mm_mul_ps(d, d));
+      px++;
+      pdetail += 4;
+      pcoarse += 4;
     }
-  }
-
-/* The last "2*mult" lines use the macro with tests because the 5x5 kernel
- * requires nearest pixel interpolation for at least a pixel in the sum */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, out, width) \
-  schedule(static)
-#endif
-  for(int j = height - 2 * mult; j < height; j++)
-  {
-    ROW_PROLOGUE_SSE
 
-    for(int i = 0; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE_SSE
-      for(int jj = 0; jj < 5; jj++)
-      {
-        for(int ii = 0; ii < 5; ii++)
-        {
-          SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE(ii, jj);
-        }
-      }
-      SUM_PIXEL_EPILOGUE_SSE
-    }
+    float sqf[4];
+    _mm_storeu_ps(sqf, sq);
+    sum0 += sqf[0];
+    sum1 += sqf[1];
+    sum2 += sqf[2];
   }
 
   _mm_sfence();
-}
 
-#undef SUM_PIXEL_CONTRIBUTION_COMMON_SSE
-#undef SUM_PIXEL_CONTRIBUTION_WITH_TEST_SSE
-#undef ROW_PROLOGUE_SSE
-#undef SUM_PIXEL_PROLOGUE_SSE
-#undef SUM_PIXEL_EPILOGUE_SSE
+  sum_y2[0] = sum0;
+  sum_y2[1] = sum1;
+  sum_y2[2] = sum2;
+}
 #endif
 
-typedef void((*eaw_synthesize_t)(float *const out, const float *const in, const float *const detail,
-                                 const float *thrsf, const float *boostf, const int32_t width,
-                                 const int32_t height));
+typedef void((*eaw_synthesize_t)(float *const out, const float *const in, float *const *const detail,
+                                 const float *const thrsf, const float *const boostf, const int max_scale,
+                                 const int32_t width, const int32_t height));
 
-static void eaw_synthesize(float *const out, const float *const in, const float *const detail,
-                           const float *thrsf, const float *boostf, const int32_t width, const int32_t height)
+/* The synthesis is pointwise, so instead of one pass over the whole image per
+ * scale all scales get added in a single pass, coarsest first as before.
+ * thrsf and boostf hold 4 values per scale. */
+static void eaw_synthesize(float *const out, const float *const in, float *const *const detail,
+                           const float *const thrsf, const float *const boostf, const int max_scale,
+                           const int32_t width, const int32_t height)
 {
-  const float threshold[4] = { thrsf[0], thrsf[1], thrsf[2], thrsf[3] };
-  const float boost[4] = { boostf[0], boostf[1], boostf[2], boostf[3] };
-
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(boost, detail, height, in, out, threshold, width) \
-  schedule(static) \
-  collapse(2)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(boostf, detail, height, in, max_scale, out, thrsf, width) \
+  schedule(static)
 #endif
-  for(size_t k = 0; k < (size_t)4 * width * height; k += 4)
+  for(int j = 0; j < height; j++)
   {
-    for(size_t c = 0; c < 4; c++)
+    for(size_t k = (size_t)4 * j * width; k < (size_t)4 * (j + 1) * width; k += 4)
     {
-      const float absamt = MAX(0.0f, (fabsf(detail[k + c]) - threshold[c]));
-      const float amount = copysignf(absamt, detail[k + c]);
-      out[k + c] = in[k + c] + (boost[c] * amount);
+      float px[4];
+      for(int c = 0; c < 4; c++) px[c] = in[k + c];
+      for(int s = max_scale - 1; s >= 0; s--)
+      {
+        for(int c = 0; c < 4; c++)
+        {
+          const float absamt = MAX(0.0f, (fabsf(detail[s][k + c]) - thrsf[4 * s + c]));
+          const float amount = copysignf(absamt, detail[s][k + c]);
+          px[c] += boostf[4 * s + c] * amount;
+        }
+      }
+      for(int c = 0; c < 4; c++) out[k + c] = px[c];
     }
   }
 }
 
 #if defined(__SSE2__)
-static void eaw_synthesize_sse2(float *const out, const float *const in, const float *const detail,
-                                const float *thrsf, const float *boostf, const int32_t width,
-                                const int32_t height)
+static void eaw_synthesize_sse2(float *const out, const float *const in, float *const *const detail,
+                                const float *const thrsf, const float *const boostf, const int max_scale,
+                                const int32_t width, const int32_t height)
 {
-  const __m128 threshold = _mm_set_ps(thrsf[3], thrsf[2], thrsf[1], thrsf[0]);
-  const __m128 boost = _mm_set_ps(boostf[3], boostf[2], boostf[1], boostf[0]);
-
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(boost, detail, height, in, out, threshold, width) \
+  dt_omp_firstprivate(boostf, detail, height, in, max_scale, out, thrsf, width) \
   schedule(static)
 #endif
   for(int j = 0; j < height; j++)
   {
-    // TODO: prefetch? _mm_prefetch()
-    const __m128 *pin = (__m128 *)in + (size_t)j * width;
-    __m128 *pdetail = (__m128 *)detail + (size_t)j * width;
-    float *pout = out + (size_t)4 * j * width;
+    const __m128i maski = _mm_set1_epi32(0x80000000u);
+    const __m128 mask = _mm_castsi128_ps(maski);
+    const size_t offset = (size_t)j * width;
+    const __m128 *pin = (__m128 *)in + offset;
+    float *pout = out + (size_t)4 * offset;
     for(int i = 0; i < width; i++)
     {
-#if 1
-      const __m128i maski = _mm_set1_epi32(0x80000000u);
-      const __m128 *mask = (__m128 *)&maski;
-      const __m128 absamt
-          = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_andnot_ps(*mask, *pdetail), threshold));
-      const __m128 amount = _mm_or_ps(_mm_and_ps(*pdetail, *mask), absamt);
-      _mm_stream_ps(pout, _mm_add_ps(*pin, _mm_mul_ps(boost, amount)));
-#endif
-      // _mm_stream_ps(pout, _mm_add_ps(*pin, *pdetail));
-      pdetail++;
+      __m128 px = *pin;
+      for(int s = max_scale - 1; s >= 0; s--)
+      {
+        const __m128 pdetail = ((__m128 *)detail[s])[offset + i];
+        const __m128 absamt
+            = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_andnot_ps(mask, pdetail), _mm_loadu_ps(thrsf + 4 * s)));
+        const __m128 amount = _mm_or_ps(_mm_and_ps(pdetail, mask), absamt);
+        px = _mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(boostf + 4 * s), amount));
+      }
+      _mm_stream_ps(pout, px);
       pin++;
       pout += 4;
     }
@@ -1629,12 +1422,15 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
   buf1 = (float *)ovoid;
   buf2 = tmp;
 
+  // sums of the squared details per scale and channel, filled in by decompose()
+  float sum_y2[MAX_MAX_SCALE][3];
+
   for(int scale = 0; scale < max_scale; scale++)
   {
     const float sigma = 1.0f;
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
-    decompose(buf2, buf1, buf[scale], scale, 1.0f / (sigma_band * sigma_band), width, height);
+    decompose(buf2, buf1, buf[scale], sum_y2[scale], scale, 1.0f / (sigma_band * sigma_band), width, height);
 // DEBUG: clean out temporary memory:
 // memset(buf1, 0, sizeof(float)*4*width*height);
 #if 0 // DEBUG: print wavelet scales:
@@ -1661,6 +1457,8 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
   }
 
   // now do everything backwards, so the result will end up in *ovoid
+  float thrs[MAX_MAX_SCALE][4];
+  float boost[MAX_MAX_SCALE][4];
   for(int scale = max_scale - 1; scale >= 0; scale--)
   {
 #if 1
@@ -1670,13 +1468,9 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
     // determine thrs as bayesshrink
-    // TODO: parallelize!
-    float sum_y2[3] = { 0.0f };
-    for(size_t k = 0; k < npixels; k++)
-      for(int c = 0; c < 3; c++) sum_y2[c] += buf[scale][4 * k + c] * buf[scale][4 * k + c];
-
     const float sb2 = sigma_band * sigma_band;
-    const float var_y[3] = { sum_y2[0] / (npixels - 1.0f), sum_y2[1] / (npixels - 1.0f), sum_y2[2] / (npixels - 1.0f) };
+    const float var_y[3] = { sum_y2[scale][0] / (npixels - 1.0f), sum_y2[scale][1] / (npixels - 1.0f),
+                             sum_y2[scale][2] / (npixels - 1.0f) };
     const float std_x[3] = { sqrtf(MAX(1e-6f, var_y[0] - sb2)), sqrtf(MAX(1e-6f, var_y[1] - sb2)),
                              sqrtf(MAX(1e-6f, var_y[2] - sb2)) };
     // add 8.0 here because it seemed a little weak
@@ -1726,23 +1520,19 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
       adjt[2] *= band_force_exp_2;
     }
 
-    const float thrs[4] = { adjt[0] * sb2 / std_x[0], adjt[1] * sb2 / std_x[1], adjt[2] * sb2 / std_x[2], 0.0f };
-// const float std = (std_x[0] + std_x[1] + std_x[2])/3.0f;
-// const float thrs[4] = { adjt*sigma*sigma/std, adjt*sigma*sigma/std, adjt*sigma*sigma/std, 0.0f};
-// fprintf(stderr, "scale %d thrs %f %f %f = %f / %f %f %f \n", scale, thrs[0], thrs[1], thrs[2], sb2,
-// std_x[0], std_x[1], std_x[2]);
+    thrs[scale][0] = adjt[0] * sb2 / std_x[0];
+    thrs[scale][1] = adjt[1] * sb2 / std_x[1];
+    thrs[scale][2] = adjt[2] * sb2 / std_x[2];
+    thrs[scale][3] = 0.0f;
+// fprintf(stderr, "scale %d thrs %f %f %f = %f / %f %f %f \n", scale, thrs[scale][0], thrs[scale][1],
+// thrs[scale][2], sb2, std_x[0], std_x[1], std_x[2]);
 #endif
-    const float boost[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    // const float thrs[4] = { 0.0, 0.0, 0.0, 0.0 };
-    synthesize(buf2, buf1, buf[scale], thrs, boost, width, height);
-    // DEBUG: clean out temporary memory:
-    // memset(buf1, 0, sizeof(float)*4*width*height);
-
-    float *buf3 = buf2;
-    buf2 = buf1;
-    buf1 = buf3;
+    for(int c = 0; c < 4; c++) boost[scale][c] = 1.0f;
   }
 
+  // buf1 holds the coarsest scale, add all the thresholded details to it at once
+  synthesize((float *)ovoid, buf1, buf, &thrs[0][0], &boost[0][0], max_scale, width, height);
+
   if(!d->use_new_vst)
   {
     backtransform((float *)ovoid, width, height, aa, bb);
@@ -29,6 +29,7 @@
 #include "common/debug.h"
 #include "common/imageio.h"
 #include "common/opencl.h"
+#include "common/warp.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -303,6 +304,35 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
 
 // 3rd (final) pass: you get this input region (may be different from what was requested above),
 // do your best to fill the output region!
+int distort_warp(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                 const dt_iop_roi_t *const roi_out, dt_warp_t *w)
+{
+  const dt_iop_flip_data_t *d = (dt_iop_flip_data_t *)piece->data;
+  const double wd = roi_in->width - 1, ht = roi_in->height - 1;
+  const int flip_x = d->orientation & ORIENTATION_FLIP_X;
+  const int flip_y = d->orientation & ORIENTATION_FLIP_Y;
+
+  // where dt_imageio_flip_buffers() takes each output pixel from, always an integer position
+  double m[9] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0 };
+  if(d->orientation & ORIENTATION_SWAP_XY)
+  {
+    m[1] = flip_x ? -1.0 : 1.0;
+    m[2] = flip_x ? wd : 0.0;
+    m[3] = flip_y ? -1.0 : 1.0;
+    m[5] = flip_y ? ht : 0.0;
+  }
+  else
+  {
+    m[0] = flip_x ? -1.0 : 1.0;
+    m[2] = flip_x ? wd : 0.0;
+    m[4] = flip_y ? -1.0 : 1.0;
+    m[5] = flip_y ? ht : 0.0;
+  }
+  dt_warp_init(w);
+  dt_warp_homography(w, m);
+  return 1;
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -41,6 +41,7 @@ struct dt_iop_module_t;
 struct dt_dev_pixelpipe_t;
 struct dt_dev_pixelpipe_iop_t;
 struct dt_iop_roi_t;
+struct dt_warp_t;
 struct dt_develop_tiling_t;
 struct dt_iop_buffer_dsc_t;
 struct _GtkWidget;
@@ -58,6 +59,9 @@ typedef void dt_iop_params_t;
 
 /** this initializes static, hardcoded presets for this module and is called only once per run of dt. */
 void init_presets(struct dt_iop_module_so_t *self);
+/** optional: everything else init_presets() depends on, e.g. the settings it reads. the presets are written
+ * again when this changes. */
+char *presets_stamp(struct dt_iop_module_so_t *self);
 /** called once per module, at startup. */
 void init_global(struct dt_iop_module_so_t *self);
 /** called once per module, at shutdown. */
@@ -214,6 +218,11 @@ int distort_backtransform(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_
 
 void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                   float *const out, const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out);
+/** the mapping process() resamples with, see common/warp.h. returns 0 if it is not a projective one or if
+ * process() does more than resampling with it. */
+int distort_warp(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                 const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                 struct dt_warp_t *w);
 
 // introspection related callbacks, will be auto-implemented if DT_MODULE_INTROSPECTION() is used,
 int introspection_init(struct dt_iop_module_so_t *self, int api_version);
@@ -254,6 +254,15 @@ typedef struct
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+typedef struct
+{
+  dt_iop_liquify_params_t params; // first, the pipe code uses piece->data as params
+  dt_pthread_mutex_t lock;        // protects the cached map
+  float complex *map;             // the distortion map built last in this pipe
+  cairo_rectangle_int_t map_extent;
+  GArray *warps;                  // the interpolated warps the map is the sum of
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   int warp_kernel;
@@ -1037,6 +1046,7 @@ static void build_round_stamp (float complex **pstamp,
 
 static void add_to_global_distortion_map (float complex *global_map,
                                           const cairo_rectangle_int_t *global_map_extent,
+                                          const cairo_rectangle_int_t *clip,
                                           const dt_liquify_warp_t *warp,
                                           const float complex *stamp,
                                           const cairo_rectangle_int_t *stamp_extent)
@@ -1046,9 +1056,9 @@ static void add_to_global_distortion_map (float complex *global_map,
   mmext.y += (int) round (cimag (warp->point));
   cairo_rectangle_int_t cmmext = mmext;
   cairo_region_t *mmreg = cairo_region_create_rectangle (&mmext);
-  cairo_region_intersect_rectangle (mmreg, global_map_extent);
+  cairo_region_intersect_rectangle (mmreg, clip);
   cairo_region_get_extents (mmreg, &cmmext);
-  free (mmreg);
+  cairo_region_destroy (mmreg);
 
   #ifdef _OPENMP
   #pragma omp parallel for schedule (static) default (shared)
@@ -1181,7 +1191,7 @@ static float complex *create_global_distortion_map (const cairo_rectangle_int_t
     float complex *stamp = NULL;
     cairo_rectangle_int_t r;
     build_round_stamp (&stamp, &r, warp);
-    add_to_global_distortion_map (map, map_extent, warp, stamp, &r);
+    add_to_global_distortion_map (map, map_extent, map_extent, warp, stamp, &r);
     free ((void *) stamp);
   }
 
@@ -1246,15 +1256,63 @@ static float complex *create_global_distortion_map (const cairo_rectangle_int_t
   return map;
 }
 
+// where add_to_global_distortion_map () puts the stamp of a warp
+
+static void _stamp_extent (cairo_rectangle_int_t *extent, const dt_liquify_warp_t *warp)
+{
+  const int iradius = round (cabs (warp->radius - warp->point));
+  extent->x = (int) round (creal (warp->point)) - iradius;
+  extent->y = (int) round (cimag (warp->point)) - iradius;
+  extent->width = extent->height = 2 * iradius + 1;
+}
+
+static guint _warp_hash (gconstpointer key)
+{
+  const dt_liquify_warp_t *warp = (const dt_liquify_warp_t *) key;
+  const float v[] = { creal (warp->point), cimag (warp->point), creal (warp->strength), cimag (warp->strength),
+                      creal (warp->radius), cimag (warp->radius) };
+  guint h = warp->type;
+  for (int k = 0; k < 6; k++)
+  {
+    guint32 bits;
+    memcpy (&bits, &v[k], sizeof (bits));
+    h = h * 31 + bits;
+  }
+  return h;
+}
+
+static gboolean _warp_equal (gconstpointer a, gconstpointer b)
+{
+  const dt_liquify_warp_t *wa = (const dt_liquify_warp_t *) a;
+  const dt_liquify_warp_t *wb = (const dt_liquify_warp_t *) b;
+  return wa->point == wb->point && wa->strength == wb->strength && wa->radius == wb->radius
+    && wa->control1 == wb->control1 && wa->control2 == wb->control2
+    && wa->type == wb->type && wa->status == wb->status;
+}
+
+/*
+  Build the distortion map for roi_out.
+
+  The map is the sum of the stamps of all warps, so after an edit it
+  only changes where the stamps of added or removed warps go.  We keep
+  the last map of the pipe together with the warps it was built from,
+  copy over what is still valid and stamp only the rest again.
+
+  The returned map belongs to the piece, the caller has to hold the
+  lock of dt_iop_liquify_data_t while using it.
+*/
+
 static float complex *build_global_distortion_map (struct dt_iop_module_t *module,
                                                    const dt_dev_pixelpipe_iop_t *piece,
                                                    const dt_iop_roi_t *roi_in,
                                                    const dt_iop_roi_t *roi_out,
                                                    cairo_rectangle_int_t *map_extent)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+
   // copy params
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece (module, piece->pipe, roi_in->scale, &copy_params, FALSE);
 
@@ -1262,7 +1320,117 @@ static float complex *build_global_distortion_map (struct dt_iop_module_t *modul
 
   _get_map_extent (roi_out, interpolated, map_extent);
 
-  float complex *map = create_global_distortion_map(map_extent, interpolated, FALSE);
+  // find the warps that are new or gone since the last map, their stamps make up the dirty region
+
+  cairo_region_t *dirty = cairo_region_create ();
+  GHashTable *old_warps = g_hash_table_new (_warp_hash, _warp_equal);
+
+  for (guint k = 0; k < d->warps->len; k++)
+  {
+    dt_liquify_warp_t *warp = &g_array_index (d->warps, dt_liquify_warp_t, k);
+    const int count = GPOINTER_TO_INT (g_hash_table_lookup (old_warps, warp));
+    g_hash_table_insert (old_warps, warp, GINT_TO_POINTER (count + 1));
+  }
+
+  for (GList *i = interpolated; i != NULL; i = i->next)
+  {
+    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
+    const int count = GPOINTER_TO_INT (g_hash_table_lookup (old_warps, warp));
+    if (count > 1)
+      g_hash_table_insert (old_warps, (gpointer) warp, GINT_TO_POINTER (count - 1));
+    else if (count == 1)
+      g_hash_table_remove (old_warps, warp);
+    else
+    {
+      cairo_rectangle_int_t r;
+      _stamp_extent (&r, warp);
+      cairo_region_union_rectangle (dirty, &r);
+    }
+  }
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init (&iter, old_warps);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+  {
+    cairo_rectangle_int_t r;
+    _stamp_extent (&r, (dt_liquify_warp_t *) key);
+    cairo_region_union_rectangle (dirty, &r);
+  }
+  g_hash_table_destroy (old_warps);
+
+  const size_t mapsize = (size_t) map_extent->width * map_extent->height;
+  float complex *map = NULL;
+
+  if (mapsize)
+  {
+    map = dt_alloc_align (64, mapsize * sizeof (float complex));
+
+    // everything not covered by an unchanged part of the last map has to be stamped again
+    cairo_region_t *todo = cairo_region_create_rectangle (map_extent);
+
+    if (d->map)
+    {
+      cairo_region_t *keep = cairo_region_create_rectangle (&d->map_extent);
+      cairo_region_intersect_rectangle (keep, map_extent);
+      cairo_region_subtract (keep, dirty);
+      cairo_region_subtract (todo, keep);
+
+      for (int k = 0; k < cairo_region_num_rectangles (keep); k++)
+      {
+        cairo_rectangle_int_t r;
+        cairo_region_get_rectangle (keep, k, &r);
+        for (int y = r.y; y < r.y + r.height; y++)
+          memcpy (map + (size_t) (y - map_extent->y) * map_extent->width + r.x - map_extent->x,
+                  d->map + (size_t) (y - d->map_extent.y) * d->map_extent.width + r.x - d->map_extent.x,
+                  sizeof (float complex) * r.width);
+      }
+      cairo_region_destroy (keep);
+    }
+
+    const int n_todo = cairo_region_num_rectangles (todo);
+
+    for (int k = 0; k < n_todo; k++)
+    {
+      cairo_rectangle_int_t r;
+      cairo_region_get_rectangle (todo, k, &r);
+      for (int y = r.y; y < r.y + r.height; y++)
+        memset (map + (size_t) (y - map_extent->y) * map_extent->width + r.x - map_extent->x, 0,
+                sizeof (float complex) * r.width);
+    }
+
+    for (GList *i = interpolated; i != NULL && n_todo > 0; i = i->next)
+    {
+      const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
+      cairo_rectangle_int_t r;
+      _stamp_extent (&r, warp);
+      if (cairo_region_contains_rectangle (todo, &r) == CAIRO_REGION_OVERLAP_OUT)
+        continue;
+
+      float complex *stamp = NULL;
+      build_round_stamp (&stamp, &r, warp);
+      for (int k = 0; k < n_todo; k++)
+      {
+        cairo_rectangle_int_t clip;
+        cairo_region_get_rectangle (todo, k, &clip);
+        add_to_global_distortion_map (map, map_extent, &clip, warp, stamp, &r);
+      }
+      free ((void *) stamp);
+    }
+
+    cairo_region_destroy (todo);
+  }
+
+  cairo_region_destroy (dirty);
+
+  // remember this map for the next run of the pipe
+
+  dt_free_align ((void *) d->map);
+  d->map = map;
+  d->map_extent = *map_extent;
+  g_array_set_size (d->warps, 0);
+  for (GList *i = interpolated; i != NULL; i = i->next)
+    g_array_append_val (d->warps, *((dt_liquify_warp_t *) i->data));
 
   g_list_free_full (interpolated, free);
   return map;
@@ -1436,14 +1604,15 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
 
   // 2. build the distortion map
 
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  dt_pthread_mutex_lock (&d->lock);
+
   cairo_rectangle_int_t map_extent;
-  float complex *map = build_global_distortion_map (self, piece, roi_in, roi_out, &map_extent);
-  if (map == NULL)
-    return;
+  const float complex *map = build_global_distortion_map (self, piece, roi_in, roi_out, &map_extent);
 
   // 3. apply the map
 
-  if (map_extent.width != 0 && map_extent.height != 0)
+  if (map != NULL && map_extent.width != 0 && map_extent.height != 0)
   {
     int ch = piece->colors;
     piece->colors = 1;
@@ -1451,8 +1620,7 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
     piece->colors = ch;
   }
 
-  dt_free_align ((void *) map);
-
+  dt_pthread_mutex_unlock (&d->lock);
 }
 
 void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, const void *const in,
@@ -1482,17 +1650,18 @@ void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, cons
 
   // 2. build the distortion map
 
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  dt_pthread_mutex_lock (&d->lock);
+
   cairo_rectangle_int_t map_extent;
-  float complex *map = build_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
-  if (map == NULL)
-    return;
+  const float complex *map = build_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
 
   // 3. apply the map
 
-  if (map_extent.width != 0 && map_extent.height != 0)
+  if (map != NULL && map_extent.width != 0 && map_extent.height != 0)
     apply_global_distortion_map (module, piece, in, out, roi_in, roi_out, map, &map_extent);
 
-  dt_free_align ((void *) map);
+  dt_pthread_mutex_unlock (&d->lock);
 }
 
 #ifdef HAVE_OPENCL
@@ -1648,17 +1817,18 @@ int process_cl (struct dt_iop_module_t *module,
 
   // 2. build the distortion map
 
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  dt_pthread_mutex_lock (&d->lock);
+
   cairo_rectangle_int_t map_extent;
   const float complex *map = build_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
-  if (map == NULL)
-    return TRUE;
 
   // 3. apply the map
 
-  if (map_extent.width != 0 && map_extent.height != 0)
+  if (map != NULL && map_extent.width != 0 && map_extent.height != 0)
     err = apply_global_distortion_map_cl (module, piece, dev_in, dev_out, roi_in, roi_out, map, &map_extent);
 
-  dt_free_align ((void *) map);
+  dt_pthread_mutex_unlock (&d->lock);
   if (err != CL_SUCCESS) goto error;
 
   return TRUE;
@@ -1710,12 +1880,19 @@ void cleanup(dt_iop_module_t *module)
 
 void init_pipe (struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc (module->params_size);
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) calloc (1, sizeof (dt_iop_liquify_data_t));
+  dt_pthread_mutex_init (&d->lock, NULL);
+  d->warps = g_array_new (FALSE, FALSE, sizeof (dt_liquify_warp_t));
+  piece->data = d;
   module->commit_params (module, module->default_params, pipe, piece);
 }
 
 void cleanup_pipe (struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  dt_free_align ((void *) d->map);
+  g_array_free (d->warps, TRUE);
+  dt_pthread_mutex_destroy (&d->lock);
   free (piece->data);
   piece->data = NULL;
 }
@@ -1903,6 +2080,37 @@ static GList *interpolate_paths (dt_iop_liquify_params_t *p)
 #define THINLINE  set_line_width  (cr, scale, DT_LIQUIFY_UI_WIDTH_THINLINE);
 #define THICKLINE set_line_width  (cr, scale, DT_LIQUIFY_UI_WIDTH_THICKLINE);
 
+// is pt within margin of the bounding box of everything drawn for a node?
+
+static gboolean _near_node (dt_iop_liquify_params_t *p, const dt_liquify_path_data_t *data,
+                            const float complex pt, const float margin)
+{
+  float xmin = creal (data->warp.point), xmax = xmin;
+  float ymin = cimag (data->warp.point), ymax = ymin;
+
+#define EXTEND(z) { xmin = fminf (xmin, creal (z)); xmax = fmaxf (xmax, creal (z)); \
+                    ymin = fminf (ymin, cimag (z)); ymax = fmaxf (ymax, cimag (z)); }
+
+  EXTEND (data->warp.strength);
+  EXTEND (data->warp.radius);
+  if (data->header.type == DT_LIQUIFY_PATH_LINE_TO_V1 || data->header.type == DT_LIQUIFY_PATH_CURVE_TO_V1)
+  {
+    const dt_liquify_path_data_t *prev = node_prev (p, data);
+    if (prev) EXTEND (prev->warp.point);
+  }
+  // a bezier curve stays inside the hull of its control points
+  if (data->header.type == DT_LIQUIFY_PATH_CURVE_TO_V1)
+  {
+    EXTEND (data->node.ctrl1);
+    EXTEND (data->node.ctrl2);
+  }
+
+#undef EXTEND
+
+  return creal (pt) >= xmin - margin && creal (pt) <= xmax + margin
+    && cimag (pt) >= ymin - margin && cimag (pt) <= ymax + margin;
+}
+
 static dt_liquify_hit_t _draw_paths (dt_iop_module_t *module,
                                      cairo_t *cr,
                                      const float scale,
@@ -1917,6 +2125,19 @@ static dt_liquify_hit_t _draw_paths (dt_iop_module_t *module,
 
   GList *interpolated = do_hit_test ? NULL : interpolate_paths (p);
 
+  // for hit testing only the nodes close to the pointer have to go through cairo
+  gboolean near[MAX_NODES] = { FALSE };
+  if (do_hit_test)
+  {
+    const float margin = 2.0f * GET_UI_WIDTH (GIZMO) + GET_UI_WIDTH (THICKLINE);
+    for (int k=0; k<MAX_NODES; k++)
+    {
+      if (p->nodes[k].header.type == DT_LIQUIFY_PATH_INVALIDATED)
+        break;
+      near[k] = _near_node (p, &p->nodes[k], *pt, margin);
+    }
+  }
+
   for (GList *l = layers; l != NULL; l = l->next)
   {
     const dt_liquify_layer_enum_t layer = (dt_liquify_layer_enum_t) GPOINTER_TO_INT (l->data);
@@ -1941,6 +2162,9 @@ static dt_liquify_hit_t _draw_paths (dt_iop_module_t *module,
 
       hit.elem = data;
 
+      if (do_hit_test && !near[k])
+        continue;
+
       if ((dt_liquify_layers[layer].flags & DT_LIQUIFY_LAYER_FLAG_NODE_SELECTED)
           && !data->header.selected)
         continue;
@@ -2296,14 +2520,27 @@ static void casteljau (const float complex *p0, float complex *p1, float complex
   *p3 = p0123;
 }
 
+static float complex bezier_at (const float complex p0,
+                                const float complex p1,
+                                const float complex p2,
+                                const float complex p3,
+                                const float t)
+{
+  const float t1 = 1.0 - t;
+  return
+        t1 * t1 * t1 * p0 +
+    3 * t1 * t1 * t  * p1 +
+    3 * t1 * t  * t  * p2 +
+        t  * t  * t  * p3;
+}
+
 /*
   Find the nearest point on a cubic bezier curve.
 
   Return the curve parameter t of the point on a cubic bezier curve
-  that is nearest to another arbitrary point.  Uses interpolation.
-
-  FIXME: Implement a faster method, see:
-  http://tog.acm.org/resources/GraphicsGems/gems/NearestPoint.c
+  that is nearest to another arbitrary point.  A coarse sampling finds
+  the neighbourhood of the nearest point, where the distance has a
+  single minimum that a golden section search then narrows down.
 */
 
 static float find_nearest_on_curve_t (const float complex p0,
@@ -2313,26 +2550,50 @@ static float find_nearest_on_curve_t (const float complex p0,
                                       const float complex x,
                                       const int n)
 {
+  const int coarse = MAX (n / 2, 8);
   float min_t = 0.0f, min_dist = cabs (x - p0);
 
-  for (int i = 0; i < n; i++)
+  for (int i = 1; i <= coarse; i++)
   {
-    const float t = (1.0 * i) / n;
-    const float t1 = 1.0 - t;
-    const float complex ip =
-          t1 * t1 * t1 * p0 +
-      3 * t1 * t1 * t  * p1 +
-      3 * t1 * t  * t  * p2 +
-          t  * t  * t  * p3;
-
-    const float dist = cabs (x - ip);
+    const float t = (1.0 * i) / coarse;
+    const float dist = cabs (x - bezier_at (p0, p1, p2, p3, t));
     if (dist < min_dist)
     {
       min_dist = dist;
       min_t = t;
     }
   }
-  return min_t;
+
+  const float g = 0.618034f;
+  float a = MAX (min_t - 1.0f / coarse, 0.0f);
+  float b = MIN (min_t + 1.0f / coarse, 1.0f);
+  float c = b - g * (b - a);
+  float e = a + g * (b - a);
+  float fc = cabs (x - bezier_at (p0, p1, p2, p3, c));
+  float fe = cabs (x - bezier_at (p0, p1, p2, p3, e));
+
+  for (int i = 0; i < 20; i++)
+  {
+    if (fc < fe)
+    {
+      b = e;
+      e = c;
+      fe = fc;
+      c = b - g * (b - a);
+      fc = cabs (x - bezier_at (p0, p1, p2, p3, c));
+    }
+    else
+    {
+      a = c;
+      c = e;
+      fc = fe;
+      e = a + g * (b - a);
+      fe = cabs (x - bezier_at (p0, p1, p2, p3, e));
+    }
+  }
+
+  const float t = 0.5f * (a + b);
+  return cabs (x - bezier_at (p0, p1, p2, p3, t)) < min_dist ? t : min_t;
 }
 
 /*
@@ -21,6 +21,7 @@
 #endif
 #include "bauhaus/bauhaus.h"
 #include "common/interpolation.h"
+#include "common/warp.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
 #include "develop/tiling.h"
@@ -159,12 +160,34 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   return 1;
 }
 
+// same as backtransform() for all pixels of roi_out, relative to roi_in
+static void _rotatepixels_warp(dt_warp_t *w, const dt_dev_pixelpipe_iop_t *const piece,
+                               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_rotatepixels_data_t *d = (dt_iop_rotatepixels_data_t *)piece->data;
+  const float scale = roi_in->scale / piece->iscale;
+  const float rt[] = { d->m[0], -d->m[1], -d->m[2], d->m[3] };
+
+  dt_warp_init(w);
+  dt_warp_translate(w, roi_out->x, roi_out->y);
+  dt_warp_linear(w, rt);
+  dt_warp_translate(w, d->rx * scale - roi_in->x, d->ry * scale - roi_in->y);
+}
+
+int distort_warp(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                 const dt_iop_roi_t *const roi_out, dt_warp_t *w)
+{
+  _rotatepixels_warp(w, piece, roi_in, roi_out);
+  return 1;
+}
+
 void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                   float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  // TODO
-  memset(out, 0, sizeof(float) * roi_out->width * roi_out->height);
-  fprintf(stderr, "TODO: implement %s() in %s\n", __FUNCTION__, __FILE__);
+  const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  dt_warp_t w;
+  _rotatepixels_warp(&w, piece, roi_in, roi_out);
+  dt_warp_process_1c(&w, interpolation, in, out, roi_in, roi_out);
 }
 
 // 1st pass: how large would the output be, given this input roi?
@@ -259,42 +282,12 @@ void modify_roi_in(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const d
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
-
-  const float scale = roi_in->scale / piece->iscale;
-
-  assert(ch == 4);
+  assert(piece->colors == 4);
 
   const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ch, ch_width, ivoid, ovoid, roi_in, roi_out, scale) \
-  shared(piece, interpolation) \
-  schedule(static)
-#endif
-  // (slow) point-by-point transformation.
-  // TODO: optimize with scanlines and linear steps between?
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *out = ((float *)ovoid) + (size_t)ch * j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++, out += ch)
-    {
-      float pi[2], po[2];
-
-      pi[0] = roi_out->x + i;
-      pi[1] = roi_out->y + j;
-
-      backtransform(piece, scale, pi, po);
-
-      po[0] -= roi_in->x;
-      po[1] -= roi_in->y;
-
-      dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out, po[0], po[1], roi_in->width,
-                                       roi_in->height, ch_width);
-    }
-  }
+  dt_warp_t w;
+  _rotatepixels_warp(&w, piece, roi_in, roi_out);
+  dt_warp_process(&w, interpolation, (const float *)ivoid, (float *)ovoid, roi_in, roi_out);
 }
 
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
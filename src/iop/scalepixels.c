@@ -20,6 +20,7 @@
 #endif
 #include "bauhaus/bauhaus.h"
 #include "common/interpolation.h"
+#include "common/warp.h"
 #include "develop/imageop.h"
 #include "develop/tiling.h"
 #include "gui/accelerators.h"
@@ -130,12 +131,24 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   return 1;
 }
 
+int distort_warp(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
+                 const dt_iop_roi_t *const roi_out, dt_warp_t *w)
+{
+  const dt_iop_scalepixels_data_t *const d = piece->data;
+  dt_warp_init(w);
+  dt_warp_scale(w, d->x_scale, d->y_scale);
+  return 1;
+}
+
 void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                   float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  // TODO
-  memset(out, 0, sizeof(float) * roi_out->width * roi_out->height);
-  fprintf(stderr, "TODO: implement %s() in %s\n", __FUNCTION__, __FILE__);
+  const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  const dt_iop_scalepixels_data_t *const d = piece->data;
+  dt_warp_t w;
+  dt_warp_init(&w);
+  dt_warp_scale(&w, d->x_scale, d->y_scale);
+  dt_warp_process_1c(&w, interpolation, in, out, roi_in, roi_out);
 }
 
 void modify_roi_out(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, dt_iop_roi_t *roi_out,
@@ -191,31 +204,14 @@ void modify_roi_in(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const d
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
   const struct dt_interpolation *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
-  const dt_iop_scalepixels_data_t * const d = piece->data;
+  const dt_iop_scalepixels_data_t *const d = piece->data;
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ch_width, d, ivoid, ovoid, roi_in, roi_out) \
-  shared(interpolation) \
-  schedule(static)
-#endif
-  // (slow) point-by-point transformation.
-  // TODO: optimize with scanlines and linear steps between?
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *out = ((float *)ovoid) + (size_t)4 * j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++, out += 4)
-    {
-      float x = i*d->x_scale;
-      float y = j*d->y_scale;
-
-      dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out, x, y, roi_in->width,
-                                       roi_in->height, ch_width);
-    }
-  }
+  // the vertical kernel is the same for a whole row here
+  dt_warp_t w;
+  dt_warp_init(&w);
+  dt_warp_scale(&w, d->x_scale, d->y_scale);
+  dt_warp_process(&w, interpolation, (const float *)ivoid, (float *)ovoid, roi_in, roi_out);
 }
 
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *params, dt_dev_pixelpipe_t *pipe,
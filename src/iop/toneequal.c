@@ -178,6 +178,11 @@ typedef struct dt_iop_toneequalizer_data_t
   int iterations;
   dt_iop_luminance_mask_method_t method;
   dt_iop_toneequalizer_filter_t details;
+
+  // luminance mask cache of the pipes not covered by the GUI caches
+  float *luminance;
+  size_t luminance_size;
+  uint64_t luminance_hash;
 } dt_iop_toneequalizer_data_t;
 
 
@@ -525,6 +530,28 @@ static void hash_set_get(uint64_t *hash_in, uint64_t *hash_out, dt_pthread_mutex
 }
 
 
+static uint64_t luminance_mask_hash(const dt_iop_toneequalizer_data_t *const d, const uint64_t upstream)
+{
+  // Extend the hash of the upstream pipe with the parameters the luminance mask is built from,
+  // so the cached masks follow any change of them (sliders, history, undo, styles)
+  // while edits of the tone curve alone (factors, smoothing) keep reusing them.
+  // Same bernstein hash as dt_dev_pixelpipe_cache_hash()
+  const struct
+  {
+    float blending, feathering, contrast_boost, exposure_boost, quantization, scale;
+    int radius, iterations;
+    dt_iop_luminance_mask_method_t method;
+    dt_iop_toneequalizer_filter_t details;
+  } mask = { d->blending, d->feathering, d->contrast_boost, d->exposure_boost, d->quantization, d->scale,
+             d->radius, d->iterations, d->method, d->details };
+
+  uint64_t hash = upstream;
+  const char *str = (const char *)&mask;
+  for(size_t i = 0; i < sizeof(mask); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+
 static void invalidate_luminance_cache(dt_iop_module_t *self)
 {
   // Invalidate the private luminance cache and histogram when
@@ -840,7 +867,7 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
              const void *const restrict ivoid, void *const restrict ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
-  const dt_iop_toneequalizer_data_t *const d = (const dt_iop_toneequalizer_data_t *const)piece->data;
+  dt_iop_toneequalizer_data_t *const d = (dt_iop_toneequalizer_data_t *const)piece->data;
   dt_iop_toneequalizer_gui_data_t *const g = (dt_iop_toneequalizer_gui_data_t *)self->gui_data;
 
   const float *const restrict in = dt_check_sse_aligned((float *const)ivoid);
@@ -860,9 +887,10 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   const size_t num_elem = width * height;
   const size_t ch = 4;
 
-  // Get the hash of the upstream pipe to track changes
+  // Get the hash of the upstream pipe and of the mask settings to track changes
   int position = self->iop_order;
-  uint64_t hash = dt_dev_pixelpipe_cache_hash(piece->pipe->image.id, roi_out, piece->pipe, position);
+  uint64_t hash = luminance_mask_hash(d, dt_dev_pixelpipe_cache_hash(piece->pipe->image.id, roi_out,
+                                                                     piece->pipe, position));
 
   // Sanity checks
   if(width < 1 || height < 1) return;
@@ -934,9 +962,20 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 
       dt_pthread_mutex_unlock(&g->lock);
     }
-    else // just to please GCC
+    else
     {
-      luminance = dt_alloc_sse_ps(num_elem);
+      // Other darkroom pipes (second window) keep their mask with the pipe piece,
+      // they are processed by one thread at a time so no lock is needed either
+      if(d->luminance_size != num_elem)
+      {
+        if(d->luminance) dt_free_align(d->luminance);
+        d->luminance = dt_alloc_sse_ps(num_elem);
+        d->luminance_size = (d->luminance) ? num_elem : 0;
+        d->luminance_hash = 0;
+      }
+
+      luminance = d->luminance;
+      cached = TRUE;
     }
 
   }
@@ -996,9 +1035,14 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       }
     }
 
-    else // make it dummy-proof
+    else
     {
-      compute_luminance_mask(in, luminance, width, height, ch, d);
+      if(d->luminance_hash != hash)
+      {
+        /* compute only if upstream pipe state or mask settings have changed */
+        compute_luminance_mask(in, luminance, width, height, ch, d);
+        d->luminance_hash = hash;
+      }
     }
   }
   else
@@ -1486,6 +1530,8 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_toneequalizer_data_t *d = (dt_iop_toneequalizer_data_t *)piece->data;
+  if(d->luminance) dt_free_align(d->luminance);
   free(piece->data);
   piece->data = NULL;
 }
@@ -99,6 +99,21 @@ static void _lib_histogram_change_callback(gpointer instance, gpointer user_data
   dt_control_queue_redraw_widget(self->widget);
 }
 
+static void _lib_histogram_preferences_changed(gpointer instance, gpointer user_data)
+{
+  dt_develop_t *dev = darktable.develop;
+  if(!dev || !dev->gui_attached) return;
+
+  const int sampling = CLAMP(dt_conf_get_int("plugins/darkroom/histogram/sampling"), 1, 8);
+  if(sampling == dev->histogram_sampling) return;
+  dev->histogram_sampling = sampling;
+
+  // the waveform and vectorscope are only computed by the preview pipe
+  if(dev->image_storage.id > 0
+     && (dev->scope_type == DT_DEV_SCOPE_WAVEFORM || dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE))
+    dt_dev_process_preview(dev);
+}
+
 static void _draw_color_toggle(cairo_t *cr, float x, float y, float width, float height, gboolean state)
 {
   const float border = MIN(width * .05, height * .05);
@@ -170,6 +185,14 @@ static void _draw_type_toggle(cairo_t *cr, float x, float y, float width, float
       cairo_pattern_destroy(pattern);
       break;
     }
+    case DT_DEV_SCOPE_VECTORSCOPE:
+      cairo_new_path(cr);
+      cairo_set_line_width(cr, border);
+      cairo_arc(cr, 0.5 * width, 0.5 * height, 0.5 * MIN(width, height) - 3.0 * border, 0, 2.0 * M_PI);
+      cairo_stroke(cr);
+      cairo_arc(cr, 0.45 * width, 0.55 * height, 0.15 * MIN(width, height), 0, 2.0 * M_PI);
+      cairo_fill(cr);
+      break;
   }
   cairo_restore(cr);
 }
@@ -282,18 +305,21 @@ static gboolean _lib_histogram_draw_callback(GtkWidget *widget, cairo_t *crf, gp
   const int waveform_width = dev->histogram_waveform_width;
   const int waveform_height = dev->histogram_waveform_height;
   const gint waveform_stride = dev->histogram_waveform_stride;
-  const size_t histsize = dev->scope_type == DT_DEV_SCOPE_WAVEFORM
-                            ? sizeof(uint8_t) * waveform_height * waveform_stride * 3
-                            : 256 * 4 * sizeof(uint32_t); // histogram size is hardcoded :(
-  void *buf = dt_alloc_align(64, histsize);
-
-  if(buf)
+  size_t histsize = 256 * 4 * sizeof(uint32_t); // histogram size is hardcoded :(
+  const void *src = dev->histogram;
+  if(dev->scope_type == DT_DEV_SCOPE_WAVEFORM)
   {
-    if(dev->scope_type == DT_DEV_SCOPE_WAVEFORM)
-      memcpy(buf, dev->histogram_waveform, histsize);
-    else
-      memcpy(buf, dev->histogram, histsize);
+    histsize = sizeof(uint8_t) * waveform_height * waveform_stride * 3;
+    src = dev->histogram_waveform;
   }
+  else if(dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE)
+  {
+    histsize = sizeof(uint8_t) * DT_DEV_VECTORSCOPE_SIZE * DT_DEV_VECTORSCOPE_SIZE;
+    src = dev->histogram_vectorscope;
+  }
+  void *buf = src ? dt_alloc_align(64, histsize) : NULL;
+
+  if(buf) memcpy(buf, src, histsize);
 
   dt_pthread_mutex_unlock(&dev->preview_pipe_mutex);
   if(buf == NULL) return FALSE;
@@ -336,8 +362,40 @@ static gboolean _lib_histogram_draw_callback(GtkWidget *widget, cairo_t *crf, gp
   // draw grid
   set_color(cr, darktable.bauhaus->graph_grid);
 
+  // the vectorscope is drawn into a centered square
+  const double vs_size = MIN(width, height) - DT_PIXEL_APPLY_DPI(4);
+  const double vs_x = 0.5 * (width - vs_size), vs_y = 0.5 * (height - vs_size);
+
   if(dev->scope_type == DT_DEV_SCOPE_WAVEFORM)
     dt_draw_waveform_lines(cr, 0, 0, width, height);
+  else if(dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE)
+  {
+    cairo_save(cr);
+    cairo_set_line_width(cr, DT_PIXEL_APPLY_DPI(.5));
+    cairo_arc(cr, width * 0.5, height * 0.5, vs_size * 0.5, 0, 2.0 * M_PI);
+    cairo_stroke(cr);
+    cairo_arc(cr, width * 0.5, height * 0.5, vs_size * 0.25, 0, 2.0 * M_PI);
+    cairo_stroke(cr);
+    cairo_move_to(cr, vs_x, height * 0.5);
+    cairo_line_to(cr, vs_x + vs_size, height * 0.5);
+    cairo_move_to(cr, width * 0.5, vs_y);
+    cairo_line_to(cr, width * 0.5, vs_y + vs_size);
+    cairo_stroke(cr);
+    // targets for the primaries and secondaries, at 75% of their chroma as on a video scope
+    const float targets[6][3] = { { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 0, 1, 1 }, { 0, 0, 1 }, { 1, 0, 1 } };
+    for(int k = 0; k < 6; k++)
+    {
+      const float *rgb = targets[k];
+      const float Y = 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+      const float u = 0.75f * (rgb[2] - Y) / 1.8556f, v = 0.75f * (rgb[0] - Y) / 1.5748f;
+      cairo_set_source_rgba(cr, rgb[0], rgb[1], rgb[2], 0.5);
+      cairo_rectangle(cr, vs_x + (0.5 + u) * vs_size - DT_PIXEL_APPLY_DPI(3),
+                      vs_y + (0.5 - v) * vs_size - DT_PIXEL_APPLY_DPI(3), DT_PIXEL_APPLY_DPI(6),
+                      DT_PIXEL_APPLY_DPI(6));
+      cairo_stroke(cr);
+    }
+    cairo_restore(cr);
+  }
   else
     dt_draw_grid(cr, 4, 0, 0, width, height);
 
@@ -398,6 +456,19 @@ static gboolean _lib_histogram_draw_callback(GtkWidget *widget, cairo_t *crf, gp
         }
       }
     }
+    else if(dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE)
+    {
+      cairo_surface_t *alpha
+          = cairo_image_surface_create_for_data(buf, CAIRO_FORMAT_A8, DT_DEV_VECTORSCOPE_SIZE,
+                                                DT_DEV_VECTORSCOPE_SIZE,
+                                                cairo_format_stride_for_width(CAIRO_FORMAT_A8,
+                                                                              DT_DEV_VECTORSCOPE_SIZE));
+      cairo_translate(cr, vs_x, vs_y);
+      cairo_scale(cr, vs_size / DT_DEV_VECTORSCOPE_SIZE, vs_size / DT_DEV_VECTORSCOPE_SIZE);
+      cairo_set_source_rgb(cr, 0.9, 0.9, 0.9);
+      cairo_mask_surface(cr, alpha, 0, 0);
+      cairo_surface_destroy(alpha);
+    }
     else if(dev->histogram_max)
     {
       uint32_t *hist = buf;
@@ -439,6 +510,9 @@ static gboolean _lib_histogram_draw_callback(GtkWidget *widget, cairo_t *crf, gp
       case DT_DEV_SCOPE_WAVEFORM:
         _draw_waveform_mode_toggle(cr, d->mode_x, d->button_y, d->button_w, d->button_h, d->waveform_type);
         break;
+      case DT_DEV_SCOPE_VECTORSCOPE:
+        // the vectorscope has no modes
+        break;
       case DT_DEV_SCOPE_N:
         g_assert_not_reached();
     }
@@ -474,7 +548,7 @@ static gboolean _lib_histogram_motion_notify_callback(GtkWidget *widget, GdkEven
 
   GtkAllocation allocation;
   gtk_widget_get_allocation(widget, &allocation);
-  if(d->dragging)
+  if(d->dragging && dev->scope_type != DT_DEV_SCOPE_VECTORSCOPE)
   {
     const float diff = dev->scope_type == DT_DEV_SCOPE_WAVEFORM ? d->button_down_y - event->y
                                                                 : event->x - d->button_down_x;
@@ -512,6 +586,9 @@ static gboolean _lib_histogram_motion_notify_callback(GtkWidget *widget, GdkEven
           gtk_widget_set_tooltip_text(widget, _("set mode to waveform"));
           break;
         case DT_DEV_SCOPE_WAVEFORM:
+          gtk_widget_set_tooltip_text(widget, _("set mode to vectorscope"));
+          break;
+        case DT_DEV_SCOPE_VECTORSCOPE:
           gtk_widget_set_tooltip_text(widget, _("set mode to histogram"));
           break;
         case DT_DEV_SCOPE_N:
@@ -549,6 +626,9 @@ static gboolean _lib_histogram_motion_notify_callback(GtkWidget *widget, GdkEven
               g_assert_not_reached();
           }
           break;
+        case DT_DEV_SCOPE_VECTORSCOPE:
+          gtk_widget_set_tooltip_text(widget, NULL);
+          break;
         case DT_DEV_SCOPE_N:
           g_assert_not_reached();
       }
@@ -575,6 +655,12 @@ static gboolean _lib_histogram_motion_notify_callback(GtkWidget *widget, GdkEven
       d->highlight = DT_LIB_HISTOGRAM_HIGHLIGHT_BLACK_POINT;
       gtk_widget_set_tooltip_text(widget, _("drag to change black point,\ndoubleclick resets"));
     }
+    else if(dev->scope_type == DT_DEV_SCOPE_VECTORSCOPE)
+    {
+      // the vectorscope has no axis to drag exposure along
+      d->highlight = DT_LIB_HISTOGRAM_HIGHLIGHT_NONE;
+      gtk_widget_set_tooltip_text(widget, NULL);
+    }
     else
     {
       d->highlight = DT_LIB_HISTOGRAM_HIGHLIGHT_EXPOSURE;
@@ -622,7 +708,8 @@ static gboolean _lib_histogram_button_press_callback(GtkWidget *widget, GdkEvent
       dev->scope_type = (dev->scope_type + 1) % DT_DEV_SCOPE_N;
       dt_conf_set_string("plugins/darkroom/histogram/mode",
                          dt_dev_scope_type_names[dev->scope_type]);
-      // we need to reprocess the preview pipe
+      // we need to reprocess the preview pipe. the waveform and the vectorscope are computed together, so
+      // going on from the waveform to the vectorscope has the data already
       // FIXME: can we only make the regular histogram if we're drawing it? if so then reprocess the preview pipe when switch to that as well
       if(dev->scope_type == DT_DEV_SCOPE_WAVEFORM)
       {
@@ -643,6 +730,8 @@ static gboolean _lib_histogram_button_press_callback(GtkWidget *widget, GdkEvent
           dt_conf_set_string("plugins/darkroom/histogram/waveform",
                              dt_lib_histogram_waveform_type_names[d->waveform_type]);
           break;
+        case DT_DEV_SCOPE_VECTORSCOPE:
+          break;
         case DT_DEV_SCOPE_N:
           g_assert_not_reached();
       }
@@ -662,7 +751,7 @@ static gboolean _lib_histogram_button_press_callback(GtkWidget *widget, GdkEvent
       d->blue = !d->blue;
       dt_conf_set_bool("plugins/darkroom/histogram/show_blue", d->blue);
     }
-    else
+    else if(dev->scope_type != DT_DEV_SCOPE_VECTORSCOPE)
     {
       d->dragging = 1;
 
@@ -802,12 +891,16 @@ void gui_init(dt_lib_module_t *self)
   /* connect to preview pipe finished  signal */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_DEVELOP_PREVIEW_PIPE_FINISHED,
                             G_CALLBACK(_lib_histogram_change_callback), self);
+  /* the sampling of the scopes can be changed in the preferences */
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_PREFERENCES_CHANGE,
+                            G_CALLBACK(_lib_histogram_preferences_changed), self);
 }
 
 void gui_cleanup(dt_lib_module_t *self)
 {
   /* disconnect callback from  signal */
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_lib_histogram_change_callback), self);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_lib_histogram_preferences_changed), self);
 
   g_free(self->data);
   self->data = NULL;
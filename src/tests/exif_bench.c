@@ -0,0 +1,121 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// reads the metadata of all images in a folder, as done on import, with 1..T threads and reports the scaling.
+// usage: darktable-bench-exif <folder> [max threads]
+
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static GPtrArray *_list_images(const char *folder)
+{
+  GDir *dir = g_dir_open(folder, 0, NULL);
+  if(!dir) return NULL;
+  GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    gchar *filename = g_build_filename(folder, name, NULL);
+    if(g_file_test(filename, G_FILE_TEST_IS_REGULAR) && dt_supported_image(name))
+      g_ptr_array_add(files, filename);
+    else
+      g_free(filename);
+  }
+  g_dir_close(dir);
+  return files;
+}
+
+// returns the number of files that could not be read
+static int _read_all(GPtrArray *files, const int threads)
+{
+  const int count = files->len;
+  int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(count, files) \
+  reduction(+ : failed) \
+  num_threads(threads) \
+  schedule(dynamic)
+#endif
+  for(int k = 0; k < count; k++)
+  {
+    dt_image_t img;
+    dt_image_init(&img);
+    if(dt_exif_read(&img, g_ptr_array_index(files, k))) failed++;
+  }
+  return failed;
+}
+
+int main(int argc, char *arg[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s <folder> [max threads]\n", arg[0]);
+    exit(1);
+  }
+
+  char *argv[] = { "darktable-bench-exif", "--library", ":memory:", "--conf", "write_sidecar_files=FALSE", NULL };
+  int dt_argc = sizeof(argv) / sizeof(*argv) - 1;
+
+  // init dt without gui and without data.db:
+  if(dt_init(dt_argc, argv, FALSE, FALSE, NULL)) exit(1);
+
+  GPtrArray *files = _list_images(arg[1]);
+  if(!files || files->len == 0)
+  {
+    fprintf(stderr, "no supported images found in `%s'\n", arg[1]);
+    if(files) g_ptr_array_free(files, TRUE);
+    dt_cleanup();
+    exit(1);
+  }
+
+  const int max_threads = argc > 2 ? MAX(1, atoi(arg[2])) : dt_get_num_threads();
+
+  // read everything once so that all runs find the files in the page cache
+  _read_all(files, max_threads);
+
+  printf("%u images\n", files->len);
+  printf("threads     seconds    images/s   speedup\n");
+  double single = 0.0;
+  for(int threads = 1; threads <= max_threads; threads++)
+  {
+    const double start = dt_get_wtime();
+    const int failed = _read_all(files, threads);
+    const double elapsed = dt_get_wtime() - start;
+    if(threads == 1) single = elapsed;
+    printf("%7d %11.3f %11.1f %9.2f", threads, elapsed, files->len / elapsed, single / elapsed);
+    if(failed) printf("   (%d failed)", failed);
+    printf("\n");
+  }
+
+  g_ptr_array_free(files, TRUE);
+  dt_cleanup();
+
+  return 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,310 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// times the shared pixel kernels and the process() of single modules with their default parameters on
+// synthetic buffers, on the cpu only. runs everything when no names are given.
+// usage: darktable-bench-kernels [-s <width>x<height>] [-n <runs>] [kernel or module operation ...]
+
+#include "common/bilateral.h"
+#include "common/darktable.h"
+#include "common/gaussian.h"
+#include "common/guided_filter.h"
+#include "common/locallaplacian.h"
+#include "develop/blend.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/imageop_math.h"
+#include "develop/pixelpipe.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct bench_buffers_t
+{
+  int width, height;
+  float *rgb; // linear rgb in [0, 1]
+  float *lab; // the same with L in [0, 100], for the kernels working on Lab
+  float *out;
+} bench_buffers_t;
+
+typedef void (*bench_kernel_t)(const bench_buffers_t *b);
+
+static void _gaussian(const bench_buffers_t *b)
+{
+  const float max[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+  const float min[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  dt_gaussian_t *g = dt_gaussian_init(b->width, b->height, 4, max, min, 8.0f, 0);
+  if(!g) return;
+  dt_gaussian_blur_4c(g, b->rgb, b->out);
+  dt_gaussian_free(g);
+}
+
+static void _bilateral(const bench_buffers_t *b)
+{
+  dt_bilateral_t *bil = dt_bilateral_init(b->width, b->height, 20.0f, 10.0f);
+  if(!bil) return;
+  dt_bilateral_splat(bil, b->lab);
+  dt_bilateral_blur(bil);
+  dt_bilateral_slice(bil, b->lab, b->out, 1.0f);
+  dt_bilateral_free(bil);
+}
+
+static void _guided_filter(const bench_buffers_t *b)
+{
+  guided_filter(b->rgb, b->rgb, b->out, b->width, b->height, 4, 16, 0.05f, 1.0f, -FLT_MAX, FLT_MAX);
+}
+
+static void _local_laplacian(const bench_buffers_t *b)
+{
+  local_laplacian(b->lab, b->out, b->width, b->height, 0.2f, 0.5f, 0.5f, 0.25f, NULL);
+}
+
+static void _clip_and_zoom(const bench_buffers_t *b)
+{
+  const dt_iop_roi_t roi_in = { 0, 0, b->width, b->height, 1.0f };
+  const dt_iop_roi_t roi_out = { 0, 0, b->width / 2, b->height / 2, 0.5f };
+  dt_iop_clip_and_zoom(b->out, b->rgb, &roi_out, &roi_in, roi_out.width, roi_in.width);
+}
+
+static const struct
+{
+  const char *name;
+  bench_kernel_t run;
+} _kernels[] = {
+  { "gaussian", _gaussian },
+  { "bilateral", _bilateral },
+  { "guided_filter", _guided_filter },
+  { "local_laplacian", _local_laplacian },
+  { "clip_and_zoom", _clip_and_zoom },
+};
+
+// modules with plain rgb/Lab in and out, which need no image data to process a synthetic buffer
+static const char *_default_modules[] = { "exposure", "colorbalance", "filmicrgb", "bilat", "sharpen", "highpass" };
+
+static void _report(const char *name, const double *times, const int runs, const bench_buffers_t *b)
+{
+  double best = times[0], sum = 0.0;
+  for(int k = 0; k < runs; k++)
+  {
+    best = MIN(best, times[k]);
+    sum += times[k];
+  }
+  const double mpix = (double)b->width * b->height / 1.0e6;
+  printf("%-20s %10.4f %10.4f %12.1f\n", name, best, sum / runs, mpix / best);
+}
+
+static void _time_kernel(const char *name, bench_kernel_t run, const int runs, const bench_buffers_t *b)
+{
+  double *times = calloc(runs, sizeof(double));
+  run(b); // warm up caches and lazily initialized tables
+  for(int k = 0; k < runs; k++)
+  {
+    const double start = dt_get_wtime();
+    run(b);
+    times[k] = dt_get_wtime() - start;
+  }
+  _report(name, times, runs, b);
+  free(times);
+}
+
+static dt_iop_module_so_t *_find_module_so(const char *op)
+{
+  for(GList *iop = darktable.iop; iop; iop = g_list_next(iop))
+  {
+    dt_iop_module_so_t *so = (dt_iop_module_so_t *)iop->data;
+    if(!strcmp(so->op, op)) return so;
+  }
+  return NULL;
+}
+
+// runs process() of a module with its default parameters, as a thumbnail pipe would without tiling
+static int _time_module(const char *op, dt_develop_t *dev, const int runs, const bench_buffers_t *b)
+{
+  dt_iop_module_so_t *so = _find_module_so(op);
+  if(!so) return 1;
+
+  dt_iop_module_t *module = (dt_iop_module_t *)calloc(1, sizeof(dt_iop_module_t));
+  if(dt_iop_load_module(module, so, dev)) return 1; // frees module
+  if(!module->process)
+  {
+    dt_iop_cleanup_module(module);
+    free(module);
+    return 1;
+  }
+
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_init_dummy(&pipe, b->width, b->height);
+  pipe.iwidth = b->width;
+  pipe.iheight = b->height;
+  pipe.dsc.channels = 4;
+  pipe.dsc.datatype = TYPE_FLOAT;
+  for(int c = 0; c < 4; c++) pipe.dsc.processed_maximum[c] = 1.0f;
+
+  const dt_iop_roi_t roi = { 0, 0, b->width, b->height, 1.0f };
+  dt_dev_pixelpipe_iop_t piece = { 0 };
+  piece.module = module;
+  piece.pipe = &pipe;
+  piece.enabled = 1;
+  piece.colors = 4;
+  piece.bpc = 32;
+  piece.iscale = 1.0f;
+  piece.iwidth = b->width;
+  piece.iheight = b->height;
+  piece.buf_in = piece.buf_out = roi;
+  piece.blendop_data = calloc(1, sizeof(dt_develop_blend_params_t));
+  piece.dsc_in = piece.dsc_out = pipe.dsc;
+
+  module->init_pipe(module, &pipe, &piece);
+  module->commit_params(module, module->default_params, &pipe, &piece);
+
+  // the Lab modules get the Lab buffer, all others linear rgb
+  const int cst = module->input_colorspace(module, &pipe, &piece);
+  const float *const in = (cst == iop_cs_Lab) ? b->lab : b->rgb;
+
+  double *times = calloc(runs, sizeof(double));
+  module->process(module, &piece, in, b->out, &roi, &roi);
+  for(int k = 0; k < runs; k++)
+  {
+    const double start = dt_get_wtime();
+    module->process(module, &piece, in, b->out, &roi, &roi);
+    times[k] = dt_get_wtime() - start;
+  }
+  _report(op, times, runs, b);
+  free(times);
+
+  module->cleanup_pipe(module, &pipe, &piece);
+  free(piece.blendop_data);
+  dt_dev_pixelpipe_cleanup(&pipe);
+  dt_iop_cleanup_module(module);
+  free(module);
+  return 0;
+}
+
+// smooth gradients with some fine detail on top, the same on every run
+static void _fill_buffers(bench_buffers_t *b)
+{
+  uint32_t state = 0x12345678u;
+  for(int j = 0; j < b->height; j++)
+    for(int i = 0; i < b->width; i++)
+    {
+      const size_t k = 4 * ((size_t)j * b->width + i);
+      state = state * 1664525u + 1013904223u;
+      const float noise = (state >> 8) * (0.05f / 16777216.0f);
+      const float x = (float)i / b->width, y = (float)j / b->height;
+      b->rgb[k + 0] = CLAMP(x * x + noise, 0.0f, 1.0f);
+      b->rgb[k + 1] = CLAMP(0.5f * (x + y) + noise, 0.0f, 1.0f);
+      b->rgb[k + 2] = CLAMP(y * (1.0f - x) + noise, 0.0f, 1.0f);
+      b->rgb[k + 3] = 0.0f;
+      b->lab[k + 0] = 100.0f * b->rgb[k + 1];
+      b->lab[k + 1] = 50.0f * (b->rgb[k + 0] - b->rgb[k + 1]);
+      b->lab[k + 2] = 50.0f * (b->rgb[k + 1] - b->rgb[k + 2]);
+      b->lab[k + 3] = 0.0f;
+    }
+}
+
+int main(int argc, char *arg[])
+{
+  int width = 3000, height = 2000, runs = 5;
+  int first = 1;
+  while(first < argc && arg[first][0] == '-')
+  {
+    if(!strcmp(arg[first], "-s") && first + 1 < argc && sscanf(arg[first + 1], "%dx%d", &width, &height) == 2)
+      first += 2;
+    else if(!strcmp(arg[first], "-n") && first + 1 < argc)
+    {
+      runs = MAX(1, atoi(arg[first + 1]));
+      first += 2;
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-s <width>x<height>] [-n <runs>] [kernel or module operation ...]\n", arg[0]);
+      exit(1);
+    }
+  }
+
+  char *argv[] = { "darktable-bench-kernels", "--library", ":memory:", "--conf", "write_sidecar_files=FALSE", NULL };
+  int dt_argc = sizeof(argv) / sizeof(*argv) - 1;
+
+  // init dt without gui and without data.db:
+  if(dt_init(dt_argc, argv, FALSE, FALSE, NULL)) exit(1);
+
+  bench_buffers_t b = { .width = MAX(width, 2), .height = MAX(height, 2) };
+  const size_t size = (size_t)b.width * b.height * 4;
+  b.rgb = dt_alloc_align(64, size * sizeof(float));
+  b.lab = dt_alloc_align(64, size * sizeof(float));
+  b.out = dt_alloc_align(64, size * sizeof(float));
+  if(!b.rgb || !b.lab || !b.out)
+  {
+    fprintf(stderr, "could not allocate the %dx%d buffers\n", b.width, b.height);
+    dt_cleanup();
+    exit(1);
+  }
+  _fill_buffers(&b);
+
+  dt_develop_t dev;
+  dt_dev_init(&dev, FALSE);
+
+  printf("%dx%d pixels, %d runs, %d threads\n", b.width, b.height, runs, dt_get_num_threads());
+  printf("kernel                 best [s]   mean [s]  best [Mpix/s]\n");
+
+  int failed = 0;
+  const int n_kernels = sizeof(_kernels) / sizeof(*_kernels);
+  const int n_modules = sizeof(_default_modules) / sizeof(*_default_modules);
+  if(first >= argc)
+  {
+    for(int k = 0; k < n_kernels; k++) _time_kernel(_kernels[k].name, _kernels[k].run, runs, &b);
+    for(int k = 0; k < n_modules; k++)
+      if(_time_module(_default_modules[k], &dev, runs, &b))
+      {
+        fprintf(stderr, "module `%s' could not be run\n", _default_modules[k]);
+        failed++;
+      }
+  }
+  else
+  {
+    for(int a = first; a < argc; a++)
+    {
+      int found = 0;
+      for(int k = 0; k < n_kernels; k++)
+        if(!strcmp(arg[a], _kernels[k].name))
+        {
+          _time_kernel(_kernels[k].name, _kernels[k].run, runs, &b);
+          found = 1;
+        }
+      if(!found && _time_module(arg[a], &dev, runs, &b))
+      {
+        fprintf(stderr, "no kernel or module `%s' to run\n", arg[a]);
+        failed++;
+      }
+    }
+  }
+
+  dt_dev_cleanup(&dev);
+  dt_free_align(b.rgb);
+  dt_free_align(b.lab);
+  dt_free_align(b.out);
+  dt_cleanup();
+
+  return failed ? 1 : 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,180 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// times splat, merge, blur and slice of the permutohedral lattice against the version before the parallel
+// merge, on the 5d lattice of the surface blur module, and checks that both filter the same.
+// usage: darktable-bench-permutohedral [-s <width>x<height>] [-n <runs>]
+
+#include "iop/Permutohedral.h"
+#include "tests/permutohedral_baseline.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#define omp_get_thread_num() 0
+#endif
+
+#include <chrono>
+
+typedef struct bench_times_t
+{
+  double splat, merge, blur, slice;
+} bench_times_t;
+
+static double _now()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the same filter as the surface blur module: position is x, y and the color, the value the color and a
+// homogeneous weight
+template <typename Lattice>
+static void _filter(const float *in, float *out, const int width, const int height, const float *sigma,
+                    bench_times_t *t)
+{
+  double start = _now();
+  Lattice lattice((size_t)width * height, omp_get_max_threads());
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    const int thread = omp_get_thread_num();
+    for(int i = 0; i < width; i++)
+    {
+      const size_t index = (size_t)j * width + i;
+      const float *px = in + 4 * index;
+      float pos[5] = { i * sigma[0], j * sigma[1], px[0] * sigma[2], px[1] * sigma[2], px[2] * sigma[2] };
+      float val[4] = { px[0], px[1], px[2], 1.0f };
+      lattice.splat(pos, val, index, thread);
+    }
+  }
+  double end = _now();
+  t->splat += end - start;
+  start = end;
+
+  lattice.merge_splat_threads();
+  end = _now();
+  t->merge += end - start;
+  start = end;
+
+  lattice.blur();
+  end = _now();
+  t->blur += end - start;
+  start = end;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      const size_t index = (size_t)j * width + i;
+      float val[4];
+      lattice.slice(val, index);
+      for(int c = 0; c < 3; c++) out[4 * index + c] = val[c] / val[3];
+      out[4 * index + 3] = 0.0f;
+    }
+  t->slice += _now() - start;
+}
+
+static void _report(const char *name, const bench_times_t *t, const int runs)
+{
+  printf("%-10s %10.4f %10.4f %10.4f %10.4f %10.4f\n", name, t->splat / runs, t->merge / runs, t->blur / runs,
+         t->slice / runs, (t->splat + t->merge + t->blur + t->slice) / runs);
+}
+
+int main(int argc, char *arg[])
+{
+  int width = 3000, height = 2000, runs = 5;
+  for(int k = 1; k < argc; k++)
+  {
+    if(!strcmp(arg[k], "-s") && k + 1 < argc && sscanf(arg[k + 1], "%dx%d", &width, &height) == 2)
+      k++;
+    else if(!strcmp(arg[k], "-n") && k + 1 < argc)
+      runs = std::max(1, atoi(arg[++k]));
+    else
+    {
+      fprintf(stderr, "usage: %s [-s <width>x<height>] [-n <runs>]\n", arg[0]);
+      exit(1);
+    }
+  }
+  width = std::max(width, 2);
+  height = std::max(height, 2);
+
+  const size_t size = (size_t)4 * width * height;
+  float *in = new float[size];
+  float *out_new = new float[size];
+  float *out_old = new float[size];
+
+  // smooth gradients with some fine detail on top, the same on every run
+  uint32_t state = 0x12345678u;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      float *px = in + 4 * ((size_t)j * width + i);
+      state = state * 1664525u + 1013904223u;
+      const float noise = (state >> 8) * (0.05f / 16777216.0f);
+      const float x = (float)i / width, y = (float)j / height;
+      px[0] = x * x + noise;
+      px[1] = 0.5f * (x + y) + noise;
+      px[2] = y * (1.0f - x) + noise;
+      px[3] = 0.0f;
+    }
+
+  // the module defaults: 20 pixels spatial, 0.1 range sigma
+  const float sigma[3] = { 1.0f / 20.0f, 1.0f / 20.0f, 1.0f / 0.1f };
+
+  // warm up
+  bench_times_t t_new = { 0 }, t_old = { 0 };
+  _filter<PermutohedralLattice<5, 4>>(in, out_new, width, height, sigma, &t_new);
+  _filter<baseline::PermutohedralLattice<5, 4>>(in, out_old, width, height, sigma, &t_old);
+
+  t_new = t_old = (bench_times_t){ 0 };
+  for(int k = 0; k < runs; k++)
+  {
+    _filter<PermutohedralLattice<5, 4>>(in, out_new, width, height, sigma, &t_new);
+    _filter<baseline::PermutohedralLattice<5, 4>>(in, out_old, width, height, sigma, &t_old);
+  }
+
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < size; k++) maxdiff = std::max(maxdiff, fabsf(out_new[k] - out_old[k]));
+
+  printf("%dx%d, %d threads, mean of %d runs in seconds\n", width, height, omp_get_max_threads(), runs);
+  printf("%-10s %10s %10s %10s %10s %10s\n", "lattice", "splat", "merge", "blur", "slice", "total");
+  _report("baseline", &t_old, runs);
+  _report("current", &t_new, runs);
+  printf("max difference of the output: %g\n", maxdiff);
+
+  delete[] in;
+  delete[] out_new;
+  delete[] out_old;
+  return 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
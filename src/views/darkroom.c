@@ -27,6 +27,7 @@
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
+#include "common/mipmap_cache.h"
 #include "common/selection.h"
 #include "common/styles.h"
 #include "common/tags.h"
@@ -102,6 +103,9 @@ static void _view_darkroom_filmstrip_activate_callback(gpointer instance, int im
 
 static void dt_dev_change_image(dt_develop_t *dev, const uint32_t imgid);
 
+static void _darkroom_prefetch_neighbours(dt_develop_t *dev);
+static void _darkroom_prefetch_cancel(void);
+
 static void _darkroom_display_second_window(dt_develop_t *dev);
 static void _darkroom_ui_second_window_write_config(GtkWidget *widget);
 
@@ -697,6 +701,120 @@ static void dt_dev_cleanup_module_accels(dt_iop_module_t *module)
   dt_accel_cleanup_locals_iop(module);
 }
 
+/* speculative loading of the images next to the one being edited. the full raw decode
+ * is what makes switching images slow, so we warm DT_MIPMAP_FULL (and optionally the
+ * preview pipe input DT_MIPMAP_F) of the neighbours on a background job. */
+
+typedef struct dt_darkroom_prefetch_t
+{
+  int32_t imgid;
+  uint32_t generation;
+} dt_darkroom_prefetch_t;
+
+// bumped whenever the darkroom image changes, pending prefetch jobs of an older
+// generation are stale and return without decoding anything.
+static uint32_t _prefetch_generation = 0;
+// direction of the last filmstrip navigation, 1 forward, -1 backward
+static int _prefetch_direction = 1;
+
+static gboolean _darkroom_prefetch_is_stale(const dt_darkroom_prefetch_t *params)
+{
+  return params->generation != __sync_fetch_and_add(&_prefetch_generation, 0);
+}
+
+static int32_t _darkroom_prefetch_job_run(dt_job_t *job)
+{
+  const dt_darkroom_prefetch_t *params = dt_control_job_get_params(job);
+  if(_darkroom_prefetch_is_stale(params)) return 0;
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, params->imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+
+  // the downscaled input of the preview pipe is cheap once the full buffer is in cache
+  if(!_darkroom_prefetch_is_stale(params) && dt_conf_get_bool("plugins/darkroom/prefetch/preview"))
+  {
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, params->imgid, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  }
+
+  dt_print(DT_DEBUG_DEV, "[darkroom] prefetched image %d\n", params->imgid);
+  return 0;
+}
+
+static void _darkroom_prefetch_cancel(void)
+{
+  __sync_fetch_and_add(&_prefetch_generation, 1);
+}
+
+static size_t _darkroom_prefetch_estimate_size(const int32_t imgid, const dt_image_t *current)
+{
+  const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(!img) return 0;
+  // the buffer format is only known once the image has been loaded at least once, assume 4 floats until then
+  const size_t bpp = img->buf_dsc.channels ? dt_iop_buffer_dsc_to_bpp(&img->buf_dsc) : 4 * sizeof(float);
+  size_t size = (size_t)img->width * img->height * bpp;
+  dt_image_cache_read_release(darktable.image_cache, img);
+  // and without dimensions either, neighbours most likely come from the same camera as the current image
+  if(size == 0) size = (size_t)current->width * current->height * 4 * sizeof(float);
+  return size;
+}
+
+static void _darkroom_prefetch_add(const int32_t imgid, const uint32_t generation)
+{
+  dt_job_t *job = dt_control_job_create(&_darkroom_prefetch_job_run, "prefetch image %d", imgid);
+  if(!job) return;
+  dt_darkroom_prefetch_t *params = (dt_darkroom_prefetch_t *)calloc(1, sizeof(dt_darkroom_prefetch_t));
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return;
+  }
+  params->imgid = imgid;
+  params->generation = generation;
+  dt_control_job_set_params_with_size(job, params, sizeof(dt_darkroom_prefetch_t), free);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, job);
+}
+
+static void _darkroom_prefetch_neighbours(dt_develop_t *dev)
+{
+  // new image, new generation: whatever is still queued for the old one is obsolete
+  _darkroom_prefetch_cancel();
+
+  const size_t max_mem = (size_t)MAX(dt_conf_get_int("plugins/darkroom/prefetch/max_memory"), 0) << 20;
+  if(max_mem == 0 || dev->image_storage.id <= 0) return;
+
+  // the full mipmap cache holds a fixed number of buffers, keep one for the current image
+  const int max_images = MIN(2, (int)darktable.mipmap_cache->mip_full.cache.cost_quota - 1);
+  if(max_images <= 0) return;
+
+  const uint32_t generation = __sync_fetch_and_add(&_prefetch_generation, 0);
+
+  // neighbours in navigation direction first, it's the one most likely to be needed
+  const int first = _prefetch_direction;
+  const int offsets[2] = { first, -first };
+
+  size_t total = 0;
+  for(int k = 0; k < max_images; k++)
+  {
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT imgid FROM memory.collected_images "
+                                "WHERE rowid=(SELECT rowid FROM memory.collected_images WHERE imgid=?1)+?2",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offsets[k]);
+    const int32_t imgid = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    if(imgid <= 0) continue;
+
+    total += _darkroom_prefetch_estimate_size(imgid, &dev->image_storage);
+    if(total > max_mem) break;
+
+    _darkroom_prefetch_add(imgid, generation);
+  }
+}
+
 static void dt_dev_change_image(dt_develop_t *dev, const uint32_t imgid)
 {
   // stop crazy users from sleeping on key-repeat spacebar:
@@ -988,6 +1106,9 @@ static void dt_dev_change_image(dt_develop_t *dev, const uint32_t imgid)
   // just make sure at this stage we have only history info into the undo, all automatic
   // tagging should be ignored.
   dt_undo_clear(darktable.undo, DT_UNDO_TAGS);
+
+  // and start loading the images the user is likely to switch to next
+  _darkroom_prefetch_neighbours(dev);
 }
 
 static void _view_darkroom_filmstrip_activate_callback(gpointer instance, int imgid, gpointer user_data)
@@ -1037,6 +1158,8 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff, gboolean by_key)
 
   if(new_id < 0 || new_id == imgid) return;
 
+  _prefetch_direction = diff < 0 ? -1 : 1;
+
   // if id seems valid, we change the image and move filmstrip
   dt_dev_change_image(dev, new_id);
   dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), new_offset, TRUE);
@@ -2803,10 +2926,17 @@ void enter(dt_view_t *self)
 
   // update accels_window
   darktable.view_manager->accels_window.prevent_refresh = FALSE;
+
+  // start loading the images next to this one
+  _prefetch_direction = 1;
+  _darkroom_prefetch_neighbours(dev);
 }
 
 void leave(dt_view_t *self)
 {
+  // nothing queued for the filmstrip neighbours is needed anymore
+  _darkroom_prefetch_cancel();
+
   _unregister_modules_drag_n_drop(self);
 
   /* disconnect from filmstrip image activate */
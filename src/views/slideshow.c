@@ -41,14 +41,6 @@ typedef enum dt_slideshow_event_t
   S_REQUEST_STEP_BACK,
 } dt_slideshow_event_t;
 
-typedef enum dt_slideshow_slot_t
-{
-  S_LEFT      = 0,
-  S_CURRENT   = 1,
-  S_RIGHT     = 2,
-  S_SLOT_LAST = 3
-} dt_slideshow_slot_t;
-
 typedef struct _slideshow_buf_t
 {
   uint32_t *buf;
@@ -56,6 +48,7 @@ typedef struct _slideshow_buf_t
   uint32_t height;
   int32_t rank;
   gboolean invalidated;
+  gboolean processing; // a job is rendering into this slot, it can't be reused
 } dt_slideshow_buf_t;
 
 typedef struct dt_slideshow_t
@@ -63,15 +56,21 @@ typedef struct dt_slideshow_t
   int32_t col_count;
   uint32_t width, height;
 
-  // buffers
-  dt_slideshow_buf_t buf[S_SLOT_LAST];
-  gboolean init_phase;
+  // ring of decode-ahead buffers, looked up by rank
+  dt_slideshow_buf_t *buf;
+  int nbuf;
+  // number of images rendered ahead in navigation direction
+  int ahead;
+  // rank of the displayed image and direction of the last step (1 or -1)
+  int32_t current;
+  int direction;
 
   // state machine stuff for image transitions:
   dt_pthread_mutex_t lock;
 
   gboolean auto_advance;
   int exporting;
+  int jobs, max_jobs;
   int delay;
 
   // some magic to hide the mouse pointer
@@ -120,43 +119,78 @@ static int write_image(dt_imageio_module_data_t *datai, const char *filename, co
   return 0;
 }
 
-static void shift_left(dt_slideshow_t *d)
+// position of rank in the list of wanted images, 0 being the most urgent, -1 if not needed.
+// the wanted images are the current one, the next ones in navigation direction and the
+// one just behind, in case the user steps back.
+static int _wanted_priority(const dt_slideshow_t *d, const int32_t rank)
 {
-  uint32_t *tmp_buf = d->buf[S_LEFT].buf;
+  if(rank < 0 || rank >= d->col_count) return -1;
+  const int32_t dist = (rank - d->current) * d->direction;
+  if(dist >= 0 && dist <= d->ahead) return dist;
+  if(dist == -1) return d->ahead + 1;
+  return -1;
+}
 
-  for(int k=S_LEFT; k<S_RIGHT; k++)
-  {
-    d->buf[k].buf         = d->buf[k+1].buf;
-    d->buf[k].rank        = d->buf[k+1].rank;
-    d->buf[k].width       = d->buf[k+1].width;
-    d->buf[k].height      = d->buf[k+1].height;
-    d->buf[k].invalidated = d->buf[k+1].invalidated;
-  }
-  d->buf[S_RIGHT].invalidated = TRUE;
-  d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
-  d->buf[S_RIGHT].buf = tmp_buf;
+static dt_slideshow_buf_t *_get_slot(dt_slideshow_t *d, const int32_t rank)
+{
+  for(int k = 0; k < d->nbuf; k++)
+    if(d->buf[k].rank == rank && (d->buf[k].processing || !d->buf[k].invalidated)) return &d->buf[k];
+  return NULL;
 }
 
-static void shift_right(dt_slideshow_t *d)
+static gboolean _is_ready(dt_slideshow_t *d, const int32_t rank)
 {
-  uint32_t *tmp_buf = d->buf[S_RIGHT].buf;
+  if(rank < 0 || rank >= d->col_count) return TRUE;
+  const dt_slideshow_buf_t *slot = _get_slot(d, rank);
+  return slot && !slot->processing && !slot->invalidated;
+}
 
-  for(int k=S_RIGHT; k>S_LEFT; k--)
+// must be called with the lock held. finds the most urgent image which has no slot yet and
+// reserves a slot for it, reusing the one holding the least useful image.
+static dt_slideshow_buf_t *_reserve_slot(dt_slideshow_t *d)
+{
+  if(!d->buf) return NULL;
+
+  for(int p = 0; p <= d->ahead + 1; p++)
   {
-    d->buf[k].buf         = d->buf[k-1].buf;
-    d->buf[k].rank        = d->buf[k-1].rank;
-    d->buf[k].width       = d->buf[k-1].width;
-    d->buf[k].height      = d->buf[k-1].height;
-    d->buf[k].invalidated = d->buf[k-1].invalidated;
+    const int32_t rank = p <= d->ahead ? d->current + p * d->direction : d->current - d->direction;
+    if(_wanted_priority(d, rank) < 0 || _get_slot(d, rank)) continue;
+
+    dt_slideshow_buf_t *victim = NULL;
+    int victim_score = -1;
+    for(int k = 0; k < d->nbuf; k++)
+    {
+      dt_slideshow_buf_t *slot = &d->buf[k];
+      if(slot->processing) continue;
+      // empty or unneeded slots are free, the others only give way to something more urgent
+      const int prio = _wanted_priority(d, slot->rank);
+      const int score = (slot->invalidated || prio < 0) ? INT_MAX : prio;
+      if(score > p && score > victim_score)
+      {
+        victim = slot;
+        victim_score = score;
+      }
+    }
+    if(!victim) return NULL;
+
+    victim->rank = rank;
+    victim->invalidated = TRUE;
+    victim->processing = TRUE;
+    d->exporting++;
+    return victim;
   }
-  d->buf[S_LEFT].invalidated = TRUE;
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-  d->buf[S_LEFT].buf = tmp_buf;
+  return NULL;
 }
 
 static void requeue_job(dt_slideshow_t *d)
 {
-  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, process_job_create(d));
+  // must be called with the lock held. start as many workers as allowed, each of them
+  // keeps rendering until nothing is left to do.
+  while(d->jobs < d->max_jobs)
+  {
+    d->jobs++;
+    dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, process_job_create(d));
+  }
 }
 
 static void _set_delay(dt_slideshow_t *d, int value)
@@ -165,7 +199,7 @@ static void _set_delay(dt_slideshow_t *d, int value)
   dt_conf_set_int("slideshow_delay", d->delay);
 }
 
-static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
+static int process_image(dt_slideshow_t *d, dt_slideshow_buf_t *slot, const int32_t rank)
 {
   dt_imageio_module_format_t buf;
   buf.mime = mime;
@@ -179,32 +213,24 @@ static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
   dat.head.width = dat.head.max_width = d->width;
   dat.head.height = dat.head.max_height = d->height;
   dat.head.style[0] = '\0';
-  dat.rank = d->buf[slot].rank;
+  dat.rank = rank;
   dat.buf.buf = dt_alloc_align(64, sizeof(uint32_t) * d->width * d->height);
+  dt_pthread_mutex_unlock(&d->lock);
 
-  d->exporting++;
-
-  const int32_t rank = dat.rank;
   const gchar *query = dt_collection_get_query(darktable.collection);
 
-  if(rank<0 || rank>=d->col_count || !query)
-  {
-    d->exporting--;
-    dt_pthread_mutex_unlock(&d->lock);
-    goto error;
-  }
-
-  dt_pthread_mutex_unlock(&d->lock);
-
   // get random image id from sql
   int32_t id = 0;
 
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rank);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, 1);
-  if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  if(query && dat.buf.buf)
+  {
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rank);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, 1);
+    if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
 
   // this is a little slow, might be worth to do an option:
   const gboolean high_quality = dt_conf_get_bool("plugins/slideshow/high_quality");
@@ -215,35 +241,31 @@ static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
     dt_imageio_export_with_flags(id, "unused", &buf, (dt_imageio_module_data_t *)&dat, TRUE, TRUE,
                                  high_quality, TRUE, FALSE, NULL, FALSE, FALSE, DT_COLORSPACE_DISPLAY,
                                  NULL, DT_INTENT_LAST, NULL, NULL, 1, 1, NULL);
-
-    // lock to copy back into the slot the rendered buffer, not that this is done only if
-    // the slot rank is still the same as the local buffer rank. This can be false if the
-    // buffers have been shifted to advance to next image.
-    dt_pthread_mutex_lock(&d->lock);
-    if(dat.rank == d->buf[slot].rank)
-    {
-      memcpy(d->buf[slot].buf, dat.buf.buf, sizeof(uint32_t) * dat.buf.width * dat.buf.height);
-      d->buf[slot].width = dat.buf.width;
-      d->buf[slot].height = dat.buf.height;
-      d->buf[slot].invalidated = FALSE;
-    }
-    d->exporting--;
-    dt_pthread_mutex_unlock(&d->lock);
   }
 
-  dt_free_align(dat.buf.buf);
-  return 0;
+  // lock to hand the rendered buffer over to the slot. the slot was reserved for us,
+  // so we can just swap the buffers instead of copying the pixels.
+  dt_pthread_mutex_lock(&d->lock);
+  if(id && slot->rank == rank)
+  {
+    uint32_t *tmp = slot->buf;
+    slot->buf = dat.buf.buf;
+    dat.buf.buf = tmp;
+    slot->width = dat.buf.width;
+    slot->height = dat.buf.height;
+    slot->invalidated = FALSE;
+  }
+  slot->processing = FALSE;
+  d->exporting--;
+  dt_pthread_mutex_unlock(&d->lock);
 
- error:
   dt_free_align(dat.buf.buf);
-  return 1;
+  return id ? 0 : 1;
 }
 
 static gboolean _is_idle(dt_slideshow_t *d)
 {
-  return !((d->buf[S_LEFT].invalidated && d->buf[S_LEFT].rank <= d->col_count)
-           || (d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank <= d->col_count)
-           || (d->buf[S_RIGHT].invalidated && d->buf[S_RIGHT].rank <= d->col_count));
+  return _is_ready(d, d->current) && _is_ready(d, d->current + d->direction);
 }
 
 static gboolean auto_advance(gpointer user_data)
@@ -259,23 +281,31 @@ static int32_t process_job_run(dt_job_t *job)
 {
   dt_slideshow_t *d = dt_control_job_get_params(job);
 
-  if(d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank <= d->col_count)
-  {
-    process_image(d, S_CURRENT);
-    dt_control_queue_redraw_center();
-  }
-  else if(d->buf[S_RIGHT].invalidated && d->buf[S_RIGHT].rank <= d->col_count)
+  while(TRUE)
   {
-    process_image(d, S_RIGHT);
-  }
-  else if(d->buf[S_LEFT].invalidated && d->buf[S_LEFT].rank >= 0)
-  {
-    process_image(d, S_LEFT);
-  }
+    dt_pthread_mutex_lock(&d->lock);
+    dt_slideshow_buf_t *slot = _reserve_slot(d);
+    if(!slot)
+    {
+      // nothing left to render, this worker is done
+      d->jobs--;
+      dt_pthread_mutex_unlock(&d->lock);
+      break;
+    }
+    const int32_t rank = slot->rank;
+    dt_pthread_mutex_unlock(&d->lock);
+
+    if(process_image(d, slot, rank))
+    {
+      // don't spin on an image we can't render
+      dt_pthread_mutex_lock(&d->lock);
+      d->jobs--;
+      dt_pthread_mutex_unlock(&d->lock);
+      break;
+    }
 
-  // any other slot to fill?
-  if(!_is_idle(d))
-    requeue_job(d);
+    if(rank == d->current) dt_control_queue_redraw_center();
+  }
 
   return 0;
 }
@@ -290,8 +320,7 @@ static dt_job_t *process_job_create(dt_slideshow_t *d)
 
 static void _refresh_display(dt_slideshow_t *d)
 {
-  if(!d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank >= 0)
-    dt_control_queue_redraw_center();
+  if(_get_slot(d, d->current)) dt_control_queue_redraw_center();
 }
 
 // state machine stepping
@@ -301,11 +330,10 @@ static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event)
 
   if(event == S_REQUEST_STEP)
   {
-    if(d->buf[S_CURRENT].rank < d->col_count - 1)
+    if(d->current < d->col_count - 1)
     {
-      shift_left(d);
-      d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
-      d->buf[S_RIGHT].invalidated = d->buf[S_RIGHT].rank < d->col_count;
+      d->current++;
+      d->direction = 1;
       _refresh_display(d);
       requeue_job(d);
     }
@@ -317,11 +345,10 @@ static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event)
   }
   else if(event == S_REQUEST_STEP_BACK)
   {
-    if(d->buf[S_CURRENT].rank > 0)
+    if(d->current > 0)
     {
-      shift_right(d);
-      d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-      d->buf[S_LEFT].invalidated = d->buf[S_LEFT].rank >= 0;
+      d->current--;
+      d->direction = -1;
       _refresh_display(d);
       requeue_job(d);
     }
@@ -416,13 +443,22 @@ void enter(dt_view_t *self)
   d->width = rect.width * darktable.gui->ppd;
   d->height = rect.height * darktable.gui->ppd;
 
-  for(int k=S_LEFT; k<S_SLOT_LAST; k++)
+  // one slot for the current image, the ones ahead and one behind
+  d->ahead = CLAMP(dt_conf_get_int("plugins/slideshow/decode_ahead"), 1, 16);
+  d->nbuf = d->ahead + 2;
+  d->buf = (dt_slideshow_buf_t *)calloc(d->nbuf, sizeof(dt_slideshow_buf_t));
+  for(int k = 0; k < d->nbuf; k++)
   {
     d->buf[k].buf = dt_alloc_align(64, sizeof(uint32_t) * d->width * d->height);
-    d->buf[k].width =  d->width;
+    d->buf[k].width = d->width;
     d->buf[k].height = d->height;
+    d->buf[k].rank = -1;
     d->buf[k].invalidated = TRUE;
   }
+  // rendering the current image and the next one in parallel is what hides the latency,
+  // more workers only help when the pipe itself doesn't scale
+  d->max_jobs = CLAMP(darktable.control->num_threads - 1, 1, d->ahead);
+  d->direction = 1;
 
   // if one selected start with it, otherwise start at the current lighttable offset
   const int imgid = dt_view_get_image_to_act_on();
@@ -441,21 +477,19 @@ void enter(dt_view_t *self)
     sqlite3_finalize(stmt);
   }
 
-  d->buf[S_CURRENT].rank = selrank == -1 ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui)) : selrank;
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-  d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
+  d->current = selrank == -1 ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui)) : selrank;
 
   d->col_count = dt_collection_get_count(darktable.collection);
 
   d->auto_advance = FALSE;
   d->delay = dt_conf_get_int("slideshow_delay");
-  // restart from beginning, will first increment counter by step and then prefetch
+
+  // start the first workers
+  requeue_job(d);
   dt_pthread_mutex_unlock(&d->lock);
 
   gtk_widget_grab_focus(dt_ui_center(darktable.gui->ui));
 
-  // start first job
-  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, process_job_create(d));
   dt_control_log(_("waiting to start slideshow"));
 }
 
@@ -468,19 +502,23 @@ void leave(dt_view_t *self)
   dt_control_change_cursor(GDK_LEFT_PTR);
   d->auto_advance = FALSE;
 
+  // no image is wanted anymore, so no worker will reserve a new slot
+  dt_pthread_mutex_lock(&d->lock);
+  d->col_count = 0;
+  dt_pthread_mutex_unlock(&d->lock);
+
   // exporting could be in action, just wait for the last to finish
   // otherwise we will crash releasing lock and memory.
   while(d->exporting > 0) sleep(1);
 
-  dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), d->buf[S_CURRENT].rank, FALSE);
+  dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), d->current, FALSE);
 
   dt_pthread_mutex_lock(&d->lock);
 
-  for(int k=S_LEFT; k<S_SLOT_LAST; k++)
-  {
-    dt_free_align(d->buf[k].buf);
-    d->buf[k].buf = NULL;
-  }
+  for(int k = 0; k < d->nbuf; k++) dt_free_align(d->buf[k].buf);
+  free(d->buf);
+  d->buf = NULL;
+  d->nbuf = 0;
   dt_pthread_mutex_unlock(&d->lock);
 }
 
@@ -492,9 +530,9 @@ void expose(dt_view_t *self, cairo_t *cr, int32_t width, int32_t height, int32_t
   dt_pthread_mutex_lock(&d->lock);
   cairo_paint(cr);
 
-  const dt_slideshow_buf_t *slot = &(d->buf[S_CURRENT]);
+  const dt_slideshow_buf_t *slot = _get_slot(d, d->current);
 
-  if(slot->buf && slot->rank >= 0 && !slot->invalidated)
+  if(slot && slot->buf && !slot->processing && !slot->invalidated)
   {
     // cope with possible resize of the window
     const float tr_width = d->width < slot->width ? 0.f : (d->width - slot->width) * .5f / darktable.gui->ppd;